@@ -0,0 +1,223 @@
+/*
+ *  MIT License
+ *
+ *  Copyright (c) 2021 Keisuke Sehara
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+*/
+#ifndef BENCH_UTILS_HPP_
+#include <chrono>
+#include <ctime>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <utility>
+#include <functional>
+
+/**
+ *  a minimal benchmark runner whose JSON output follows the format of
+ *  Google Benchmark, so that the results can be compared across commits
+ *  with the usual tools (e.g. compare.py).
+ *
+ *  command-line options:
+ *    --benchmark_filter=<substring>
+ *    --benchmark_min_time=<seconds>
+ *    --benchmark_format=<console|json>
+ *    --benchmark_out=<path>  (always JSON)
+ */
+namespace bench {
+
+struct Result
+{
+    std::string name;
+    uint64_t    iterations;
+    double      real_time; // ns per iteration
+    double      cpu_time;  // ns per iteration
+    std::vector<std::pair<std::string, double>> counters;
+};
+
+/**
+ *  the state passed to a benchmark body. the body runs its own loop:
+ *
+ *      while (state.keep_running()) { ... }
+ */
+class State
+{
+private:
+    uint64_t target_;
+    uint64_t count_;
+public:
+    std::vector<std::pair<std::string, double>> counters;
+
+    explicit State(const uint64_t& iterations): target_(iterations), count_(0) { }
+    bool     keep_running() { return (count_++ < target_); }
+    uint64_t iterations() const { return target_; }
+    void     counter(const std::string& name, const double& value) { counters.emplace_back(name, value); }
+};
+
+typedef std::function<void(State&)> Body;
+
+class Runner
+{
+private:
+    std::vector<std::pair<std::string, Body>> benchmarks_;
+    std::vector<Result>                       results_;
+    std::string                               filter_;
+    std::string                               format_;
+    std::string                               out_;
+    double                                    min_time_;
+
+    static bool option_(const char *arg, const char *name, std::string& value) {
+        size_t len = std::strlen(name);
+        if ((std::strncmp(arg, name, len) == 0) && (arg[len] == '=')) {
+            value = arg + len + 1;
+            return true;
+        }
+        return false;
+    }
+
+    static void write_json_(FILE *out, const std::vector<Result>& results) {
+        char date[64];
+        std::time_t now = std::time(nullptr);
+        std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", std::localtime(&now));
+        std::fprintf(out, "{\n  \"context\": {\n    \"date\": \"%s\",\n"
+                          "    \"library_build_type\": \"%s\"\n  },\n  \"benchmarks\": [\n",
+                     date,
+#ifdef NDEBUG
+                     "release"
+#else
+                     "debug"
+#endif
+                     );
+        for (size_t i = 0; i < results.size(); i++) {
+            const Result& r = results[i];
+            std::fprintf(out, "    {\n      \"name\": \"%s\",\n      \"run_name\": \"%s\",\n"
+                              "      \"run_type\": \"iteration\",\n      \"iterations\": %llu,\n"
+                              "      \"real_time\": %.3f,\n      \"cpu_time\": %.3f,\n"
+                              "      \"time_unit\": \"ns\"",
+                         r.name.c_str(), r.name.c_str(), (unsigned long long)r.iterations,
+                         r.real_time, r.cpu_time);
+            for (auto& counter: r.counters) {
+                std::fprintf(out, ",\n      \"%s\": %.6g", counter.first.c_str(), counter.second);
+            }
+            std::fprintf(out, "\n    }%s\n", (i + 1 < results.size())? "," : "");
+        }
+        std::fprintf(out, "  ]\n}\n");
+    }
+
+    Result measure_(const std::string& name, const Body& body) {
+        using clock = std::chrono::steady_clock;
+        uint64_t iterations = 1;
+        while (true) {
+            State state(iterations);
+            std::clock_t cpu_start = std::clock();
+            clock::time_point start = clock::now();
+            body(state);
+            double elapsed = std::chrono::duration<double>(clock::now() - start).count();
+            double cpu     = (double)(std::clock() - cpu_start) / CLOCKS_PER_SEC;
+            if ((elapsed >= min_time_) || (iterations >= (1ULL << 40))) {
+                Result result;
+                result.name       = name;
+                result.iterations = iterations;
+                result.real_time  = 1e9 * elapsed / iterations;
+                result.cpu_time   = 1e9 * cpu / iterations;
+                result.counters   = state.counters;
+                return result;
+            }
+            // aim slightly above the minimum time
+            double scale = (elapsed > 0.0)? (1.4 * min_time_ / elapsed) : 10.0;
+            scale = (scale < 10.0)? scale : 10.0;
+            uint64_t next = (uint64_t)(iterations * scale);
+            iterations = (next > iterations)? next : (iterations + 1);
+        }
+    }
+public:
+    Runner(): format_("console"), min_time_(0.5) { }
+
+    void add(const std::string& name, const Body& body) { benchmarks_.emplace_back(name, body); }
+
+    int run(int argc, char **argv) {
+        for (int i = 1; i < argc; i++) {
+            std::string value;
+            if (option_(argv[i], "--benchmark_filter", value)) {
+                filter_ = value;
+            } else if (option_(argv[i], "--benchmark_min_time", value)) {
+                min_time_ = std::stod(value);
+            } else if (option_(argv[i], "--benchmark_format", value)) {
+                format_ = value;
+            } else if (option_(argv[i], "--benchmark_out", value)) {
+                out_ = value;
+            } else {
+                std::fprintf(stderr, "unknown option: %s\n", argv[i]);
+                return 1;
+            }
+        }
+
+        for (auto& benchmark: benchmarks_) {
+            if (!filter_.empty() && (benchmark.first.find(filter_) == std::string::npos)) {
+                continue;
+            }
+            Result result = measure_(benchmark.first, benchmark.second);
+            if (format_ != "json") {
+                std::printf("%-48s %12.1f ns %12.1f ns %12llu",
+                            result.name.c_str(), result.real_time, result.cpu_time,
+                            (unsigned long long)result.iterations);
+                for (auto& counter: result.counters) {
+                    std::printf(" %s=%.4g", counter.first.c_str(), counter.second);
+                }
+                std::printf("\n");
+                std::fflush(stdout);
+            }
+            results_.push_back(result);
+        }
+
+        if (format_ == "json") {
+            write_json_(stdout, results_);
+        }
+        if (!out_.empty()) {
+            FILE *out = std::fopen(out_.c_str(), "w");
+            if (out == nullptr) {
+                std::fprintf(stderr, "failed to open: %s\n", out_.c_str());
+                return 1;
+            }
+            write_json_(out, results_);
+            std::fclose(out);
+        }
+        return 0;
+    }
+};
+
+/**
+ *  prevents the compiler from optimizing away `value`.
+ */
+template<class T>
+inline void do_not_optimize(const T& value)
+{
+    const volatile T *sink = &value;
+    (void)sink;
+#if defined(__GNUC__) || defined(__clang__)
+    __asm__ __volatile__("" : : "g"(&value) : "memory");
+#endif
+}
+
+} // namespace bench
+
+#define BENCH_UTILS_HPP_
+#endif
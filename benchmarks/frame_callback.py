@@ -0,0 +1,115 @@
+# MIT License
+#
+# Copyright (c) 2021 Keisuke Sehara
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in all
+# copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+
+"""benchmarks of the per-frame Python path on synthetic buffers, for each of the
+frame shapes that FrameTypeDescriptor supports: creating the Frame of a buffer
+(`as_frame`, `asarray`), and dispatching it through `default_frame_callback`
+to 0, 1 and N no-op callbacks (`callback/N`).
+
+usage: python benchmarks/frame_callback.py [--benchmark_filter=SUBSTR] [--benchmark_min_time=SEC]
+                                           [--benchmark_format=console|json] [--benchmark_out=PATH]
+
+does not require a camera (but requires the SDK to import labcamera_tis). the options
+and the JSON output are the same as those of frame_path_benchmark, so that the results
+can be compared or merged.
+"""
+
+import argparse
+import json
+import sys
+import time
+
+import labcamera_tis as tis
+
+SHAPES = (
+    ('Y800',  640,  480),
+    ('Y16',   640,  480),
+    ('RGB24', 640,  480),
+    ('RGB32', 640,  480),
+    ('Y800', 1440, 1080),
+    ('Y16',  1440, 1080),
+)
+
+CALLBACKS = (0, 1, 8)
+
+
+def benchmarks():
+    for fmt, width, height in SHAPES:
+        label = f"{fmt}/{width}x{height}"
+        yield f"frame_callback/as_frame/{label}", ('as_frame', fmt, width, height, 0)
+        yield f"frame_callback/asarray/{label}", ('asarray', fmt, width, height, 0)
+    fmt, width, height = SHAPES[0]
+    for count in CALLBACKS:
+        yield f"frame_callback/callback/{count}", ('callback', fmt, width, height, count)
+
+
+def measure(name, args, min_time):
+    iterations = 1
+    while True:
+        cpu_start = time.process_time()
+        start     = time.perf_counter()
+        tis._frame_path_benchmark(*args, iterations=iterations)
+        elapsed = time.perf_counter() - start
+        cpu     = time.process_time() - cpu_start
+        if (elapsed >= min_time) or (iterations >= (1 << 40)):
+            return dict(name=name, run_name=name, run_type='iteration', iterations=iterations,
+                        real_time=1e9 * elapsed / iterations, cpu_time=1e9 * cpu / iterations,
+                        time_unit='ns')
+        # aim slightly above the minimum time
+        scale = min(1.4 * min_time / elapsed, 10.0) if elapsed > 0 else 10.0
+        iterations = max(int(iterations * scale), iterations + 1)
+
+
+def as_json(results):
+    return json.dumps(dict(context=dict(date=time.strftime("%Y-%m-%dT%H:%M:%S"),
+                                        library_build_type='release'),
+                           benchmarks=results), indent=2)
+
+
+def run():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('--benchmark_filter', default='')
+    parser.add_argument('--benchmark_min_time', type=float, default=0.5)
+    parser.add_argument('--benchmark_format', choices=('console', 'json'), default='console')
+    parser.add_argument('--benchmark_out', default=None)
+    args = parser.parse_args()
+
+    results = []
+    for name, bench in benchmarks():
+        if args.benchmark_filter not in name:
+            continue
+        result = measure(name, bench, args.benchmark_min_time)
+        if args.benchmark_format != 'json':
+            print(f"{name:<48} {result['real_time']:12.1f} ns {result['cpu_time']:12.1f} ns "
+                  f"{result['iterations']:12d}", flush=True)
+        results.append(result)
+
+    if args.benchmark_format == 'json':
+        print(as_json(results))
+    if args.benchmark_out is not None:
+        with open(args.benchmark_out, 'w') as out:
+            out.write(as_json(results) + "\n")
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(run())
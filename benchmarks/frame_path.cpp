@@ -0,0 +1,361 @@
+/*
+ *  MIT License
+ *
+ *  Copyright (c) 2021 Keisuke Sehara
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+*/
+
+/*
+ *  benchmarks of the frame path on synthetic buffers, for each of the frame
+ *  shapes that FrameTypeDescriptor supports. does not require the SDK.
+ *
+ *  ./frame_path_benchmark --benchmark_format=json > results.json
+ *
+ *  the pixel kernels are run at every instruction set level that the machine
+ *  supports, e.g. `--benchmark_filter=kernels/sse2/` for one of them.
+ */
+#include <atomic>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "bench_utils.hpp"
+#include "pool_utils.hpp"
+#include "dispatch_utils.hpp"
+#include "dlpack_utils.hpp"
+#include "stats_utils.hpp"
+#include "format_utils.hpp"
+#include "simd_utils.hpp"
+#include "pixelstats_utils.hpp"
+#include "histogram_utils.hpp"
+#include "motion_utils.hpp"
+#include "preview_utils.hpp"
+#include "blob_utils.hpp"
+#include "sync_utils.hpp"
+
+struct FrameShape
+{
+    const char *format;
+    size_t      width;
+    size_t      height;
+    size_t      bytes_per_pixel;
+    ColorFormat color;
+
+    size_t size() const { return width * height * bytes_per_pixel; }
+    FrameFormat frame_format() const {
+        FrameFormat format = { color, (unsigned)(8 * bytes_per_pixel), width, height, size(), false };
+        return format;
+    }
+
+    std::string label() const {
+        return std::string(format) + "/" + std::to_string(width) + "x" + std::to_string(height);
+    }
+};
+
+static const FrameShape SHAPES[] = {
+    { "Y800",  640,  480, 1, FormatY800  },
+    { "Y16",   640,  480, 2, FormatY16   },
+    { "RGB24", 640,  480, 3, FormatRGB24 },
+    { "RGB32", 640,  480, 4, FormatRGB32 },
+    { "Y800", 1440, 1080, 1, FormatY800  },
+    { "Y16",  1440, 1080, 2, FormatY16   },
+};
+
+static std::vector<uint8_t> synthetic_frame(const FrameShape& shape)
+{
+    std::vector<uint8_t> frame(shape.size());
+    for (size_t i = 0; i < frame.size(); i++) {
+        frame[i] = (uint8_t)((i * 2654435761u) >> 24);
+    }
+    return frame;
+}
+
+void null_consumer(FrameSlot *slot, void *user_data) { }
+
+void counting_consumer(FrameSlot *slot, void *user_data)
+{
+    if (slot != nullptr) {
+        ((std::atomic<uint64_t> *)user_data)->fetch_add(1, std::memory_order_release);
+    }
+}
+
+void delete_hold(void *hold)
+{
+    delete (FrameHold *)hold;
+}
+
+void add_pool_benchmarks(bench::Runner& runner)
+{
+    for (const FrameShape& shape: SHAPES) {
+        runner.add("pool_copy/" + shape.label(), [shape](bench::State& state) {
+            std::vector<uint8_t> frame = synthetic_frame(shape);
+            FramePool pool;
+            pool.allocate(4, shape.size());
+            while (state.keep_running()) {
+                FrameSlot *slot = pool.acquire();
+                std::memcpy(slot->data, frame.data(), shape.size());
+                bench::do_not_optimize(slot->data[0]);
+                pool.release(slot);
+            }
+            state.counter("bytes_per_frame", (double)shape.size());
+        });
+    }
+}
+
+void add_dispatch_benchmarks(bench::Runner& runner)
+{
+    const size_t counts[] = { 0, 1, 4 };
+    for (const FrameShape& shape: SHAPES) {
+        for (size_t n: counts) {
+            std::string name = "dispatch/" + std::to_string(n) + "consumers/" + shape.label();
+            runner.add(name, [shape, n](bench::State& state) {
+                std::vector<uint8_t> frame = synthetic_frame(shape);
+                FrameDispatcher dispatcher;
+                for (size_t i = 0; i < n; i++) {
+                    dispatcher.add_consumer(null_consumer, nullptr, DeliverLatest, 2, 0.0);
+                }
+                dispatcher.start(shape.size());
+                uint64_t sequence = 0;
+                while (state.keep_running()) {
+                    dispatcher.dispatch(frame.data(), shape.size(), sequence++, monotonic_seconds());
+                }
+                dispatcher.stop();
+            });
+        }
+    }
+}
+
+void add_handoff_benchmarks(bench::Runner& runner)
+{
+    // a round trip from dispatch() to the start of the consumer callback
+    runner.add("handoff/dispatch_to_consumer", [](bench::State& state) {
+        const FrameShape& shape = SHAPES[0];
+        std::vector<uint8_t>  frame = synthetic_frame(shape);
+        std::atomic<uint64_t> received(0);
+        FrameDispatcher dispatcher;
+        dispatcher.add_consumer(counting_consumer, &received, DeliverAll, 1, 0.0);
+        dispatcher.start(shape.size());
+        uint64_t sequence = 0;
+        while (state.keep_running()) {
+            dispatcher.dispatch(frame.data(), shape.size(), sequence, monotonic_seconds());
+            sequence++;
+            while (received.load(std::memory_order_acquire) < sequence) { }
+        }
+        dispatcher.stop();
+        const LatencyHistogram *latency = dispatcher.latency(0);
+        state.counter("p50_us", latency->percentile(0.5) * 1e6);
+        state.counter("p99_us", latency->percentile(0.99) * 1e6);
+        state.counter("p999_us", latency->percentile(0.999) * 1e6);
+    });
+
+    // what a consumer pays to hand a pooled frame over to e.g. an inference library:
+    // a copy that the library then owns, or a DLPack tensor holding the slot
+    for (const FrameShape& shape: SHAPES) {
+        runner.add("handoff/copy/" + shape.label(), [shape](bench::State& state) {
+            std::vector<uint8_t> frame = synthetic_frame(shape);
+            while (state.keep_running()) {
+                uint8_t *copy = new uint8_t[shape.size()];
+                std::memcpy(copy, frame.data(), shape.size());
+                bench::do_not_optimize(copy[0]);
+                delete[] copy;
+            }
+            state.counter("bytes_per_frame", (double)shape.size());
+        });
+
+        runner.add("handoff/dlpack/" + shape.label(), [shape](bench::State& state) {
+            FramePool pool;
+            pool.holds(1);
+            pool.allocate(1, shape.size());
+            const int64_t dims[2]    = { (int64_t)shape.height, (int64_t)(shape.width * shape.bytes_per_pixel) };
+            const int64_t strides[2] = { dims[1], 1 };
+            while (state.keep_running()) {
+                FrameSlot *slot = pool.acquire();
+                FrameHold *hold = pool.hold(slot->data);
+                pool.release(slot);
+                DLManagedTensor *tensor = export_tensor(hold->data(), 2, dims, strides, 8,
+                                                        delete_hold, hold);
+                bench::do_not_optimize(tensor->dl_tensor.data);
+                tensor->deleter(tensor);
+            }
+        });
+    }
+
+    runner.add("latency_histogram/record", [](bench::State& state) {
+        LatencyHistogram histogram;
+        double value = 1e-6;
+        while (state.keep_running()) {
+            histogram.record(value);
+            value = (value < 1.0)? (value * 1.01) : 1e-6;
+        }
+        bench::do_not_optimize(histogram.count());
+    });
+}
+
+/**
+ *  runs `to_gray8<Traits>` on frames of `shape`, selecting Traits once.
+ */
+struct GrayConversion
+{
+    const FrameShape *shape;
+    bench::State     *state;
+
+    template<class Traits>
+    void apply() {
+        std::vector<uint8_t> frame = synthetic_frame(*shape);
+        std::vector<uint8_t> gray(shape->width * shape->height);
+        while (state->keep_running()) {
+            to_gray8<Traits>(frame.data(), gray.data(), shape->width, shape->height, 8);
+            bench::do_not_optimize(gray[0]);
+        }
+    }
+};
+
+void add_conversion_benchmarks(bench::Runner& runner)
+{
+    for (const FrameShape& shape: SHAPES) {
+        runner.add("to_gray8/" + shape.label(), [shape](bench::State& state) {
+            GrayConversion conversion = { &shape, &state };
+            visit_format(shape.frame_format(), conversion);
+        });
+        for (size_t bin = 1; bin <= 2; bin++) {
+            // the central quarter of the frame
+            runner.add("crop/bin" + std::to_string(bin) + "/" + shape.label(), [shape, bin](bench::State& state) {
+                std::vector<uint8_t> frame = synthetic_frame(shape);
+                FrameCrop crop;
+                crop.region(shape.width / 4, shape.height / 4, shape.width / 2, shape.height / 2);
+                crop.binning(bin);
+                if (!crop.prepare(shape.frame_format())) {
+                    return;
+                }
+                std::vector<uint8_t> cropped(crop.output().size);
+                while (state.keep_running()) {
+                    crop.apply(frame.data(), cropped.data());
+                    bench::do_not_optimize(cropped[0]);
+                }
+            });
+        }
+    }
+}
+
+void add_kernel_benchmarks(bench::Runner& runner)
+{
+    for (int level = IsaScalar; level <= supported_isa(); level++) {
+        const PixelKernels *kernels = pixel_kernels((IsaLevel)level);
+        const std::string   prefix  = std::string("kernels/") + isa_name((IsaLevel)level) + "/";
+        for (const FrameShape& shape: SHAPES) {
+            if ((shape.color == FormatRGB24) || (shape.color == FormatRGB32)) {
+                continue;
+            }
+            const size_t row_bytes = shape.width * shape.bytes_per_pixel;
+            const size_t pixels    = shape.width * shape.height;
+
+            const bool wide = (shape.color == FormatY16);
+            runner.add(prefix + "roi_sum/" + shape.label(), [=](bench::State& state) {
+                std::vector<uint8_t> frame = synthetic_frame(shape);
+                while (state.keep_running()) {
+                    uint64_t sum = wide? kernels->roi_sum16(frame.data(), row_bytes, shape.width, shape.height)
+                                       : kernels->roi_sum8(frame.data(), row_bytes, shape.width, shape.height);
+                    bench::do_not_optimize(sum);
+                }
+            });
+            runner.add(prefix + "sad/" + shape.label(), [=](bench::State& state) {
+                std::vector<uint8_t> frame    = synthetic_frame(shape);
+                std::vector<uint8_t> previous(frame.rbegin(), frame.rend());
+                while (state.keep_running()) {
+                    uint64_t sad = wide? kernels->sad16(frame.data(), previous.data(), row_bytes, shape.width, shape.height)
+                                       : kernels->sad8(frame.data(), previous.data(), row_bytes, shape.width, shape.height);
+                    bench::do_not_optimize(sad);
+                }
+            });
+            runner.add(prefix + "unpack/" + shape.label(), [=](bench::State& state) {
+                std::vector<uint8_t> frame = synthetic_frame(shape);
+                std::vector<float>   values(pixels);
+                while (state.keep_running()) {
+                    if (wide) {
+                        kernels->unpack16(frame.data(), values.data(), pixels);
+                    } else {
+                        kernels->unpack8(frame.data(), values.data(), pixels);
+                    }
+                    bench::do_not_optimize(values[0]);
+                }
+            });
+            runner.add(prefix + "accumulate/" + shape.label(), [=](bench::State& state) {
+                std::vector<float>  values(pixels, 1.0f), reference(pixels, 0.0f);
+                std::vector<float>  minimum(pixels, 0.0f), maximum(pixels, 0.0f);
+                std::vector<double> sum(pixels, 0.0), sum_sq(pixels, 0.0);
+                while (state.keep_running()) {
+                    kernels->accumulate(values.data(), reference.data(), sum.data(), sum_sq.data(),
+                                        minimum.data(), maximum.data(), pixels);
+                    bench::do_not_optimize(sum[0]);
+                }
+            });
+            if (!wide) {
+                runner.add(prefix + "histogram/" + shape.label(), [=](bench::State& state) {
+                    std::vector<uint8_t>  frame = synthetic_frame(shape);
+                    std::vector<uint64_t> bins(256);
+                    while (state.keep_running()) {
+                        kernels->histogram8(frame.data(), row_bytes, shape.width, shape.height, bins.data());
+                        bench::do_not_optimize(bins[0]);
+                    }
+                });
+            }
+        }
+    }
+}
+
+/**
+ *  runs `stage` on synthetic frames of each shape, as the dequeue thread would.
+ */
+template<class Stage>
+void add_stage_benchmark(bench::Runner& runner, const std::string& name)
+{
+    for (const FrameShape& shape: SHAPES) {
+        runner.add("stages/" + name + "/" + shape.label(), [shape](bench::State& state) {
+            std::vector<uint8_t> frame = synthetic_frame(shape);
+            Stage stage;
+            if (!stage.prepare(shape.frame_format())) {
+                return;
+            }
+            uint64_t sequence = 0;
+            while (state.keep_running()) {
+                FrameView view = { frame.data(), frame.size(), sequence++, 0.0 };
+                stage.process(view);
+            }
+            stage.finish();
+        });
+    }
+}
+
+int main(int argc, char **argv)
+{
+    bench::Runner runner;
+    add_pool_benchmarks(runner);
+    add_dispatch_benchmarks(runner);
+    add_handoff_benchmarks(runner);
+    add_conversion_benchmarks(runner);
+    add_kernel_benchmarks(runner);
+    add_stage_benchmark<PixelStatsStage>(runner, "pixel_stats");
+    add_stage_benchmark<HistogramStage>(runner, "histogram");
+    add_stage_benchmark<MotionEnergyStage>(runner, "motion_energy");
+    add_stage_benchmark<PreviewStage>(runner, "preview");
+    add_stage_benchmark<BlobStage>(runner, "blobs");
+    add_stage_benchmark<SyncPulseStage>(runner, "sync_pulse");
+    return runner.run(argc, argv);
+}
@@ -0,0 +1,357 @@
+/*
+ *  MIT License
+ *
+ *  Copyright (c) 2021 Keisuke Sehara
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+*/
+/*
+ *  a randomized stress test of the hand-off between the notifications of the sink and
+ *  the dequeue thread (FrameHandoff), against a fake sink. does not require the SDK.
+ *
+ *  ./frame_handoff --frames=2000000 --strategy=both --spin-budget=0.00005
+ *
+ *  a producer thread queues frames into the fake sink and notifies the hand-off the way
+ *  the SDK calls framesQueued(), with scheduling jitter injected on both sides: random
+ *  busy gaps, yields and sleeps between the frames, delays between queueing a frame and
+ *  its notification, and notifications that cover several frames. the dequeue thread
+ *  waits through the hand-off and pops the frames, with random delays of its own.
+ *
+ *  the fake sink also stalls at random while it is asked for its size, and after a
+ *  fraction --quiet of the frames, the producer waits for the sink to be emptied
+ *  without any further notification, so that a lost notification cannot be
+ *  covered up by the next frame.
+ *
+ *  the run fails (with exit status 1) if a frame is lost, if the dequeue thread does not
+ *  drain the sink within --stall seconds of a quiet period or --drain seconds after the
+ *  last frame (i.e. a wake-up was lost), or if the latency that the hand-off reports for
+ *  a frame does not match the time since the notification that first saw it.
+ *  frames that wait longer than --stall seconds are counted as stalls.
+ */
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "handoff_utils.hpp"
+#include "stats_utils.hpp"
+
+static bool option(const char *arg, const char *name, std::string& value)
+{
+    size_t len = std::strlen(name);
+    if ((std::strncmp(arg, name, len) == 0) && (arg[len] == '=')) {
+        value = arg + len + 1;
+        return true;
+    }
+    return false;
+}
+
+static void print_latency(const char *label, const LatencyHistogram *latency)
+{
+    if (latency->count() == 0) {
+        return;
+    }
+    std::printf("%-24s p50 %8.1f us  p99 %8.1f us  p99.9 %8.1f us  max %10.1f us\n", label,
+                1e6 * latency->percentile(0.5), 1e6 * latency->percentile(0.99),
+                1e6 * latency->percentile(0.999), 1e6 * latency->max());
+}
+
+static void spin_for(const double& seconds)
+{
+    const double due = monotonic_seconds() + seconds;
+    while (monotonic_seconds() < due) {
+        cpu_relax();
+    }
+}
+
+/**
+ *  the output queue of a FrameQueueSink: frames are numbered from 0.
+ *  asking for its size takes a random while after the size has been read,
+ *  which widens the windows where the hand-off could lose a notification.
+ */
+class FakeSink
+{
+private:
+    std::mutex            io_;
+    std::deque<uint64_t>  frames_;
+    std::atomic<size_t>   size_;
+    std::atomic<uint64_t> random_;
+public:
+    FakeSink(const uint64_t& seed): size_(0), random_(seed) { }
+
+    size_t getOutputQueueSize() {
+        const size_t size = size_.load(std::memory_order_acquire);
+        // a cheap shared generator is enough for jitter
+        const uint64_t state = random_.fetch_add(0x9E3779B97F4A7C15ULL, std::memory_order_relaxed);
+        const uint64_t draw  = ((state ^ (state >> 31)) * 0xBF58476D1CE4E5B9ULL) >> 54; // 0-1023
+        if (draw < 16) {
+            std::this_thread::yield();
+        } else if (draw < 48) {
+            spin_for(2e-6 * (double)draw);
+        }
+        return size;
+    }
+
+    void queue(const uint64_t& frame) {
+        std::unique_lock<std::mutex> lock(io_);
+        frames_.push_back(frame);
+        size_.store(frames_.size(), std::memory_order_release);
+    }
+
+    uint64_t pop() {
+        std::unique_lock<std::mutex> lock(io_);
+        const uint64_t frame = frames_.front();
+        frames_.pop_front();
+        size_.store(frames_.size(), std::memory_order_release);
+        return frame;
+    }
+};
+
+struct Options
+{
+    uint64_t frames;
+    double   gap;         // the mean busy gap between frames, in seconds
+    double   stall;
+    double   drain;
+    uint64_t seed;
+    double   quiet;       // the probability of waiting for the sink to be emptied after a frame
+};
+
+/**
+ *  the call to FrameHandoff::notify() that first covered a frame.
+ */
+struct Notification
+{
+    std::atomic<double> before; // right before the call
+    std::atomic<double> after;  // after it has returned
+};
+
+struct Result
+{
+    uint64_t received;
+    uint64_t lost;        // out of order or missing
+    uint64_t stalls;
+    uint64_t mismatched;
+    uint64_t polled;      // found before their notification
+    uint64_t hung;        // quiet periods that the dequeue thread slept through
+    bool     drained;
+    LatencyHistogram handoff;  // as reported by FrameHandoff::popped()
+    LatencyHistogram total;    // from queueing to the dequeue
+
+    Result(): received(0), lost(0), stalls(0), mismatched(0), polled(0), hung(0), drained(false) { }
+};
+
+/**
+ *  waits for the dequeue thread to empty the sink without any further notification.
+ *  @return false if it did not within `timeout` seconds.
+ */
+static bool wait_drained(FakeSink *sink, const double& timeout)
+{
+    const double due = monotonic_seconds() + timeout;
+    while (sink->getOutputQueueSize() > 0) {
+        if (monotonic_seconds() > due) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+    return true;
+}
+
+static void produce(FakeSink *sink, FrameHandoff<FakeSink> *handoff, const Options *options,
+                    std::vector<std::atomic<double>> *queued_at,
+                    std::vector<Notification> *notified, Result *result)
+{
+    std::mt19937_64 random(options->seed);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    uint64_t unnotified = 0; // the first frame not notified yet
+    for (uint64_t frame = 0; frame < options->frames; frame++) {
+        // the interval between the frames
+        const double draw = uniform(random);
+        if (draw < 0.01) {
+            std::this_thread::sleep_for(std::chrono::microseconds((int)(1000 * uniform(random))));
+        } else if (draw < 0.10) {
+            std::this_thread::yield();
+        } else {
+            spin_for(2 * options->gap * uniform(random));
+        }
+
+        (*queued_at)[frame].store(monotonic_seconds(), std::memory_order_relaxed);
+        sink->queue(frame);
+
+        // notifications may be late, and may cover several frames
+        const double delay = uniform(random);
+        if ((delay < 0.2) && (frame + 1 < options->frames)) {
+            continue;
+        } else if (delay < 0.3) {
+            spin_for(20e-6 * uniform(random));
+        } else if (delay < 0.31) {
+            std::this_thread::yield();
+        }
+        const uint64_t first = unnotified;
+        const double   now   = monotonic_seconds();
+        for (; unnotified <= frame; unnotified++) {
+            (*notified)[unnotified].before.store(now, std::memory_order_release);
+        }
+        handoff->notify(*sink, false);
+        const double after = monotonic_seconds();
+        for (uint64_t i = first; i <= frame; i++) {
+            (*notified)[i].after.store(after, std::memory_order_release);
+        }
+
+        // a lost notification shows up when no other frame comes to the rescue
+        if ((uniform(random) < options->quiet) && !wait_drained(sink, options->stall)) {
+            result->hung++;
+        }
+    }
+}
+
+static void consume(FakeSink *sink, FrameHandoff<FakeSink> *handoff, const Options *options,
+                    std::vector<std::atomic<double>> *queued_at,
+                    std::vector<Notification> *notified, Result *result)
+{
+    std::mt19937_64 random(options->seed + 1);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    uint64_t expected = 0;
+    while (handoff->wait(*sink)) {
+        handoff->popping();
+        const uint64_t frame   = sink->pop();
+        const double   now     = monotonic_seconds();
+        const double   latency = handoff->popped(now);
+        if (frame != expected) {
+            result->lost++;
+        }
+        expected = frame + 1;
+        result->received++;
+
+        const double total = now - (*queued_at)[frame].load(std::memory_order_relaxed);
+        result->total.record(total);
+        if (total > options->stall) {
+            result->stalls++;
+        }
+        // read in the reverse order of the writes
+        const double after  = (*notified)[frame].after.load(std::memory_order_acquire);
+        const double before = (*notified)[frame].before.load(std::memory_order_acquire);
+        if ((latency == 0.0) && (after == 0.0)) {
+            // found by polling, before its notification had stamped it
+            result->polled++;
+        } else {
+            result->handoff.record(latency);
+            // the stamp must have been taken within the notification
+            const double slack = 1e-6;
+            if ((before == 0.0) || (latency > now - before + slack)
+                || ((after > 0.0) && (latency < now - after - slack))) {
+                result->mismatched++;
+            }
+        }
+
+        // the stages and the consumers take their time
+        const double draw = uniform(random);
+        if (draw < 0.005) {
+            std::this_thread::sleep_for(std::chrono::microseconds((int)(200 * uniform(random))));
+        } else if (draw < 0.05) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+static bool run(const char *label, const WaitStrategy& strategy, const double& spin_budget,
+                const Options& options)
+{
+    FakeSink               sink(options.seed + 2);
+    FrameHandoff<FakeSink> handoff;
+    Result                 result;
+    std::vector<std::atomic<double>> queued_at(options.frames);
+    std::vector<Notification>        notified(options.frames);
+    for (uint64_t i = 0; i < options.frames; i++) {
+        queued_at[i].store(0.0, std::memory_order_relaxed);
+        notified[i].before.store(0.0, std::memory_order_relaxed);
+        notified[i].after.store(0.0, std::memory_order_relaxed);
+    }
+    handoff.strategy(strategy, spin_budget);
+    handoff.reset();
+
+    const double start = monotonic_seconds();
+    std::thread consumer(consume, &sink, &handoff, &options, &queued_at, &notified, &result);
+    produce(&sink, &handoff, &options, &queued_at, &notified, &result);
+    result.drained = wait_drained(&sink, options.drain);
+    handoff.quit();
+    consumer.join();
+    const double elapsed = monotonic_seconds() - start;
+
+    const uint64_t missing = options.frames - result.received;
+    std::printf("%-24s %llu frames in %.1f s, %llu lost, %llu stalls, %llu lost wake-ups, "
+                "%llu mismatched, %llu found before notification%s\n", label,
+                (unsigned long long)result.received, elapsed,
+                (unsigned long long)(result.lost + missing), (unsigned long long)result.stalls,
+                (unsigned long long)result.hung, (unsigned long long)result.mismatched,
+                (unsigned long long)result.polled, result.drained? "" : "; NOT DRAINED");
+    print_latency("  handoff (reported)", &result.handoff);
+    print_latency("  queue to dequeue", &result.total);
+    return result.drained && (result.hung == 0) && (result.lost == 0) && (missing == 0)
+           && (result.mismatched == 0);
+}
+
+int main(int argc, char **argv)
+{
+    std::string value;
+    std::string strategy    = "both";
+    double      spin_budget = 50e-6;
+    Options     options     = { 2000000, 5e-6, 0.1, 1.0, 1, 0.002 };
+
+    for (int i = 1; i < argc; i++) {
+        if (option(argv[i], "--frames", value)) {
+            options.frames = std::stoull(value);
+        } else if (option(argv[i], "--strategy", value)) {
+            strategy = value;
+        } else if (option(argv[i], "--spin-budget", value)) {
+            spin_budget = std::stod(value);
+        } else if (option(argv[i], "--gap", value)) {
+            options.gap = std::stod(value);
+        } else if (option(argv[i], "--stall", value)) {
+            options.stall = std::stod(value);
+        } else if (option(argv[i], "--drain", value)) {
+            options.drain = std::stod(value);
+        } else if (option(argv[i], "--quiet", value)) {
+            options.quiet = std::stod(value);
+        } else if (option(argv[i], "--seed", value)) {
+            options.seed = std::stoull(value);
+        } else {
+            std::fprintf(stderr, "usage: %s [--frames=N] [--strategy=block|spin|both] [--spin-budget=s] "
+                                 "[--gap=s] [--stall=s] [--drain=s] [--quiet=p] [--seed=N]\n", argv[0]);
+            return 1;
+        }
+    }
+    if ((strategy != "block") && (strategy != "spin") && (strategy != "both")) {
+        std::fprintf(stderr, "unknown strategy: '%s'\n", strategy.c_str());
+        return 1;
+    }
+
+    bool passed = true;
+    if (strategy != "spin") {
+        passed = run("block", WaitBlocking, 0.0, options) && passed;
+    }
+    if (strategy != "block") {
+        passed = run("spin", WaitSpinning, spin_budget, options) && passed;
+    }
+    std::printf("%s\n", passed? "PASSED" : "FAILED");
+    return passed? 0 : 1;
+}
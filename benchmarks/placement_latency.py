@@ -0,0 +1,114 @@
+# MIT License
+#
+# Copyright (c) 2021 Keisuke Sehara
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in all
+# copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+
+
+"""compares the latency jitter of the acquisition threads with and without thread placement.
+
+usage: python benchmarks/placement_latency.py --cpus 2,3 [--priority 50] [--load 8]
+                                              [--device NAME] [--duration SEC] [--rate FPS]
+
+requires a connected camera. each configuration acquires for `--duration` seconds while
+`--load` processes keep the other cores busy (standing in for encoding), and reports the
+distributions of the 'dequeue' latency (from the notification of each frame to its dequeue)
+and of the 'delivery' latency (from the dequeue to the start of the callback):
+
+- default: the threads are left to the OS.
+- pinned:  the dequeue thread on the first of `--cpus`, and the delivery thread on the second.
+- pinned+rt: the same, with SCHED_FIFO `--priority` (needs the privileges; the failure is
+  only reported otherwise, and the row then equals 'pinned').
+
+the spread between p50 and p99.9 is the jitter that the placement is meant to reduce.
+"""
+
+import argparse
+import multiprocessing
+import time
+
+import labcamera_tis as tis
+
+def burn(stop):
+    x = 0
+    while not stop.is_set():
+        for i in range(100000):
+            x = (x * 31 + i) % 1000003
+
+def configure(device, cpus, priority, realtime):
+    dequeue  = cpus[:1]
+    delivery = cpus[1:2] if len(cpus) > 1 else cpus[:1]
+    device.set_thread_placement('dequeue', cpus=dequeue, priority=priority, realtime=realtime)
+    device.set_thread_placement('delivery', cpus=delivery, priority=priority, realtime=realtime)
+
+def measure(device, duration, buffer_size):
+    device.prepare(buffer_size=buffer_size, queue_size=4)
+    device.start()
+    time.sleep(duration)
+    device.stop()
+    return device.latency
+
+def report(label, latency):
+    for thread in ('dequeue', 'delivery'):
+        stats  = latency[thread]
+        spread = stats['p999_us'] - stats['p50_us']
+        print(f"{label:<10} {thread:<9} {stats['count']:>8d} {stats['p50_us']:>10.1f} {stats['p99_us']:>10.1f} "
+              f"{stats['p999_us']:>11.1f} {stats['max_us']:>10.1f} {spread:>12.1f}", flush=True)
+
+def run(args):
+    cpus   = tuple(int(cpu) for cpu in args.cpus.split(','))
+    name   = args.device if args.device is not None else tis.Device.list_names()[0]
+    device = tis.Device(name)
+    device.video_format = args.format
+    device.frame_rate   = args.rate
+    device.callbacks.append(lambda frame: None)
+
+    configs = [('default', (), 0, False),
+               ('pinned', cpus, 0, False)]
+    if args.priority > 0:
+        configs.append(('pinned+rt', cpus, args.priority, True))
+
+    stop  = multiprocessing.Event()
+    loads = [multiprocessing.Process(target=burn, args=(stop,), daemon=True) for _ in range(args.load)]
+    for load in loads:
+        load.start()
+    try:
+        print(f"{'config':<10} {'thread':<9} {'frames':>8} {'p50 (us)':>10} {'p99 (us)':>10} "
+              f"{'p99.9 (us)':>11} {'max (us)':>10} {'spread (us)':>12}")
+        for label, config_cpus, priority, realtime in configs:
+            configure(device, config_cpus, priority, realtime)
+            report(label, measure(device, args.duration, args.buffers))
+    finally:
+        stop.set()
+        for load in loads:
+            load.join()
+        device.close()
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('--cpus', required=True, help="comma-separated CPUs for the dequeue and delivery threads")
+    parser.add_argument('--priority', type=int, default=0, help="the SCHED_FIFO priority to try (0 to skip)")
+    parser.add_argument('--load', type=int, default=multiprocessing.cpu_count() - 2,
+                        help="the number of processes that keep the other cores busy")
+    parser.add_argument('--device', default=None, help="the unique name of the device")
+    parser.add_argument('--format', default=tis.DEFAULT_VIDEO_FORMAT, help="the video format")
+    parser.add_argument('--rate', type=float, default=100.0, help="the frame rate")
+    parser.add_argument('--duration', type=float, default=30.0, help="seconds per configuration")
+    parser.add_argument('--buffers', type=int, default=16, help="the number of sink buffers")
+    run(parser.parse_args())
@@ -0,0 +1,367 @@
+/*
+ *  MIT License
+ *
+ *  Copyright (c) 2021 Keisuke Sehara
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+*/
+/*
+ *  replays a recording through the frame pipeline, with the same stages
+ *  and consumers as during acquisition. does not require the SDK.
+ *
+ *  ./frame_replay recording.raw --format=Y800 --width=1440 --height=1080 \
+ *      --index=recording.idx --timing=original --stages=histogram,blobs --consumers=2
+ *
+ *  --timing is one of 'original' (the default; requires --index or --rate),
+ *  'rate' (at --rate frames per second) or 'fastest'. --huge-pages, --lock and
+ *  --numa=N set the memory policy of the frame pool. --tiff=path writes the frames
+ *  into BigTIFF files through a consumer, with --tiff-compression=none|deflate,
+ *  --tiff-level=1-9 and --tiff-max-mb=N (per file). --tiff-streams=N writes as many
+ *  copies of the stream (<stem>_s1<ext>, ...), as if from N devices, and
+ *  --tiff-targets=dir,dir,... writes them through a WriteScheduler onto the directories.
+ */
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "replay_utils.hpp"
+#include "pixelstats_utils.hpp"
+#include "histogram_utils.hpp"
+#include "motion_utils.hpp"
+#include "preview_utils.hpp"
+#include "blob_utils.hpp"
+#include "sync_utils.hpp"
+#include "tiff_utils.hpp"
+#include "io_utils.hpp"
+
+static bool option(const char *arg, const char *name, std::string& value)
+{
+    size_t len = std::strlen(name);
+    if ((std::strncmp(arg, name, len) == 0) && (arg[len] == '=')) {
+        value = arg + len + 1;
+        return true;
+    }
+    return false;
+}
+
+static std::vector<std::string> split(const std::string& value)
+{
+    std::vector<std::string> items;
+    std::istringstream       in(value);
+    std::string              item;
+    while (std::getline(in, item, ',')) {
+        if (!item.empty()) {
+            items.push_back(item);
+        }
+    }
+    return items;
+}
+
+/**
+ *  @return `path` with `_s<index>` before its extension.
+ */
+static std::string suffixed(const std::string& path, const size_t& index)
+{
+    const size_t dot   = path.find_last_of('.');
+    const size_t slash = path.find_last_of("/\\");
+    const std::string suffix = "_s" + std::to_string(index);
+    if ((dot == std::string::npos) || ((slash != std::string::npos) && (dot < slash))) {
+        return path + suffix;
+    }
+    return path.substr(0, dot) + suffix + path.substr(dot);
+}
+
+static bool parse_format(const std::string& name, ColorFormat& color, unsigned& bits)
+{
+    if (name == "Y800") {
+        color = FormatY800;  bits = 8;
+    } else if (name == "Y16") {
+        color = FormatY16;   bits = 16;
+    } else if (name == "RGB24") {
+        color = FormatRGB24; bits = 24;
+    } else if (name == "RGB32") {
+        color = FormatRGB32; bits = 32;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+static FrameStage *create_stage(const std::string& name)
+{
+    if (name == "pixel_stats") {
+        return new PixelStatsStage();
+    } else if (name == "histogram") {
+        return new HistogramStage();
+    } else if (name == "motion_energy") {
+        return new MotionEnergyStage();
+    } else if (name == "preview") {
+        return new PreviewStage(4, 30.0);
+    } else if (name == "blobs") {
+        return new BlobStage();
+    } else if (name == "sync_pulse") {
+        return new SyncPulseStage();
+    }
+    return nullptr;
+}
+
+/**
+ *  reads every cache line of the frame, as a writer would.
+ */
+static void touch_frame(FrameSlot *slot, void *user_data)
+{
+    if (slot == nullptr) {
+        return;
+    }
+    uint64_t sum = 0;
+    for (size_t i = 0; i < slot->size; i += 64) {
+        sum += slot->data[i];
+    }
+    *((volatile uint64_t *)user_data) += sum;
+}
+
+static void print_latency(const char *label, const LatencyHistogram *latency)
+{
+    if (latency->count() == 0) {
+        return;
+    }
+    std::printf("%-24s p50 %10.1f us  p99 %10.1f us  max %10.1f us\n", label,
+                1e6 * latency->percentile(0.5), 1e6 * latency->percentile(0.99),
+                1e6 * latency->max());
+}
+
+int main(int argc, char **argv)
+{
+    std::string  path, index, value;
+    std::string  format_name = "Y800";
+    FrameFormat  format      = { FormatY800, 8, 0, 0, 0, false };
+    ReplayTiming timing      = ReplayOriginal;
+    double       rate        = 0.0;
+    size_t       loops       = 1;
+    bool         preload     = false;
+    std::vector<std::string> stage_names;
+    size_t         consumers = 0;
+    size_t         depth     = 4;
+    DeliveryPolicy policy    = DeliverAll;
+    std::vector<std::string> crop;
+    MemoryPolicy   memory;
+    std::string     tiff;
+    TiffCompression compression = TiffNone;
+    int             level       = 1;
+    uint64_t        max_bytes   = 0;
+    size_t          streams     = 1;
+    std::vector<std::string> targets;
+
+    for (int i = 1; i < argc; i++) {
+        if (option(argv[i], "--format", format_name)) {
+            if (!parse_format(format_name, format.color, format.bits_per_pixel)) {
+                std::fprintf(stderr, "unknown format: %s\n", format_name.c_str());
+                return 1;
+            }
+        } else if (option(argv[i], "--width", value)) {
+            format.width = std::stoul(value);
+        } else if (option(argv[i], "--height", value)) {
+            format.height = std::stoul(value);
+        } else if (std::strcmp(argv[i], "--bottom-up") == 0) {
+            format.bottom_up = true;
+        } else if (option(argv[i], "--index", index)) {
+        } else if (option(argv[i], "--timing", value)) {
+            if (value == "original") {
+                timing = ReplayOriginal;
+            } else if (value == "rate") {
+                timing = ReplayFixedRate;
+            } else if (value == "fastest") {
+                timing = ReplayFastest;
+            } else {
+                std::fprintf(stderr, "unknown timing: %s\n", value.c_str());
+                return 1;
+            }
+        } else if (option(argv[i], "--rate", value)) {
+            rate = std::stod(value);
+        } else if (option(argv[i], "--loops", value)) {
+            loops = std::stoul(value);
+        } else if (std::strcmp(argv[i], "--preload") == 0) {
+            preload = true;
+        } else if (option(argv[i], "--stages", value)) {
+            stage_names = split(value);
+        } else if (option(argv[i], "--consumers", value)) {
+            consumers = std::stoul(value);
+        } else if (option(argv[i], "--depth", value)) {
+            depth = std::stoul(value);
+        } else if (option(argv[i], "--policy", value)) {
+            policy = (value == "latest")? DeliverLatest : DeliverAll;
+        } else if (option(argv[i], "--crop", value)) {
+            crop = split(value);
+        } else if (std::strcmp(argv[i], "--huge-pages") == 0) {
+            memory.huge_pages = true;
+        } else if (std::strcmp(argv[i], "--lock") == 0) {
+            memory.lock = true;
+        } else if (option(argv[i], "--numa", value)) {
+            memory.numa_node = std::stoi(value);
+        } else if (option(argv[i], "--tiff", tiff)) {
+        } else if (option(argv[i], "--tiff-compression", value)) {
+            if (value == "none") {
+                compression = TiffNone;
+            } else if (value == "deflate") {
+                compression = TiffDeflate;
+            } else {
+                std::fprintf(stderr, "unknown compression: %s\n", value.c_str());
+                return 1;
+            }
+        } else if (option(argv[i], "--tiff-level", value)) {
+            level = std::stoi(value);
+        } else if (option(argv[i], "--tiff-max-mb", value)) {
+            max_bytes = (uint64_t)(std::stod(value) * 1048576);
+        } else if (option(argv[i], "--tiff-streams", value)) {
+            streams = std::max((size_t)std::stoul(value), (size_t)1);
+        } else if (option(argv[i], "--tiff-targets", value)) {
+            targets = split(value);
+        } else if ((argv[i][0] != '-') && path.empty()) {
+            path = argv[i];
+        } else {
+            std::fprintf(stderr, "unknown option: %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (path.empty() || (format.width == 0) || (format.height == 0)) {
+        std::fprintf(stderr, "usage: %s <recording> --width=W --height=H [--format=Y800|Y16|RGB24|RGB32] "
+                             "[--bottom-up] [--index=path] [--timing=original|rate|fastest] [--rate=R] "
+                             "[--loops=N] [--preload] [--stages=a,b,...] [--consumers=N] [--depth=D] "
+                             "[--policy=all|latest] [--crop=x,y,w,h[,bin]] [--huge-pages] [--lock] [--numa=N] "
+                             "[--tiff=path] [--tiff-compression=none|deflate] [--tiff-level=L] "
+                             "[--tiff-max-mb=N] [--tiff-streams=N] [--tiff-targets=dir,dir,...]\n", argv[0]);
+        return 1;
+    }
+    format.size = format.width * format.height * (format.bits_per_pixel / 8);
+
+    ReplaySource source;
+    if (!source.open(path, format, index, preload)) {
+        return 1;
+    }
+
+    FramePipeline pipeline(nullptr, nullptr);
+    pipeline.memory(memory);
+    std::vector<std::unique_ptr<FrameStage>> stages;
+    for (const std::string& name: stage_names) {
+        FrameStage *stage = create_stage(name);
+        if (stage == nullptr) {
+            std::fprintf(stderr, "unknown stage: %s\n", name.c_str());
+            return 1;
+        }
+        stages.emplace_back(stage);
+        pipeline.add_stage(stage);
+    }
+
+    std::vector<uint64_t> sums(consumers + 1, 0);
+    for (size_t i = 0; i < consumers; i++) {
+        pipeline.add_consumer(touch_frame, &sums[i + 1], policy, depth, 0.0);
+    }
+
+    FrameFormat written = format; // as delivered to the consumers
+    if (!crop.empty()) {
+        if ((crop.size() < 4) || (crop.size() > 5)) {
+            std::fprintf(stderr, "--crop takes x,y,width,height[,bin]\n");
+            return 1;
+        }
+        FrameCrop region;
+        region.region(std::stoul(crop[0]), std::stoul(crop[1]), std::stoul(crop[2]), std::stoul(crop[3]));
+        region.binning((crop.size() == 5)? std::stoul(crop[4]) : 1);
+        pipeline.crop(region);
+        if (region.prepare(format)) {
+            written = region.output();
+        }
+    }
+
+    WriteScheduler scheduler;
+    for (const std::string& target: targets) {
+        scheduler.add_target(target);
+    }
+    std::vector<std::unique_ptr<TiffWriter>> writers;
+    for (size_t i = 0; (i < streams) && !tiff.empty(); i++) {
+        const std::string stream_path = (streams > 1)? suffixed(tiff, i + 1) : tiff;
+        writers.emplace_back(new TiffWriter());
+        TiffWriter *writer = writers.back().get();
+        if (!targets.empty()) {
+            writer->stream(scheduler.stream(stream_path));
+        }
+        if (!writer->configure(stream_path, compression, level, max_bytes, 0)) {
+            std::fprintf(stderr, "deflate compression is not available in this build\n");
+            return 1;
+        }
+        if (!writer->prepare(written)) {
+            std::fprintf(stderr, "the frames cannot be written into TIFF files\n");
+            return 1;
+        }
+        pipeline.add_consumer(tiff_slot_callback, writer, DeliverAll, depth, 0.0);
+    }
+
+    std::printf("replaying %zu frames (%s) x %zu\n", source.frames(), format_name.c_str(), loops);
+    ReplayStats stats = source.run(pipeline, timing, rate, loops);
+
+    std::printf("%-24s %llu frames in %.3f s (%.1f frames/s, %.1f MB/s)\n", "total",
+                (unsigned long long)stats.frames, stats.elapsed,
+                stats.frames / stats.elapsed, 1e-6 * stats.frames * format.size / stats.elapsed);
+    if (timing != ReplayFastest) {
+        std::printf("%-24s %.1f us\n", "max lag", 1e6 * stats.max_lag);
+    }
+    for (size_t i = 1; i < pipeline.consumers(); i++) {
+        if (!pipeline.is_active(i)) {
+            continue;
+        }
+        DeliveryStats delivery = pipeline.consumer_stats(i);
+        char label[32];
+        std::snprintf(label, sizeof(label), "consumer #%zu", i);
+        std::printf("%-24s delivered %llu of %llu, overwritten %llu, stalled %llu times\n", label,
+                    (unsigned long long)delivery.delivered, (unsigned long long)delivery.received,
+                    (unsigned long long)delivery.overwritten, (unsigned long long)delivery.stalled);
+        print_latency(label, pipeline.consumer_latency(i));
+    }
+    for (size_t i = 0; i < writers.size(); i++) {
+        TiffStats written_stats = writers[i]->stats();
+        char label[32];
+        std::snprintf(label, sizeof(label), (writers.size() > 1)? "tiff #%zu" : "tiff", i + 1);
+        std::printf("%-24s %llu frames into %llu files (%.1f MB), %llu errors\n", label,
+                    (unsigned long long)written_stats.frames, (unsigned long long)written_stats.files,
+                    1e-6 * written_stats.bytes, (unsigned long long)written_stats.errors);
+        for (const std::string& path: writers[i]->paths()) {
+            std::printf("%-24s %s\n", "", path.c_str());
+        }
+    }
+    if (!targets.empty()) {
+        const double drained = monotonic_seconds();
+        scheduler.drain();
+        std::printf("%-24s %.3f s after the replay\n", "drained", monotonic_seconds() - drained);
+        for (size_t i = 0; i < scheduler.stream_count(); i++) {
+            StreamStats io = scheduler.stream_at(i)->stats();
+            std::printf("%-24s %.1f MB written, max lag %.1f ms, stalled %llu times (%.3f s), %llu errors\n",
+                        scheduler.stream_at(i)->name().c_str(), 1e-6 * io.written, 1e3 * io.max_lag,
+                        (unsigned long long)io.stalls, io.stalled, (unsigned long long)io.errors);
+        }
+        for (size_t i = 0; i < scheduler.target_count(); i++) {
+            TargetStats target = scheduler.target_stats(i);
+            std::printf("%-24s %.1f MB in %zu files\n", scheduler.target_root(i).c_str(),
+                        1e-6 * target.written, target.files);
+        }
+    }
+    return 0;
+}
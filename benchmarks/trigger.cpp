@@ -0,0 +1,129 @@
+/*
+ *  MIT License
+ *
+ *  Copyright (c) 2021 Keisuke Sehara
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+*/
+/*
+ *  measures trigger-to-frame latencies against a simulated triggered camera,
+ *  with the same analysis as for a device (TriggerLatencyStage). does not require the SDK.
+ *
+ *  ./frame_trigger --count=1000 --period=0.01 --latency=0.002 --jitter=0.0002 --miss=0.01
+ *
+ *  --latency and --jitter (the standard deviation) are in seconds, and --miss is
+ *  the probability that the simulated camera ignores a trigger. --timeout is the time
+ *  after which a trigger without a frame is counted as missed (by default, the latency
+ *  plus 5 times the jitter, and at least the period). --width and --height
+ *  set the size of the Y800 frames that go through the pipeline.
+ */
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include "trigger_utils.hpp"
+
+static bool option(const char *arg, const char *name, std::string& value)
+{
+    size_t len = std::strlen(name);
+    if ((std::strncmp(arg, name, len) == 0) && (arg[len] == '=')) {
+        value = arg + len + 1;
+        return true;
+    }
+    return false;
+}
+
+static void print_latency(const char *label, const LatencyHistogram *latency)
+{
+    if (latency->count() == 0) {
+        return;
+    }
+    std::printf("%-24s p50 %10.1f us  p90 %10.1f us  p99 %10.1f us  max %10.1f us\n", label,
+                1e6 * latency->percentile(0.5), 1e6 * latency->percentile(0.9),
+                1e6 * latency->percentile(0.99), 1e6 * latency->max());
+}
+
+int main(int argc, char **argv)
+{
+    std::string value;
+    uint64_t    count   = 1000;
+    double      period  = 0.01;
+    double      latency = 0.002;
+    double      jitter  = 0.0002;
+    double      miss    = 0.0;
+    double      timeout = 0.0;
+    FrameFormat format  = { FormatY800, 8, 640, 480, 0, false };
+
+    for (int i = 1; i < argc; i++) {
+        if (option(argv[i], "--count", value)) {
+            count = std::stoull(value);
+        } else if (option(argv[i], "--period", value)) {
+            period = std::stod(value);
+        } else if (option(argv[i], "--latency", value)) {
+            latency = std::stod(value);
+        } else if (option(argv[i], "--jitter", value)) {
+            jitter = std::stod(value);
+        } else if (option(argv[i], "--miss", value)) {
+            miss = std::stod(value);
+        } else if (option(argv[i], "--timeout", value)) {
+            timeout = std::stod(value);
+        } else if (option(argv[i], "--width", value)) {
+            format.width = std::stoul(value);
+        } else if (option(argv[i], "--height", value)) {
+            format.height = std::stoul(value);
+        } else {
+            std::fprintf(stderr, "usage: %s [--count=N] [--period=s] [--latency=s] [--jitter=s] "
+                                 "[--miss=p] [--timeout=s] [--width=W] [--height=H]\n", argv[0]);
+            return 1;
+        }
+    }
+    if ((period <= 0.0) || (latency < 0.0) || (jitter < 0.0)) {
+        std::fprintf(stderr, "--period must be positive, and --latency and --jitter must not be negative\n");
+        return 1;
+    }
+    if (timeout <= 0.0) {
+        // covers the jitter, while a missed trigger is still expired before the next frame
+        timeout = std::max(period, latency + 5 * jitter);
+    }
+    format.size = format.width * format.height;
+
+    TriggerLatencyStage stage(timeout, (size_t)count + 1);
+    FramePipeline       pipeline(nullptr, nullptr);
+    pipeline.add_stage(&stage);
+    TriggerSimulator    camera(&pipeline, format, latency, jitter, miss);
+
+    std::printf("firing %llu triggers every %.3f ms (simulated latency %.1f +/- %.1f us, miss %.3f)\n",
+                (unsigned long long)count, 1e3 * period, 1e6 * latency, 1e6 * jitter, miss);
+    camera.start();
+    stage.run(TriggerSimulator::fire, &camera, count, period);
+    camera.stop();
+
+    TriggerStats stats = stage.stats();
+    std::printf("%-24s %llu fired, %llu matched, %llu missed (%llu skipped by the camera), %llu unexpected\n",
+                "triggers", (unsigned long long)stats.fired, (unsigned long long)stats.matched,
+                (unsigned long long)stats.missed, (unsigned long long)camera.skipped(),
+                (unsigned long long)stats.unexpected);
+    std::printf("%-24s mean %10.1f us  jitter %7.1f us  min %10.1f us  max %10.1f us\n", "latency",
+                1e6 * stats.mean, 1e6 * stats.jitter, 1e6 * stats.min, 1e6 * stats.max);
+    print_latency("latency", stage.latency());
+    print_latency("issue", stage.issue());
+    print_latency("schedule lateness", stage.lateness());
+    return 0;
+}
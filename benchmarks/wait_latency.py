@@ -0,0 +1,76 @@
+# MIT License
+#
+# Copyright (c) 2021 Keisuke Sehara
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in all
+# copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+
+"""compares the frame-to-callback latency of the wait strategies of the dequeue thread.
+
+usage: python benchmarks/wait_latency.py [--device NAME] [--duration SEC] [--rate FPS]
+
+requires a connected camera. the callbacks run on the dequeue thread (queue_size=0),
+so that the 'dequeue' latency of `Device.latency` equals the latency from the
+notification of a frame to the start of the callback.
+"""
+
+import argparse
+import time
+
+import labcamera_tis as tis
+
+STRATEGIES = (
+    ('block', 0),
+    ('spin', 0),
+    ('spin', 1000),
+)
+
+def measure(device, strategy, spin_budget_us, duration, buffer_size, cpu):
+    device.set_wait_strategy(strategy, spin_budget_us=spin_budget_us)
+    if cpu is not None:
+        device.set_thread_placement('dequeue', cpus=(cpu,))
+    device.prepare(buffer_size=buffer_size)
+    device.start()
+    time.sleep(duration)
+    device.stop()
+    return device.latency['dequeue']
+
+def run(args):
+    name   = args.device if args.device is not None else tis.Device.list_names()[0]
+    device = tis.Device(name)
+    device.video_format = args.format
+    device.frame_rate   = args.rate
+    device.callbacks.append(lambda frame: None)
+
+    print(f"{'strategy':<16} {'frames':>8} {'p50 (us)':>10} {'p99 (us)':>10} {'p99.9 (us)':>11} {'max (us)':>10}")
+    for strategy, budget in STRATEGIES:
+        label = strategy if budget == 0 else f"{strategy}({budget}us)"
+        stats = measure(device, strategy, budget, args.duration, args.buffers, args.cpu)
+        print(f"{label:<16} {stats['count']:>8d} {stats['p50_us']:>10.1f} {stats['p99_us']:>10.1f} "
+              f"{stats['p999_us']:>11.1f} {stats['max_us']:>10.1f}", flush=True)
+    device.close()
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('--device', default=None, help="the unique name of the device")
+    parser.add_argument('--format', default=tis.DEFAULT_VIDEO_FORMAT, help="the video format")
+    parser.add_argument('--rate', type=float, default=100.0, help="the frame rate")
+    parser.add_argument('--duration', type=float, default=30.0, help="seconds per strategy")
+    parser.add_argument('--buffers', type=int, default=16, help="the number of sink buffers")
+    parser.add_argument('--cpu', type=int, default=None, help="pins the dequeue thread to this CPU")
+    run(parser.parse_args())
@@ -20,7 +20,11 @@
 # OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 # SOFTWARE.
 
+cimport cython
 from cython.operator cimport dereference as deref, preincrement as inc
+from cpython.buffer cimport PyBUF_ND, PyBUF_STRIDES, PyBUF_FORMAT
+from cpython.pycapsule cimport PyCapsule_New, PyCapsule_IsValid, PyCapsule_GetPointer
+from cpython.ref cimport Py_INCREF, Py_DECREF
 from libcpp cimport bool as cppbool
 from libcpp.vector cimport vector as stdvector
 from libcpp.string cimport string as stdstring
@@ -301,6 +305,377 @@ cdef extern from "property_utils.hpp" nogil:
     stdvector[stdstring] getStringOptions(MapStringsInterfacePtr& options)
     void setCurrentString(MapStringsInterfacePtr& options, const stdstring& newval)
 
+##
+#   the internal frame pool that decouples callbacks from the sink buffers
+#
+cdef extern from "pool_utils.hpp" nogil:
+    cdef struct FrameSlot:
+        uint8_t  *data
+        size_t    size
+        uint64_t  sequence
+        double    timestamp
+
+    cdef enum DeliveryPolicy:
+        DeliverAll
+        DeliverLatest
+        DeliverDecimated
+
+    cdef struct DeliveryStats:
+        uint64_t received
+        uint64_t delivered
+        uint64_t overwritten
+        uint64_t decimated
+        uint64_t stalled
+
+    cdef cppclass FrameHold:
+        uint8_t *data() const
+
+cdef extern from "batch_utils.hpp" nogil:
+    cdef struct NativeFrameBatch "FrameBatch":
+        FrameSlot      *block
+        size_t          frame_size
+        size_t          count
+        const uint64_t *sequences
+        const double   *timestamps
+
+    ctypedef void (*BatchCallback)(NativeFrameBatch *batch, void *user_data)
+
+    cdef cppclass FrameBatcher:
+        FrameBatcher(BatchCallback callback, void *user_data, const size_t& length)
+        void       holds(const size_t& count)
+        FrameHold *hold(const uint8_t *data)
+        size_t     length() const
+
+    void batch_slot_callback(FrameSlot *slot, void *batcher)
+
+##
+#   zero-copy export of frames to other libraries
+#
+cdef extern from "dlpack_utils.hpp" nogil:
+    cdef enum DLDeviceType:
+        kDLCPU
+
+    cdef struct DLManagedTensor:
+        void (*deleter)(DLManagedTensor *self)
+
+    ctypedef void (*TensorRelease)(void *context)
+
+    DLManagedTensor *export_tensor(void *data, const int& ndim, const int64_t *shape,
+                                   const int64_t *strides, const uint8_t& bits,
+                                   TensorRelease release, void *context)
+
+##
+#   scheduling of the acquisition threads
+#
+cdef extern from "thread_utils.hpp" nogil:
+    cdef enum WaitStrategy:
+        WaitBlocking
+        WaitSpinning
+
+    cdef cppclass ThreadPlacement:
+        ThreadPlacement()
+        stdvector[int] cpus
+        int            priority
+        cppbool        realtime
+
+cdef extern from "memory_utils.hpp" nogil:
+    cdef cppclass MemoryPolicy:
+        MemoryPolicy()
+        cppbool huge_pages
+        cppbool lock
+        int     numa_node
+
+cdef extern from "stats_utils.hpp" nogil:
+    cdef cppclass LatencyHistogram:
+        uint64_t count() const
+        double   max() const
+        double   percentile(const double& q) const
+
+##
+#   pixel kernels, selected for the instruction set of the CPU
+#
+cdef extern from "simd_utils.hpp" nogil:
+    cdef enum IsaLevel:
+        IsaScalar
+        IsaSSE2
+        IsaAVX2
+        IsaAVX512
+
+    cdef struct PixelKernels:
+        IsaLevel isa
+
+    IsaLevel supported_isa()
+    cppbool  select_isa(const IsaLevel& level)
+    const PixelKernels& pixel_kernels()
+    const char *isa_name(const IsaLevel& level)
+
+##
+#   processing stages that run natively on every frame
+#
+cdef extern from "format_utils.hpp" nogil:
+    cdef struct FrameFormat:
+        size_t width
+        size_t height
+        size_t size
+
+cdef extern from "stage_utils.hpp" nogil:
+    cdef cppclass FrameStage:
+        const char *name() const
+
+cdef extern from "crop_utils.hpp" nogil:
+    cdef cppclass FrameCrop:
+        FrameCrop()
+        void    region(const size_t& x, const size_t& y, const size_t& width, const size_t& height)
+        void    binning(const size_t& bin)
+        void    clear()
+        cppbool active() const
+        size_t  bin() const
+        cppbool prepare(const FrameFormat& format)
+        const FrameFormat& output() const
+
+cdef extern from "pixelstats_utils.hpp" nogil:
+    cdef cppclass PixelStatsStage(FrameStage):
+        PixelStatsStage()
+        void     reset()
+        uint64_t count() const
+        size_t   width() const
+        size_t   height() const
+        size_t   channels() const
+        uint64_t snapshot(double *mean, double *variance, double *minimum, double *maximum,
+                          const size_t& capacity)
+
+cdef extern from "histogram_utils.hpp" nogil:
+    cdef struct HistogramSummary:
+        uint64_t sequence
+        double   timestamp
+        uint64_t count
+        double   mean
+        double   saturated
+        double   low
+        double   median
+        double   high
+
+    cdef struct ExposureSettings:
+        double exposure
+        double gain
+
+    cdef struct ExposureLimits:
+        double  exposure_min
+        double  exposure_max
+        double  gain_min
+        double  gain_max
+        cppbool gain_db
+
+    cdef struct ExposureTarget:
+        double quantile
+        double level
+        double max_saturated
+        double tolerance
+        size_t interval
+
+    cdef cppclass ExposureActuator:
+        pass
+
+    cdef cppclass HistogramStage(FrameStage):
+        HistogramStage(const size_t& bins, const size_t& step)
+        void     auto_exposure(ExposureActuator *actuator, const ExposureTarget& target,
+                               const ExposureLimits& limits)
+        void     adjusting(const cppbool& value)
+        cppbool  adjusting() const
+        uint64_t adjustments() const
+        size_t   bins() const
+        HistogramSummary latest(uint64_t *counts, const size_t& capacity)
+        double   percentile(const double& q)
+
+cdef extern from "motion_utils.hpp" nogil:
+    cdef cppclass MotionEnergyStage(FrameStage):
+        MotionEnergyStage(const size_t& capacity)
+        void     add_region(const size_t& x, const size_t& y, const size_t& width, const size_t& height)
+        void     clear_regions()
+        size_t   regions() const
+        size_t   read(uint64_t *sequences, double *timestamps, uint64_t *energies, const size_t& max_records)
+        size_t   columns()
+        size_t   pending()
+        uint64_t dropped()
+
+cdef extern from "preview_utils.hpp" nogil:
+    cdef struct PreviewInfo:
+        uint64_t sequence
+        double   timestamp
+        uint64_t count
+        size_t   width
+        size_t   height
+        size_t   channels
+
+    cdef cppclass PreviewStage(FrameStage):
+        PreviewStage(const size_t& factor, const double& rate)
+        void        window(const double& low, const double& high)
+        PreviewInfo latest(uint8_t *image, const size_t& capacity)
+
+cdef extern from "blob_utils.hpp" nogil:
+    cdef struct Blob:
+        double   x
+        double   y
+        uint64_t area
+
+    cdef struct BlobRecord:
+        uint64_t sequence
+        double   timestamp
+        uint32_t count
+        uint32_t overflow
+        Blob     blobs[8] # BlobRecord::CAPACITY
+
+    cdef cppclass BlobStage(FrameStage):
+        BlobStage(const uint32_t& threshold, const size_t& min_area, const size_t& max_blobs,
+                  const size_t& capacity, const size_t& max_labels)
+        void     region(const size_t& x, const size_t& y, const size_t& width, const size_t& height)
+        size_t   read(BlobRecord *records, const size_t& max_records)
+        size_t   pending() const
+        uint64_t dropped() const
+
+cdef extern from "sync_utils.hpp" nogil:
+    cdef struct SyncEdge:
+        uint64_t sequence
+        double   timestamp
+        uint32_t rising
+        int64_t  pulse
+        double   level
+
+    cdef struct SyncMapping:
+        uint64_t pulses
+        double   slope
+        double   intercept
+        double   residual
+
+    cdef cppclass SyncPulseStage(FrameStage):
+        SyncPulseStage(const double& low, const double& high,
+                       const double& period, const double& offset, const size_t& capacity)
+        void        region(const size_t& x, const size_t& y, const size_t& width, const size_t& height)
+        SyncMapping mapping()
+        double      level()
+        cppbool     state()
+        size_t      read(SyncEdge *edges, const size_t& max_edges)
+        size_t      pending() const
+        uint64_t    dropped() const
+
+cdef extern from "trigger_utils.hpp" nogil:
+    ctypedef cppbool (*TriggerFunction)(void *context)
+
+    cdef struct TriggerEvent:
+        uint64_t trigger
+        double   fired
+        int64_t  sequence
+        double   latency
+
+    cdef struct TriggerStats:
+        uint64_t fired
+        uint64_t failed
+        uint64_t matched
+        uint64_t missed
+        uint64_t unexpected
+        double   mean
+        double   jitter
+        double   min
+        double   max
+
+    cdef cppclass TriggerLatencyStage(FrameStage):
+        TriggerLatencyStage(const double& timeout, const size_t& capacity)
+        void         reset()
+        void         timeout(const double& value)
+        uint64_t     run(TriggerFunction fire, void *context, const uint64_t& count, const double& period)
+        TriggerStats stats()
+        const LatencyHistogram *latency() const
+        const LatencyHistogram *issue() const
+        const LatencyHistogram *lateness() const
+        size_t       read(TriggerEvent *events, const size_t& max_events)
+        size_t       pending() const
+        uint64_t     dropped() const
+
+cdef extern from "sequence_utils.hpp" nogil:
+    cdef struct SequenceTag:
+        uint64_t sequence
+        double   timestamp
+        uint32_t step
+        uint32_t late
+        double   exposure
+        double   gain
+
+    cdef struct SequenceStats:
+        uint64_t frames
+        uint64_t writes
+        uint64_t late
+
+    cdef cppclass ExposureSequenceStage(FrameStage):
+        ExposureSequenceStage(const size_t& capacity)
+        void          sequence(ExposureActuator *actuator, const ExposureSettings *steps, const size_t& count,
+                               const size_t& delay, const double& deadline)
+        size_t        steps() const
+        SequenceStats stats() const
+        const LatencyHistogram *write_latency() const
+        size_t        read(SequenceTag *tags, const size_t& max_tags)
+        size_t        pending() const
+        uint64_t      dropped() const
+
+##
+#   recording of frames into files
+#
+cdef extern from "io_utils.hpp" nogil:
+    cdef struct StreamStats:
+        uint64_t submitted
+        uint64_t written
+        uint64_t pending
+        double   lag
+        double   max_lag
+        uint64_t stalls
+        double   stalled
+        uint64_t errors
+
+    cdef struct TargetStats:
+        uint64_t written
+        uint64_t pending
+        size_t   files
+
+    cdef cppclass WriteStream:
+        const stdstring& name() const
+        StreamStats stats()
+
+    cdef cppclass WriteScheduler:
+        WriteScheduler(const size_t& chunk_bytes, const size_t& max_pending, const double& flush_interval)
+        size_t       add_target(const stdstring& root)
+        WriteStream *stream(const stdstring& name)
+        void         drain()
+        size_t       target_count()
+        stdstring    target_root(const size_t& index)
+        TargetStats  target_stats(const size_t& index)
+        size_t       stream_count()
+        WriteStream *stream_at(const size_t& index)
+
+cdef extern from "tiff_utils.hpp" nogil:
+    cdef enum TiffCompression:
+        TiffNone
+        TiffDeflate
+
+    cdef struct TiffStats:
+        uint64_t frames
+        uint64_t bytes
+        uint64_t files
+        uint64_t errors
+
+    cdef cppclass NativeTiffWriter "TiffWriter":
+        NativeTiffWriter()
+        void      stream(WriteStream *stream)
+        cppbool   configure(const stdstring& path, const TiffCompression& compression,
+                            const int& level, const uint64_t& max_bytes, const size_t& rows_per_strip)
+        cppbool   prepare(const FrameFormat& format)
+        TiffStats stats() const
+        stdvector[stdstring] paths()
+
+    void tiff_slot_callback(FrameSlot *slot, void *writer)
+
+cdef extern from "property_utils.hpp" nogil:
+    cdef cppclass PropertyExposureActuator(ExposureActuator):
+        PropertyExposureActuator(AbsoluteValueInterfacePtr& exposure, AbsoluteValueInterfacePtr& gain)
+
 ##
 #   a set of wrappers for not having to implement C++ listeners in Cython
 #
@@ -308,15 +683,47 @@ cdef extern from "sink_utils.hpp":
     ##
     #   size == 0 if acquisition has ended
     #
-    ctypedef void (*FrameCallback)(size_t size, void *data, void *user_data)
+    ctypedef void (*FrameCallback)(size_t size, void *data, uint64_t sequence, double timestamp, void *user_data)
+
+    ##
+    #   slot == NULL if acquisition has ended
+    #
+    ctypedef void (*SlotCallback)(FrameSlot *slot, void *user_data)
 
     cdef cppclass DefaultFrameNotificationSinkListener(FrameNotificationSinkListener):
         DefaultFrameNotificationSinkListener(FrameCallback callback, void *user_data)
         void setCallback(FrameCallback callback)
+        void bottom_up(const cppbool& value)
+        void add_stage(FrameStage *stage)
+        void clear_stages()
+        void crop(const FrameCrop& crop)
 
     cdef cppclass DefaultFrameQueueSinkListener(FrameQueueSinkListener):
         DefaultFrameQueueSinkListener(FrameCallback callback, void *user_data)
         void buffer_count(const size_t& count)
+        void auto_buffers(const double& frame_rate, const double& drop_probability,
+                          const size_t& max_count, const size_t& warmup)
+        void memory(const MemoryPolicy& policy)
+        void bottom_up(const cppbool& value)
+        void add_stage(FrameStage *stage)
+        void clear_stages()
+        void crop(const FrameCrop& crop)
+        void delivery(const DeliveryPolicy& policy, const size_t& depth, const double& target_rate)
+        DeliveryStats delivery_stats()
+        void       holds(const size_t& count)
+        FrameHold *hold(const uint8_t *data)
+        size_t add_consumer(SlotCallback callback, void *user_data,
+                            const DeliveryPolicy& policy, const size_t& depth,
+                            const double& target_rate)
+        void clear_consumers()
+        DeliveryStats consumer_stats(const size_t& index)
+        void dequeue_placement(const ThreadPlacement& placement)
+        void wait_strategy(const WaitStrategy& strategy, const double& spin_budget)
+        void consumer_placement(const size_t& index, const ThreadPlacement& placement)
+        const LatencyHistogram *dequeue_latency() const
+        const LatencyHistogram *consumer_latency(const size_t& index) const
+
+    FrameFormat as_frame_format(const FrameTypeInfo& info, const cppbool& bottom_up)
 
     smart_ptr[GrabberSinkType] as_sink(smart_ptr[FrameNotificationSink] src)
     smart_ptr[GrabberSinkType] as_sink(smart_ptr[FrameQueueSink] src)
@@ -324,6 +731,8 @@ cdef extern from "sink_utils.hpp":
 import warnings as _warnings
 import logging as _logging
 import sys as _sys
+import os as _os
+import json as _json
 from collections import namedtuple as _namedtuple
 import numpy as _np
 
@@ -367,9 +776,89 @@ DEFAULT_VIDEO_FORMAT = 'Y16 (640x480)'
 DEBUG_FORMATS        = False
 DEBUG_PROPERTIES     = False
 
+WAIT_STRATEGIES = {
+    'block': WaitBlocking,
+    'spin':  WaitSpinning,
+}
+
+DELIVERY_POLICIES = {
+    'all':      DeliverAll,
+    'latest':   DeliverLatest,
+    'decimate': DeliverDecimated,
+}
+
+def check_delivery(policy, rate):
+    """raises ValueError unless `policy` is one of DELIVERY_POLICIES and can be used with `rate`."""
+    if policy not in DELIVERY_POLICIES.keys():
+        raise ValueError(f"unknown delivery policy: '{policy}'")
+    if (policy == 'decimate') and not (rate > 0):
+        raise ValueError(f"the 'decimate' policy requires a positive rate: {rate}")
+
+ISA_LEVELS = {
+    'scalar': IsaScalar,
+    'sse2':   IsaSSE2,
+    'avx2':   IsaAVX2,
+    'avx512': IsaAVX512,
+}
+
+def pixel_isa():
+    """the instruction set that the pixel kernels use ('selected'),
+    and the best one that this machine supports ('supported')."""
+    return dict(selected=(<bytes>isa_name(pixel_kernels().isa)).decode(),
+                supported=(<bytes>isa_name(supported_isa())).decode())
+
+def select_pixel_isa(level=None):
+    """forces the pixel kernels of `level` ('scalar', 'sse2', 'avx2' or 'avx512'),
+    e.g. for benchmarking. `level=None` selects the best supported one.
+    the kernels are looked up when the acquisition is prepared.
+
+    the LABCAMERA_TIS_ISA environment variable does the same at import."""
+    if level is None:
+        select_isa(supported_isa())
+        return
+    if level not in ISA_LEVELS.keys():
+        raise ValueError(f"unknown instruction set: '{level}'")
+    if not select_isa(ISA_LEVELS[level]):
+        raise RuntimeError(f"instruction set not supported on this machine: '{level}'")
+
+select_pixel_isa(_os.environ.get('LABCAMERA_TIS_ISA', None))
+LOGGER.info("pixel kernels: %s", pixel_isa()['selected'])
+
 cdef str as_python_str(stdstring src):
     return (<bytes>(src.c_str())).decode(DEFAULT_ENCODING)
 
+cdef dict as_python_stream_stats(StreamStats stats):
+    return dict(submitted=int(stats.submitted),
+                written=int(stats.written),
+                pending=int(stats.pending),
+                lag=stats.lag,
+                max_lag=stats.max_lag,
+                stalls=int(stats.stalls),
+                stalled=stats.stalled,
+                errors=int(stats.errors))
+
+cdef ThreadPlacement as_placement(cpus, int priority, cppbool realtime):
+    cdef ThreadPlacement placement
+    for cpu in cpus:
+        placement.cpus.push_back(int(cpu))
+    placement.priority = priority
+    placement.realtime = realtime
+    return placement
+
+cdef dict as_python_latency(const LatencyHistogram *hist):
+    return dict(count=int(hist.count()),
+                p50_us=hist.percentile(0.5) * 1e6,
+                p99_us=hist.percentile(0.99) * 1e6,
+                p999_us=hist.percentile(0.999) * 1e6,
+                max_us=hist.max() * 1e6)
+
+cdef dict as_python_stats(DeliveryStats stats):
+    return dict(received=int(stats.received),
+                delivered=int(stats.delivered),
+                overwritten=int(stats.overwritten),
+                decimated=int(stats.decimated),
+                stalled=int(stats.stalled))
+
 cdef class ColorFormatDescriptor:
     """the interface for tColorformatEnum"""
     cdef tColorformatEnum _value
@@ -479,6 +968,15 @@ cdef class FrameTypeDescriptor:
             self.formatter.ndims = 3
         self.formatter.typenum  = self._colorfmt.typenum
 
+    cdef _synthesize(self, tColorformatEnum color, size_t width, size_t height):
+        """describes synthetic frames without a video format (for benchmarks)."""
+        self._colorfmt.value    = color
+        self.formatter.shape[0] = height
+        self.formatter.shape[1] = width
+        self.formatter.shape[2] = self._colorfmt.per_pixel
+        self.formatter.ndims    = 2 if self.formatter.shape[2] == 1 else 3
+        self.formatter.typenum  = self._colorfmt.typenum
+
     @property
     def color_format(self):
         return self._colorfmt
@@ -518,6 +1016,303 @@ cdef class FrameTypeDescriptor:
     def numpy_formatter(self):
         return dict(dtype=self.dtype, shape=self.shape[:self.ndim])
 
+##
+#   holds the pooled frame at `data` on behalf of an exported tensor
+#   (NULL if it cannot be held); `source` is what the frame came from
+#
+ctypedef FrameHold *(*FrameHolder)(object source, const uint8_t *data)
+
+cdef class _Export:
+    """keeps the memory that an exported tensor views."""
+    cdef FrameHold *_hold
+    cdef object     _keep  # the source of the hold, or a copy of the frame
+
+    def __cinit__(self):
+        self._hold = NULL
+
+    def __dealloc__(self):
+        if self._hold != NULL:
+            del self._hold
+
+cdef void _release_export(void *owner) noexcept with gil:
+    Py_DECREF(<object>owner)
+
+cdef void _delete_capsule(object capsule) noexcept:
+    # only called if the capsule has never been consumed
+    cdef DLManagedTensor *tensor
+    if PyCapsule_IsValid(capsule, "dltensor"):
+        tensor = <DLManagedTensor *>PyCapsule_GetPointer(capsule, "dltensor")
+        tensor.deleter(tensor)
+
+cdef object _export_capsule(void *data, int ndim, const int64_t *shape, const int64_t *strides,
+                            int bits, object owner):
+    """a DLPack capsule viewing `data`, keeping `owner` alive until the tensor is deleted."""
+    cdef DLManagedTensor *tensor
+    Py_INCREF(owner)
+    tensor = export_tensor(data, ndim, shape, strides, bits, _release_export, <void *>owner)
+    if tensor == NULL:
+        Py_DECREF(owner)
+        raise BufferError("the frame cannot be exported through DLPack")
+    return PyCapsule_New(tensor, "dltensor", _delete_capsule)
+
+@cython.freelist(8)
+cdef class Frame:
+    """a frame as delivered to the callbacks and the consumers.
+
+    it exposes the image through the buffer protocol and `__array_interface__`,
+    so that `numpy.asarray(frame)`, `memoryview(frame)` etc. view the frame
+    without copying it. indexing (e.g. `frame[::2, ::2]`) returns NumPy views.
+    it also supports DLPack (e.g. `torch.from_dlpack(frame)`; see `__dlpack__()`).
+
+    the frame is only valid until the callback returns; it is released then,
+    and cannot be accessed any more. use `copy()` to keep the image."""
+    cdef uint8_t         *_data     # the top-left pixel
+    cdef uint8_t         *_base     # the start of the frame in memory
+    cdef Py_ssize_t       _shape[4]
+    cdef Py_ssize_t       _strides[4]
+    cdef int              _ndim
+    cdef int              _typenum
+    cdef Py_ssize_t       _itemsize
+    cdef Py_ssize_t       _exports
+    cdef uint64_t         _sequence
+    cdef double           _timestamp
+    cdef object           _color
+    cdef FrameHolder      _holder
+    cdef object           _source
+
+    def __cinit__(self):
+        self._data    = NULL
+        self._base    = NULL
+        self._ndim    = 0
+        self._exports = 0
+        self._holder  = NULL
+
+    cdef _wrap(self, uint8_t *data, NumpyFormatter fmt, cppbool flipped,
+               Py_ssize_t x, Py_ssize_t y, Py_ssize_t width, Py_ssize_t height,
+               uint64_t sequence, double timestamp, color):
+        """views the (`x`, `y`, `width`, `height`) region of the buffer at `data`,
+        being of the shape of `fmt` and bottom-up if `flipped`."""
+        self._typenum   = fmt.typenum
+        self._itemsize  = 2 if fmt.typenum == cnp.NPY_UINT16 else 1
+        self._ndim      = fmt.ndims
+        self._shape[0]  = height
+        self._shape[1]  = width
+        self._shape[2]  = fmt.shape[2]
+        self._strides[2] = self._itemsize
+        self._strides[1] = fmt.shape[2] * self._itemsize
+        self._strides[0] = fmt.shape[1] * self._strides[1]
+        if flipped:
+            y = fmt.shape[0] - 1 - y
+            self._data = data + y * self._strides[0] + x * self._strides[1]
+            self._strides[0] = -self._strides[0]
+        else:
+            self._data = data + y * self._strides[0] + x * self._strides[1]
+        self._base      = data
+        self._sequence  = sequence
+        self._timestamp = timestamp
+        self._color     = color
+        self._holder    = NULL
+        self._source    = None
+
+    cdef _stack(self, Py_ssize_t count, Py_ssize_t frame_stride):
+        """turns the view into `count` frames, `frame_stride` bytes apart."""
+        cdef int i
+        for i in range(self._ndim, 0, -1):
+            self._shape[i]   = self._shape[i - 1]
+            self._strides[i] = self._strides[i - 1]
+        self._shape[0]   = count
+        self._strides[0] = frame_stride
+        self._ndim      += 1
+
+    cdef _held_by(self, FrameHolder holder, object source):
+        """lets the frame be exported without a copy, through `holder(source, ...)`."""
+        self._holder = holder
+        self._source = source
+
+    cdef cppbool _contiguous(self):
+        cdef Py_ssize_t expected = self._itemsize
+        cdef int i
+        for i in range(self._ndim - 1, -1, -1):
+            if self._strides[i] != expected:
+                return False
+            expected *= self._shape[i]
+        return True
+
+    def __getbuffer__(self, Py_buffer *buffer, int flags):
+        if self._data == NULL:
+            raise BufferError("the frame has been released")
+        if ((flags & PyBUF_STRIDES) != PyBUF_STRIDES) and not self._contiguous():
+            raise BufferError("the frame is not contiguous; strides are required to view it")
+        buffer.buf        = self._data
+        buffer.obj        = self
+        buffer.len        = self.nbytes
+        buffer.readonly   = 0
+        buffer.itemsize   = self._itemsize
+        buffer.format     = NULL
+        if flags & PyBUF_FORMAT:
+            buffer.format = "H" if self._itemsize == 2 else "B"
+        buffer.ndim       = self._ndim
+        buffer.shape      = NULL
+        buffer.strides    = NULL
+        if (flags & PyBUF_ND) == PyBUF_ND:
+            buffer.shape = self._shape
+        if (flags & PyBUF_STRIDES) == PyBUF_STRIDES:
+            buffer.strides = self._strides
+        buffer.suboffsets = NULL
+        buffer.internal   = NULL
+        self._exports += 1
+
+    def __releasebuffer__(self, Py_buffer *buffer):
+        self._exports -= 1
+
+    cdef _check(self):
+        if self._data == NULL:
+            raise ValueError("the frame has been released")
+
+    def release(self):
+        """releases the frame. views that have been taken from it must not be used
+        any more (tensors from `__dlpack__()` stay valid). called automatically
+        once the callback returns."""
+        self._data   = NULL
+        self._source = None
+
+    def __dlpack__(self, *, stream=None, max_version=None, dl_device=None, copy=None):
+        """exports the frame as a DLPack capsule, e.g. through `torch.from_dlpack(frame)`.
+
+        the frames from the internal pool (i.e. with a non-zero `queue_size`, or to the
+        consumers) and the batches are shared without a copy: they are kept out of the
+        pool until the tensor is deleted, up to the limit of `Device.set_export_limit()`.
+        the other frames, and the ones beyond the limit, are copied, unless `copy` is
+        False, in which case BufferError is raised.
+
+        bottom-up frames are exported with negative row strides, which some libraries
+        do not accept."""
+        cdef FrameHold *hold = NULL
+        cdef int64_t shape[4]
+        cdef int64_t strides[4]
+        cdef cnp.ndarray arr
+        cdef _Export owner
+        cdef int i
+        self._check()
+        if (dl_device is not None) and (tuple(dl_device) != (kDLCPU, 0)):
+            raise BufferError(f"frames can only be exported to the CPU: {dl_device}")
+
+        if (copy is not True) and (self._holder != NULL):
+            hold = self._holder(self._source, self._base)
+        if hold != NULL:
+            owner = _Export.__new__(_Export)
+            owner._hold = hold
+            owner._keep = self._source
+            for i in range(self._ndim):
+                shape[i]   = self._shape[i]
+                strides[i] = self._strides[i]
+            return _export_capsule(self._data, self._ndim, shape, strides, 8 * self._itemsize, owner)
+
+        if copy is False:
+            raise BufferError("the frame cannot be shared without a copy "
+                              "(it is not pooled, or the export limit has been reached)")
+        arr = self.copy()
+        for i in range(self._ndim):
+            shape[i]   = arr.shape[i]
+            strides[i] = arr.strides[i]
+        return _export_capsule(cnp.PyArray_DATA(arr), self._ndim, shape, strides, 8 * self._itemsize, arr)
+
+    def __dlpack_device__(self):
+        return (kDLCPU, 0)
+
+    @property
+    def released(self):
+        return (self._data == NULL)
+
+    @property
+    def sequence(self):
+        """the number of the frame since the start of acquisition."""
+        return self._sequence
+
+    @property
+    def timestamp(self):
+        """the time of reception, in seconds of the monotonic clock."""
+        return self._timestamp
+
+    @property
+    def color_format(self):
+        return self._color
+
+    @property
+    def ndim(self):
+        return self._ndim
+
+    @property
+    def shape(self):
+        return tuple(self._shape[i] for i in range(self._ndim))
+
+    @property
+    def strides(self):
+        return tuple(self._strides[i] for i in range(self._ndim))
+
+    @property
+    def dtype(self):
+        return _np.dtype(_np.uint16 if self._itemsize == 2 else _np.uint8)
+
+    @property
+    def nbytes(self):
+        cdef Py_ssize_t size = self._itemsize
+        cdef int i
+        for i in range(self._ndim):
+            size *= self._shape[i]
+        return size
+
+    @property
+    def __array_interface__(self):
+        self._check()
+        return dict(version=3, shape=self.shape, strides=self.strides,
+                    typestr=("<u2" if self._itemsize == 2 else "|u1"), # FIXME: assumes the little-endian environment
+                    data=(<size_t>self._data, False))
+
+    @property
+    def array(self):
+        """a NumPy view of the frame."""
+        self._check()
+        return _np.asarray(self)
+
+    def copy(self):
+        """a NumPy copy of the frame, to be kept after the frame is released."""
+        self._check()
+        return _np.array(self, copy=True)
+
+    def __getitem__(self, key):
+        return self.array[key]
+
+    def __len__(self):
+        return self._shape[0]
+
+    def __repr__(self):
+        state = "released" if self._data == NULL else f"shape={self.shape}, dtype={self.dtype}"
+        return f"Frame(sequence={self._sequence}, timestamp={self._timestamp:.6f}, {state})"
+
+cdef class FrameBatch(Frame):
+    """consecutive frames of a consumer, stacked into a single array of the shape
+    (count, height, width[, channels]) (see `Device.add_consumer()`).
+
+    it is used in the same way as a `Frame`; `sequence` and `timestamp`
+    are the ones of the first frame."""
+    cdef object _sequences
+    cdef object _timestamps
+
+    @property
+    def sequences(self):
+        """the numbers of the frames since the start of acquisition."""
+        return self._sequences
+
+    @property
+    def timestamps(self):
+        """the times of reception of the frames, in seconds of the monotonic clock."""
+        return self._timestamps
+
+    def __repr__(self):
+        state = "released" if self._data == NULL else f"shape={self.shape}, dtype={self.dtype}"
+        return f"FrameBatch(sequence={self._sequence}, timestamp={self._timestamp:.6f}, {state})"
+
 # the states of the device.
 #
 # IDLE --(prepare)--> READY --(start)--> RUNNING
@@ -531,11 +1326,1169 @@ cdef enum DeviceState:
     READY   = 1
     RUNNING = 2
 
-cdef public void default_frame_callback(size_t size, void *data, void *user_data) with gil:
+cdef public void default_frame_callback(size_t size, void *data, uint64_t sequence, double timestamp,
+                                        void *user_data) with gil:
     device = <Device>user_data
-    frame  = device.as_frame(size, data)
-    for callback in device._callbacks:
-        callback(frame)
+    frame  = device.as_frame(size, data, sequence, timestamp)
+    try:
+        for callback in device._callbacks:
+            callback(frame)
+    finally:
+        if frame is not None:
+            (<Frame>frame).release()
+
+SYNTHETIC_FORMATS = {
+    'Y800':  eY800,
+    'Y16':   eY16,
+    'RGB24': eRGB24,
+    'RGB32': eRGB32,
+}
+
+def _frame_path_benchmark(str path, str format, size_t width, size_t height,
+                          size_t callbacks=0, uint64_t iterations=1):
+    """runs the per-frame Python path `iterations` times on a synthetic buffer,
+    without a camera (for benchmarks/frame_callback.py).
+
+    `path` is one of:
+    - 'as_frame':  creating the Frame of a buffer, and releasing it.
+    - 'asarray':   as 'as_frame', but viewing the frame with numpy.asarray() in between.
+    - 'callback':  default_frame_callback() with `callbacks` no-op callbacks.
+    """
+    if format not in SYNTHETIC_FORMATS:
+        raise ValueError(f"unknown format: {format}")
+    if path not in ('as_frame', 'asarray', 'callback'):
+        raise ValueError(f"unknown path: {path}")
+    cdef Device device = Device("", _synthetic=(SYNTHETIC_FORMATS[format], width, height))
+    cdef object buffer = _np.zeros(device._desc.shape, dtype=device._desc.dtype)
+    cdef size_t size   = buffer.nbytes
+    cdef void  *data   = cnp.PyArray_DATA(<cnp.ndarray>buffer)
+    cdef uint64_t i
+    device._callbacks = [(lambda frame: None) for _ in range(callbacks)]
+    if path == 'callback':
+        for i in range(iterations):
+            default_frame_callback(size, data, i, 0.0, <void *>device)
+    elif path == 'asarray':
+        for i in range(iterations):
+            frame = device.as_frame(size, data, i, 0.0)
+            _np.asarray(frame)
+            (<Frame>frame).release()
+    else:
+        for i in range(iterations):
+            frame = device.as_frame(size, data, i, 0.0)
+            (<Frame>frame).release()
+
+cdef void consumer_frame_callback(FrameSlot *slot, void *user_data) with gil:
+    consumer = <Consumer>user_data
+    if slot == NULL:
+        frame = None
+    else:
+        frame = consumer._device.as_frame(slot.size, slot.data, slot.sequence, slot.timestamp)
+    try:
+        consumer._callback(frame)
+    finally:
+        if frame is not None:
+            (<Frame>frame).release()
+
+cdef void consumer_batch_callback(NativeFrameBatch *batch, void *user_data) with gil:
+    consumer = <Consumer>user_data
+    if batch == NULL:
+        frames = None
+    else:
+        frames = consumer._device.as_batch(batch, consumer)
+    try:
+        consumer._callback(frames)
+    finally:
+        if frames is not None:
+            (<Frame>frames).release()
+
+cdef FrameHold *hold_pooled(object device, const uint8_t *data):
+    return (<Device>device)._queue_listener.hold(data)
+
+cdef FrameHold *hold_batch(object consumer, const uint8_t *data):
+    return (<Consumer>consumer)._batcher.hold(data)
+
+cdef class Consumer:
+    """a callback that runs on its own thread, with its own queue and rate limit.
+
+    use `Device.add_consumer()` to create one."""
+    cdef Device _device
+    cdef object _callback
+    cdef size_t _index
+    cdef object _policy
+    cdef double _rate
+    cdef FrameBatcher *_batcher # NULL unless batched
+    cdef object        _writer  # the TiffWriter, if any
+
+    def __cinit__(self, Device device, callback, policy, rate):
+        self._device   = device
+        self._callback = callback
+        self._policy   = policy
+        self._rate     = rate
+        self._index    = 0
+        self._batcher  = NULL
+        self._writer   = None
+
+    def __dealloc__(self):
+        if self._batcher != NULL:
+            del self._batcher
+
+    @property
+    def callback(self):
+        return self._callback
+
+    @property
+    def writer(self):
+        """the `TiffWriter` of this consumer (None for callbacks)."""
+        return self._writer
+
+    @property
+    def batch(self):
+        """the number of frames delivered at once (0 if not batched)."""
+        return 0 if self._batcher == NULL else self._batcher.length()
+
+    @property
+    def policy(self):
+        return self._policy
+
+    @property
+    def rate(self):
+        """the maximum rate of delivery in frames per second (0 if unlimited)."""
+        return self._rate
+
+    @property
+    def stats(self):
+        """frame counts of this consumer's queue."""
+        return as_python_stats(self._device._queue_listener.consumer_stats(self._index))
+
+    @property
+    def latency(self):
+        """the distribution of the latencies from the reception of frames
+        to the start of this consumer's callback, in microseconds."""
+        return as_python_latency(self._device._queue_listener.consumer_latency(self._index))
+
+    def set_thread_placement(self, cpus=(), priority=0, realtime=False):
+        """see `Device.set_thread_placement()`."""
+        if self._device._state >= READY:
+            raise RuntimeError("thread placement must be set before prepare()")
+        self._device._queue_listener.consumer_placement(self._index,
+                                                        as_placement(cpus, priority, realtime))
+
+cdef class IOScheduler:
+    """a process-wide scheduler of the writes of all the `TiffWriter`s that are given to it,
+    e.g. of several devices recording at once.
+
+    each of `targets` (a directory on each disk to be used) has a writer thread of its own,
+    and the files are balanced across the targets as they are opened (relative paths
+    of the writers are placed under the chosen target, and only the file names of absolute
+    ones; see `TiffWriter.paths` for where they are). the writes of every writer are
+    coalesced into chunks of `chunk_mb` MiB, so that the disks see large sequential
+    writes instead of interleaved small ones; a partially filled chunk is written after
+    `flush_interval` seconds.
+
+    once a writer has `max_lag_mb` MiB waiting for its disk, it waits for the disk,
+    i.e. the frames back up in its consumer queue, which then follows its delivery policy.
+    `streams` reports the lag of each writer.
+
+    create a single scheduler for the process, and keep it until the writers are done."""
+    cdef WriteScheduler *_scheduler
+
+    def __cinit__(self, targets, chunk_mb=8, max_lag_mb=256, flush_interval=1.0):
+        self._scheduler = NULL
+
+    def __init__(self, targets, chunk_mb=8, max_lag_mb=256, flush_interval=1.0):
+        if isinstance(targets, (str, bytes, _os.PathLike)):
+            targets = [targets]
+        targets = [_os.fspath(target) for target in targets]
+        if len(targets) == 0:
+            raise ValueError("at least one target is required")
+        if chunk_mb <= 0:
+            raise ValueError(f"chunk_mb must be positive: {chunk_mb}")
+        if max_lag_mb < chunk_mb:
+            raise ValueError(f"max_lag_mb must be at least chunk_mb: {max_lag_mb}")
+        if flush_interval <= 0:
+            raise ValueError(f"flush_interval must be positive: {flush_interval}")
+        self._scheduler = new WriteScheduler(int(chunk_mb * 1048576),
+                                             int(max_lag_mb * 1048576),
+                                             flush_interval)
+        for target in targets:
+            self._scheduler.add_target(target.encode(DEFAULT_ENCODING))
+
+    def __dealloc__(self):
+        if self._scheduler != NULL:
+            with nogil:
+                del self._scheduler # after writing everything
+
+    @property
+    def targets(self):
+        """the statistics of every target (written and pending bytes, and
+        the number of files), by its root."""
+        cdef TargetStats stats
+        targets = {}
+        for i in range(self._scheduler.target_count()):
+            stats = self._scheduler.target_stats(i)
+            targets[as_python_str(self._scheduler.target_root(i))] = dict(written=int(stats.written),
+                                                                          pending=int(stats.pending),
+                                                                          files=int(stats.files))
+        return targets
+
+    @property
+    def streams(self):
+        """the statistics of every writer, by its path: submitted, written and pending
+        bytes, the `lag` of the oldest pending chunk and its maximum (in seconds),
+        and the times (and seconds) the writer had to wait for the disk."""
+        cdef WriteStream *stream
+        streams = {}
+        for i in range(self._scheduler.stream_count()):
+            stream = self._scheduler.stream_at(i)
+            streams[as_python_str(stream.name())] = as_python_stream_stats(stream.stats())
+        return streams
+
+    def drain(self):
+        """waits until everything submitted so far has been written."""
+        with nogil:
+            self._scheduler.drain()
+
+TIFF_COMPRESSIONS = {
+    None:      TiffNone,
+    'deflate': TiffDeflate,
+}
+
+cdef class TiffWriter:
+    """writes frames natively into multi-page BigTIFF files, without going through Python.
+
+    a writer runs as a consumer on a thread of its own (see `Device.add_writer()`).
+    each frame becomes a page that carries its sequence number (tag 65000)
+    and timestamp (tag 65001, in seconds); bottom-up frames are written
+    top-down, and BGR(A) frames as RGB(A).
+
+    the first file is written to `path`. with a non-zero `max_file_mb`, the files are
+    rolled over before they grow beyond that size, as <stem>_0001<ext>, <stem>_0002<ext>
+    and so on. `compression` is None or 'deflate' (at `level` 1-9, with the horizontal
+    predictor); deflate runs at some tens of MB/s per core, so that fast cameras
+    have to be written without compression to keep up with the frame rate.
+    `rows_per_strip` == 0 chooses the strips automatically.
+
+    with an `IOScheduler`, the files are written through it instead, onto its targets.
+
+    a writer is reused by the next acquisition, overwriting the files."""
+    cdef NativeTiffWriter *_writer
+    cdef object            _path
+    cdef object            _compression
+    cdef IOScheduler       _scheduler
+    cdef WriteStream      *_stream
+
+    def __cinit__(self, path, compression=None, level=1, max_file_mb=0, rows_per_strip=0,
+                  scheduler=None):
+        self._writer = new NativeTiffWriter()
+        self._stream = NULL
+
+    def __init__(self, path, compression=None, level=1, max_file_mb=0, rows_per_strip=0,
+                 IOScheduler scheduler=None):
+        if compression not in TIFF_COMPRESSIONS.keys():
+            raise ValueError(f"unknown compression: '{compression}'")
+        if not (1 <= level <= 9):
+            raise ValueError(f"level must be between 1 and 9: {level}")
+        if max_file_mb < 0:
+            raise ValueError(f"max_file_mb must not be negative: {max_file_mb}")
+        if rows_per_strip < 0:
+            raise ValueError(f"rows_per_strip must not be negative: {rows_per_strip}")
+        self._path        = _os.fspath(path)
+        self._compression = compression
+        if scheduler is not None:
+            self._scheduler = scheduler
+            self._stream    = scheduler._scheduler.stream(self._path.encode(DEFAULT_ENCODING))
+            self._writer.stream(self._stream)
+        if not self._writer.configure(self._path.encode(DEFAULT_ENCODING),
+                                      TIFF_COMPRESSIONS[compression],
+                                      level,
+                                      int(max_file_mb * 1048576),
+                                      rows_per_strip):
+            raise ValueError(f"compression '{compression}' is not available in this build")
+
+    def __dealloc__(self):
+        del self._writer
+
+    @property
+    def path(self):
+        return self._path
+
+    @property
+    def compression(self):
+        return self._compression
+
+    @property
+    def scheduler(self):
+        return self._scheduler
+
+    @property
+    def io_stats(self):
+        """the statistics of this writer in its `IOScheduler` (see `IOScheduler.streams`),
+        or None without a scheduler."""
+        if self._stream == NULL:
+            return None
+        return as_python_stream_stats(self._stream.stats())
+
+    @property
+    def paths(self):
+        """the paths of the files written so far."""
+        return [as_python_str(path) for path in self._writer.paths()]
+
+    @property
+    def stats(self):
+        """the frames and bytes written, the number of files, and the frames
+        that could not be written (after an error, until the next acquisition)."""
+        cdef TiffStats stats = self._writer.stats()
+        return dict(frames=int(stats.frames),
+                    bytes=int(stats.bytes),
+                    files=int(stats.files),
+                    errors=int(stats.errors))
+
+cdef class Stage:
+    """the base class of the processing steps that run natively on every frame,
+    on the acquisition thread and before the callbacks (see `Device.add_stage()`)."""
+    cdef FrameStage *_stage
+
+    def __cinit__(self):
+        self._stage = NULL
+
+    cdef _prepare(self):
+        """called by Device.prepare(), as the native stage is to start over."""
+        pass
+
+    @property
+    def name(self):
+        return (<bytes>self._stage.name()).decode()
+
+cdef class PixelStats(Stage):
+    """the running mean, variance, minimum and maximum of every pixel (and channel),
+    e.g. for flat-field calibration and hot-pixel detection.
+
+    the statistics can be read using `snapshot()` while acquisition is running."""
+    cdef PixelStatsStage *_stats
+
+    def __cinit__(self):
+        self._stats = new PixelStatsStage()
+        self._stage = self._stats
+
+    def __dealloc__(self):
+        del self._stats
+
+    @property
+    def count(self):
+        """the number of frames accumulated so far."""
+        return int(self._stats.count())
+
+    def reset(self):
+        """starts over from the next frame."""
+        self._stats.reset()
+
+    def snapshot(self):
+        """returns the statistics so far as a dict of 'count' and float64 arrays
+        of 'mean', 'var' (unbiased), 'min' and 'max', in the shape of the frames.
+        returns None if no frame has been accumulated yet.
+
+        while acquisition is running, some rows may include one frame more than
+        'count' (the fewest of any row)."""
+        cdef size_t height   = self._stats.height()
+        cdef size_t width    = self._stats.width()
+        cdef size_t channels = self._stats.channels()
+        cdef size_t capacity = height * width * channels
+        cdef uint64_t count
+        if capacity == 0:
+            return None
+        if channels == 1:
+            shape = (int(height), int(width))
+        else:
+            shape = (int(height), int(width), int(channels))
+        cdef cnp.ndarray mean     = _np.empty(shape, dtype=_np.float64)
+        cdef cnp.ndarray variance = _np.empty(shape, dtype=_np.float64)
+        cdef cnp.ndarray minimum  = _np.empty(shape, dtype=_np.float64)
+        cdef cnp.ndarray maximum  = _np.empty(shape, dtype=_np.float64)
+        with nogil:
+            count = self._stats.snapshot(<double *>cnp.PyArray_DATA(mean),
+                                         <double *>cnp.PyArray_DATA(variance),
+                                         <double *>cnp.PyArray_DATA(minimum),
+                                         <double *>cnp.PyArray_DATA(maximum),
+                                         capacity)
+        if count == 0:
+            return None
+        return dict(count=int(count), mean=mean, var=variance, min=minimum, max=maximum)
+
+cdef class Histogram(Stage):
+    """the intensity histogram of every frame (all the color channels together),
+    optionally driving a software auto-exposure loop.
+
+    `bins` is either 256 or 4096 (4096 only applies to Y16), and `step` > 1
+    only counts every `step`-th pixel of every `step`-th row."""
+    cdef HistogramStage           *_hist
+    cdef PropertyExposureActuator *_actuator
+    cdef Device                    _device
+
+    def __cinit__(self, bins=256, step=1):
+        if bins not in (256, 4096):
+            raise ValueError(f"the number of bins must be 256 or 4096: {bins}")
+        if step < 1:
+            raise ValueError("step must be positive")
+        self._hist     = new HistogramStage(bins, step)
+        self._stage    = self._hist
+        self._actuator = NULL
+        self._device   = None
+
+    def __dealloc__(self):
+        del self._hist
+        if self._actuator != NULL:
+            del self._actuator
+
+    @property
+    def summary(self):
+        """a summary of the latest frame, in the units of the pixel values.
+        'saturated' is the fraction of the values in the highest bin."""
+        cdef HistogramSummary summary = self._hist.latest(NULL, 0)
+        return dict(sequence=int(summary.sequence),
+                    timestamp=summary.timestamp,
+                    count=int(summary.count),
+                    mean=summary.mean,
+                    saturated=summary.saturated,
+                    p1=summary.low,
+                    p50=summary.median,
+                    p99=summary.high)
+
+    def counts(self):
+        """the histogram of the latest frame, as an array of uint64."""
+        cdef size_t size = self._hist.bins()
+        cdef cnp.ndarray counts = _np.zeros(size, dtype=_np.uint64)
+        with nogil:
+            self._hist.latest(<uint64_t *>cnp.PyArray_DATA(counts), size)
+        return counts
+
+    def percentile(self, q):
+        """the `q`-th percentile (0-100) of the latest frame, i.e. the lower edge of its bin."""
+        return self._hist.percentile(float(q) / 100)
+
+    def enable_auto_exposure(self, Device device, level=0.8, percentile=99,
+                             max_saturated=0.01, tolerance=0.1, interval=4,
+                             exposure_range_us=None, gain_range=None, gain_db=True):
+        """controls 'Exposure/Value' and 'Gain/Value' of `device` so that the `percentile`-th
+        percentile of the intensities is at `level` of the full scale.
+
+        the exposure is lengthened first, and the gain is raised only when the exposure is at
+        the maximum of `exposure_range_us` (e.g. the frame period). the exposure is halved
+        whenever more than `max_saturated` of the values are saturated, and the settings
+        are left as they are within `tolerance` of the target. after each change, the loop
+        waits for `interval` frames for it to take effect. `gain_db` tells whether the
+        gain of the camera is in dB (as is usually the case) or is a factor.
+
+        the loop runs on the acquisition thread without Python, and the camera's own
+        auto exposure and auto gain are turned off. must be called before prepare().
+        """
+        cdef PropertyElementInterface exposure
+        cdef PropertyElementInterface gain
+        cdef AbsoluteValueInterfacePtr gain_value
+        cdef ExposureTarget target
+        cdef ExposureLimits limits
+        if device._state >= READY:
+            raise RuntimeError("auto exposure must be enabled before prepare()")
+        if not device.has_exposure:
+            raise RuntimeError("the device does not have the 'Exposure' property")
+
+        if device.has_auto_exposure:
+            device.auto_exposure = False
+        exposure = device._props['Exposure']['Value']._get_interface('AbsoluteValue')
+        min_us, max_us = device.exposure_range_us
+        if exposure_range_us is not None:
+            min_us = max(min_us, exposure_range_us[0])
+            max_us = min(max_us, exposure_range_us[1])
+        limits.exposure_min = float(min_us) / 1e6
+        limits.exposure_max = float(max_us) / 1e6
+
+        if device.has_gain:
+            if device.has_auto_gain:
+                device.auto_gain = False
+            gain = device._props['Gain']['Value']._get_interface('AbsoluteValue')
+            gain_value = gain._value
+            gain_min, gain_max = device.gain_range
+            if gain_range is not None:
+                gain_min = max(gain_min, gain_range[0])
+                gain_max = min(gain_max, gain_range[1])
+        else:
+            gain_min = gain_max = 0.0
+        limits.gain_min = gain_min
+        limits.gain_max = gain_max
+        limits.gain_db  = gain_db
+
+        target.quantile      = float(percentile) / 100
+        target.level         = level
+        target.max_saturated = max_saturated
+        target.tolerance     = tolerance
+        target.interval      = interval
+
+        if self._actuator != NULL:
+            del self._actuator
+        self._actuator = new PropertyExposureActuator(exposure._value, gain_value)
+        self._hist.auto_exposure(self._actuator, target, limits)
+        self._device = device
+
+    def disable_auto_exposure(self):
+        """stops controlling the exposure. must be called before prepare()."""
+        cdef ExposureTarget target
+        cdef ExposureLimits limits
+        if (self._device is not None) and (self._device._state >= READY):
+            raise RuntimeError("auto exposure must be disabled before prepare()")
+        self._hist.auto_exposure(NULL, target, limits)
+        if self._actuator != NULL:
+            del self._actuator
+            self._actuator = NULL
+        self._device = None
+
+    @property
+    def auto_exposure(self):
+        """whether the auto-exposure loop is running. can be paused and resumed at any time."""
+        return (self._actuator != NULL) and bool(self._hist.adjusting())
+
+    @auto_exposure.setter
+    def auto_exposure(self, value):
+        self._hist.adjusting(bool(value))
+
+    @property
+    def adjustments(self):
+        """the number of times that the exposure has been changed."""
+        return int(self._hist.adjustments())
+
+cdef class MotionEnergy(Stage):
+    """the motion energy of every frame, i.e. the sum of absolute differences from
+    the previous frame (over all the color channels), of the whole frame and of
+    each region added with `add_region()`.
+
+    the values are kept as a time series of up to `capacity` frames until they
+    are `read()`; the oldest ones are dropped if they are not read in time."""
+    cdef MotionEnergyStage *_motion
+    cdef list               _regions
+
+    def __cinit__(self, capacity=4096):
+        if capacity < 1:
+            raise ValueError("capacity must be positive")
+        self._motion  = new MotionEnergyStage(capacity)
+        self._stage   = self._motion
+        self._regions = []
+
+    def __dealloc__(self):
+        del self._motion
+
+    @property
+    def regions(self):
+        """the regions as a list of (x, y, width, height), in pixels from the top-left corner."""
+        return list(self._regions)
+
+    def add_region(self, x, y, width, height):
+        """adds a region of interest. regions must be added while there is no acquisition,
+        and are clipped to the frame when the acquisition is prepared.
+        returns the index of the region in the columns of 'energy' (0 being the whole frame)."""
+        if (x < 0) or (y < 0) or (width < 1) or (height < 1):
+            raise ValueError(f"invalid region: {(x, y, width, height)}")
+        self._motion.add_region(x, y, width, height)
+        self._regions.append((int(x), int(y), int(width), int(height)))
+        return len(self._regions)
+
+    def clear_regions(self):
+        self._motion.clear_regions()
+        self._regions = []
+
+    @property
+    def pending(self):
+        """the number of frames that have not been read yet."""
+        return int(self._motion.pending())
+
+    @property
+    def dropped(self):
+        """the number of frames that have been dropped before being read."""
+        return int(self._motion.dropped())
+
+    def read(self, max_records=None):
+        """moves the time series so far out of the stage, as a dict of 'sequence' (uint64),
+        'timestamp' (float64; in seconds of the monotonic clock) and 'energy'
+        (uint64 of shape (frames, 1 + regions); the whole frame comes first).
+        the regions are those of the latest acquisition.
+        the first frame of each acquisition has no previous frame, and is not included."""
+        cdef size_t count = self._motion.pending()
+        cdef size_t width = self._motion.columns()
+        if (max_records is not None) and (max_records < count):
+            count = max_records
+        cdef cnp.ndarray sequences  = _np.empty(count, dtype=_np.uint64)
+        cdef cnp.ndarray timestamps = _np.empty(count, dtype=_np.float64)
+        cdef cnp.ndarray energies   = _np.empty((count, width), dtype=_np.uint64)
+        with nogil:
+            count = self._motion.read(<uint64_t *>cnp.PyArray_DATA(sequences),
+                                      <double *>cnp.PyArray_DATA(timestamps),
+                                      <uint64_t *>cnp.PyArray_DATA(energies),
+                                      count)
+        return dict(sequence=sequences[:count], timestamp=timestamps[:count], energy=energies[:count])
+
+cdef class Preview(Stage):
+    """a small 8-bit preview of the frames for GUIs, made natively so that its cost
+    does not depend on the sensor resolution or on the acquisition rate.
+
+    every `factor` x `factor` block of pixels is averaged, and the previews are made
+    at up to `rate` Hz (None to make one out of every frame). Y16 values are mapped
+    onto 0-255 through `window` (low, high). the alpha channel of RGB32 is dropped."""
+    cdef PreviewStage *_preview
+    cdef tuple         _window
+
+    def __cinit__(self, factor=2, rate=30, window=None):
+        if factor < 1:
+            raise ValueError("factor must be positive")
+        if (rate is not None) and (rate <= 0):
+            raise ValueError("rate must be positive")
+        self._preview = new PreviewStage(factor, 0.0 if rate is None else float(rate))
+        self._stage   = self._preview
+        self.window   = (0, 65535) if window is None else window
+
+    def __dealloc__(self):
+        del self._preview
+
+    @property
+    def window(self):
+        """the range of Y16 values that is mapped onto 0-255. can be changed at any time."""
+        return self._window
+
+    @window.setter
+    def window(self, value):
+        low, high = value
+        if high <= low:
+            raise ValueError(f"invalid window: {value}")
+        self._preview.window(float(low), float(high))
+        self._window = (low, high)
+
+    @property
+    def count(self):
+        """the number of previews made so far in this acquisition."""
+        return int(self._preview.latest(NULL, 0).count)
+
+    def latest(self):
+        """returns the latest preview as a dict of 'sequence', 'timestamp' and 'image'
+        (uint8, of shape (height, width) or (height, width, 3)), or None if there is none yet."""
+        cdef PreviewInfo info = self._preview.latest(NULL, 0)
+        cdef cnp.ndarray image
+        if info.count == 0:
+            return None
+        if info.channels == 1:
+            shape = (int(info.height), int(info.width))
+        else:
+            shape = (int(info.height), int(info.width), int(info.channels))
+        image = _np.empty(shape, dtype=_np.uint8)
+        with nogil:
+            info = self._preview.latest(<uint8_t *>cnp.PyArray_DATA(image),
+                                        info.height * info.width * info.channels)
+        return dict(sequence=int(info.sequence), timestamp=info.timestamp, image=image)
+
+cdef class BlobTracker(Stage):
+    """tracks bright spots (e.g. LEDs or reflective markers) natively: pixels above
+    `threshold` (in the units of the pixel values; color frames are thresholded on
+    their luma) are grouped into 8-connected components, and the centroids and the areas
+    of the `max_blobs` (up to 8) largest components of at least `min_area` pixels are
+    kept as a time series of up to `capacity` frames, until they are `read()`.
+
+    `region` (x, y, width, height) restricts the tracking to a part of the frames;
+    the coordinates are still those of the whole frames. frames with more than
+    `max_labels` provisional components are flagged as 'overflow'."""
+    cdef BlobStage *_blobs
+    cdef size_t     _max_blobs
+
+    def __cinit__(self, threshold, min_area=1, max_blobs=1, region=None,
+                  capacity=1024, max_labels=65536):
+        if (max_blobs < 1) or (max_blobs > 8):
+            raise ValueError(f"max_blobs must be 1-8: {max_blobs}")
+        if capacity < 1:
+            raise ValueError("capacity must be positive")
+        self._blobs     = new BlobStage(threshold, min_area, max_blobs, capacity, max_labels)
+        self._stage     = self._blobs
+        self._max_blobs = max_blobs
+        if region is not None:
+            x, y, width, height = region
+            self._blobs.region(x, y, width, height)
+
+    def __dealloc__(self):
+        del self._blobs
+
+    @property
+    def pending(self):
+        """the number of frames that have not been read yet."""
+        return int(self._blobs.pending())
+
+    @property
+    def dropped(self):
+        """the number of frames that were dropped because they had not been read in time."""
+        return int(self._blobs.dropped())
+
+    def read(self, max_records=None):
+        """moves the results so far out of the stage, as a dict of 'sequence', 'timestamp',
+        'count' (the number of blobs found), 'overflow' (bool), and 'x', 'y' and 'area'
+        of shape (frames, max_blobs), largest first. missing blobs are NaN (area 0).
+
+        must not be called from more than one thread at a time."""
+        cdef stdvector[BlobRecord] records
+        cdef size_t count = self._blobs.pending()
+        cdef size_t i, j
+        if (max_records is not None) and (max_records < count):
+            count = max_records
+        records.resize(count)
+        if count > 0:
+            count = self._blobs.read(records.data(), count)
+
+        cdef cnp.ndarray sequence = _np.empty(count, dtype=_np.uint64)
+        cdef cnp.ndarray timestamp = _np.empty(count, dtype=_np.float64)
+        cdef cnp.ndarray found    = _np.empty(count, dtype=_np.uint32)
+        cdef cnp.ndarray overflow = _np.empty(count, dtype=_np.bool_)
+        cdef cnp.ndarray x        = _np.full((count, self._max_blobs), _np.nan)
+        cdef cnp.ndarray y        = _np.full((count, self._max_blobs), _np.nan)
+        cdef cnp.ndarray area     = _np.zeros((count, self._max_blobs), dtype=_np.uint64)
+        cdef uint64_t *sequences  = <uint64_t *>cnp.PyArray_DATA(sequence)
+        cdef double   *timestamps = <double *>cnp.PyArray_DATA(timestamp)
+        cdef uint32_t *counts     = <uint32_t *>cnp.PyArray_DATA(found)
+        cdef uint8_t  *overflows  = <uint8_t *>cnp.PyArray_DATA(overflow)
+        cdef double   *xs         = <double *>cnp.PyArray_DATA(x)
+        cdef double   *ys         = <double *>cnp.PyArray_DATA(y)
+        cdef uint64_t *areas      = <uint64_t *>cnp.PyArray_DATA(area)
+        for i in range(count):
+            sequences[i]  = records[i].sequence
+            timestamps[i] = records[i].timestamp
+            counts[i]     = records[i].count
+            overflows[i]  = (records[i].overflow != 0)
+            for j in range(records[i].count):
+                xs[i * self._max_blobs + j]    = records[i].blobs[j].x
+                ys[i * self._max_blobs + j]    = records[i].blobs[j].y
+                areas[i * self._max_blobs + j] = records[i].blobs[j].area
+        return dict(sequence=sequence, timestamp=timestamp, count=found, overflow=overflow,
+                    x=x, y=y, area=area)
+
+cdef class SyncPulse(Stage):
+    """aligns the frames to an external clock through a sync LED in view:
+    the mean intensity of `region` (x, y, width, height; color frames are averaged
+    over their color channels) turns 'on' above `high` and 'off' below `low`
+    (in the units of the pixel values), and the rising edges are taken as the pulses
+    of the external train, one every `period` seconds (of the external clock),
+    the first one to be detected being at `offset`.
+
+    a linear mapping from the frame timestamps to the external clock is fitted
+    while acquiring, and is available as `mapping` at any time. pulses that are missed
+    are skipped according to the current fit. up to `capacity` transitions are kept
+    until they are `read()`; `save()` writes the mapping and all the transitions
+    of the current acquisition (since the latest `Device.prepare()`) next to the recording."""
+    cdef SyncPulseStage *_sync
+    cdef object          _period
+    cdef object          _offset
+    cdef object          _history
+
+    def __cinit__(self, low, high, region, period=1.0, offset=0.0, capacity=4096):
+        if high < low:
+            raise ValueError(f"high must not be less than low: {high} < {low}")
+        if period <= 0:
+            raise ValueError(f"period must be positive: {period}")
+        if capacity < 1:
+            raise ValueError("capacity must be positive")
+        x, y, width, height = region
+        self._sync    = new SyncPulseStage(low, high, period, offset, capacity)
+        self._stage   = self._sync
+        self._period  = float(period)
+        self._offset  = float(offset)
+        self._history = []
+        self._sync.region(x, y, width, height)
+
+    def __dealloc__(self):
+        del self._sync
+
+    cdef _prepare(self):
+        # the native transitions and mapping are reset for each acquisition
+        self._history = []
+
+    @property
+    def level(self):
+        """the mean intensity of the region in the latest frame."""
+        return self._sync.level()
+
+    @property
+    def state(self):
+        """whether the sync signal is currently 'on'."""
+        return bool(self._sync.state())
+
+    @property
+    def mapping(self):
+        """the current fit as a dict of 'pulses' (the number of pulses it is based on),
+        'slope' and 'intercept' (external time = slope * timestamp + intercept),
+        and 'residual' (the RMS deviation of the pulses, in external seconds)."""
+        cdef SyncMapping mapping = self._sync.mapping()
+        return dict(pulses=int(mapping.pulses), slope=mapping.slope,
+                    intercept=mapping.intercept, residual=mapping.residual)
+
+    def to_external(self, timestamp):
+        """converts frame timestamps to the external clock, using the current fit."""
+        cdef SyncMapping mapping = self._sync.mapping()
+        if mapping.pulses == 0:
+            raise RuntimeError("no sync pulse has been detected yet")
+        return mapping.slope * _np.asarray(timestamp, dtype=_np.float64) + mapping.intercept
+
+    @property
+    def pending(self):
+        """the number of transitions that have not been read yet."""
+        return int(self._sync.pending())
+
+    @property
+    def dropped(self):
+        """the number of transitions that were dropped because they had not been read in time."""
+        return int(self._sync.dropped())
+
+    def read(self, max_edges=None):
+        """moves the transitions so far out of the stage, as a dict of 'sequence', 'timestamp',
+        'rising' (bool), 'pulse' (the number of the pulse for rising edges; -1 otherwise)
+        and 'level'. they are also kept for `save()`.
+
+        must not be called from more than one thread at a time."""
+        cdef stdvector[SyncEdge] edges
+        cdef size_t count = self._sync.pending()
+        cdef size_t i
+        if (max_edges is not None) and (max_edges < count):
+            count = max_edges
+        edges.resize(count)
+        if count > 0:
+            count = self._sync.read(edges.data(), count)
+
+        cdef cnp.ndarray sequence  = _np.empty(count, dtype=_np.uint64)
+        cdef cnp.ndarray timestamp = _np.empty(count, dtype=_np.float64)
+        cdef cnp.ndarray rising    = _np.empty(count, dtype=_np.bool_)
+        cdef cnp.ndarray pulse     = _np.empty(count, dtype=_np.int64)
+        cdef cnp.ndarray level     = _np.empty(count, dtype=_np.float64)
+        cdef uint64_t *sequences  = <uint64_t *>cnp.PyArray_DATA(sequence)
+        cdef double   *timestamps = <double *>cnp.PyArray_DATA(timestamp)
+        cdef uint8_t  *risings    = <uint8_t *>cnp.PyArray_DATA(rising)
+        cdef int64_t  *pulses     = <int64_t *>cnp.PyArray_DATA(pulse)
+        cdef double   *levels     = <double *>cnp.PyArray_DATA(level)
+        for i in range(count):
+            sequences[i]  = edges[i].sequence
+            timestamps[i] = edges[i].timestamp
+            risings[i]    = (edges[i].rising != 0)
+            pulses[i]     = edges[i].pulse
+            levels[i]     = edges[i].level
+        ret = dict(sequence=sequence, timestamp=timestamp, rising=rising, pulse=pulse, level=level)
+        if count > 0:
+            self._history.append(ret)
+        return ret
+
+    def save(self, path):
+        """writes the current mapping and all the transitions of the current acquisition as JSON.
+        if `path` is the path of a recording, '.sync.json' is appended to it."""
+        self.read()
+        path = str(path)
+        if not path.endswith(".json"):
+            path = path + ".sync.json"
+        edges = dict()
+        for key in ("sequence", "timestamp", "rising", "pulse", "level"):
+            values = [chunk[key] for chunk in self._history]
+            edges[key] = _np.concatenate(values).tolist() if len(values) > 0 else []
+        with open(path, "w") as out:
+            _json.dump(dict(period=self._period, offset=self._offset,
+                            mapping=self.mapping, edges=edges), out, indent=2)
+        return path
+
+cdef cppbool push_trigger_button(void *button) noexcept nogil:
+    pushButton(deref(<ButtonInterfacePtr *>button))
+    return True
+
+cdef class TriggerLatency(Stage):
+    """measures the latency from software triggers to frames, and the triggers that are missed.
+
+    `measure()` fires software triggers on a schedule, each timestamped right before it is sent,
+    and the frames are timestamped as they are received by the listener (on the acquisition
+    thread). the frames are matched to the triggers in order, each to the oldest pending
+    trigger fired before it. the triggers without a frame for `timeout` seconds (by default,
+    the period of `measure()`), and those whose frames are lost (a gap in the sequences),
+    are counted as missed. `timeout` has to be longer than the latency, and shorter than the
+    period plus the latency, or a trigger that the camera ignores takes the frame of the next
+    one and shifts the matches that follow. up to `capacity` events are kept until they are `read()`.
+
+    `frame_trigger` runs the same analysis against a simulated camera, without the SDK."""
+    cdef TriggerLatencyStage *_trigger
+    cdef object               _timeout
+
+    def __cinit__(self, timeout=None, capacity=4096):
+        if (timeout is not None) and (timeout <= 0):
+            raise ValueError(f"timeout must be positive: {timeout}")
+        if capacity < 1:
+            raise ValueError("capacity must be positive")
+        self._trigger = new TriggerLatencyStage(0.5 if timeout is None else timeout, capacity)
+        self._stage   = self._trigger
+        self._timeout = timeout
+
+    def __dealloc__(self):
+        del self._trigger
+
+    def measure(self, Device device, count=100, period=0.1):
+        """fires `count` software triggers on `device` every `period` seconds, and waits
+        for the timeout after the last one. blocks until then, without holding the GIL.
+
+        `device` must be running in the trigger mode (`device.triggered = True`),
+        with this stage added before prepare(). returns `stats`."""
+        cdef PropertyElementInterface button
+        cdef uint64_t n_triggers = count
+        cdef double   interval   = period
+        if count < 1:
+            raise ValueError(f"count must be positive: {count}")
+        if period <= 0:
+            raise ValueError(f"period must be positive: {period}")
+        if device._state != RUNNING:
+            raise RuntimeError("the device must be running to measure trigger latencies")
+        if not device.triggered:
+            raise RuntimeError("the device must be in the trigger mode")
+        try:
+            button = device._props['Trigger']['Software Trigger']._get_interface('Button')
+        except KeyError:
+            raise RuntimeError("the device does not support software triggers")
+        self._trigger.timeout(interval if self._timeout is None else self._timeout)
+        with nogil:
+            self._trigger.run(push_trigger_button, <void *>&(button._button), n_triggers, interval)
+        return self.stats
+
+    def reset(self):
+        """starts over, e.g. for another measurement."""
+        self._trigger.reset()
+
+    @property
+    def stats(self):
+        """a dict of the triggers 'fired', 'failed' (to be sent), 'matched' and 'missed',
+        the frames received without a trigger ('unexpected'), and the 'mean', 'jitter'
+        (the standard deviation), 'min' and 'max' of the latencies, in microseconds."""
+        cdef TriggerStats stats = self._trigger.stats()
+        return dict(fired=int(stats.fired),
+                    failed=int(stats.failed),
+                    matched=int(stats.matched),
+                    missed=int(stats.missed),
+                    unexpected=int(stats.unexpected),
+                    mean_us=stats.mean * 1e6,
+                    jitter_us=stats.jitter * 1e6,
+                    min_us=stats.min * 1e6,
+                    max_us=stats.max * 1e6)
+
+    @property
+    def latency(self):
+        """the distributions of the trigger-to-frame latencies ('latency'), of the time that
+        sending the triggers took ('issue'), and of the lateness of the triggers behind
+        the schedule ('lateness'), in microseconds."""
+        return dict(latency=as_python_latency(self._trigger.latency()),
+                    issue=as_python_latency(self._trigger.issue()),
+                    lateness=as_python_latency(self._trigger.lateness()))
+
+    @property
+    def pending(self):
+        """the number of events that have not been read yet."""
+        return int(self._trigger.pending())
+
+    @property
+    def dropped(self):
+        """the number of events that were dropped because they had not been read in time."""
+        return int(self._trigger.dropped())
+
+    def read(self, max_events=None):
+        """moves the events so far out of the stage, as a dict of 'trigger' (the number of the
+        trigger), 'fired' (its timestamp), 'sequence' (of the frame; -1 if missed) and
+        'latency' (in seconds; -1 if missed).
+
+        must not be called from more than one thread at a time."""
+        cdef stdvector[TriggerEvent] events
+        cdef size_t count = self._trigger.pending()
+        cdef size_t i
+        if (max_events is not None) and (max_events < count):
+            count = max_events
+        events.resize(count)
+        if count > 0:
+            count = self._trigger.read(events.data(), count)
+
+        cdef cnp.ndarray trigger  = _np.empty(count, dtype=_np.uint64)
+        cdef cnp.ndarray fired    = _np.empty(count, dtype=_np.float64)
+        cdef cnp.ndarray sequence = _np.empty(count, dtype=_np.int64)
+        cdef cnp.ndarray latency  = _np.empty(count, dtype=_np.float64)
+        cdef uint64_t *triggers  = <uint64_t *>cnp.PyArray_DATA(trigger)
+        cdef double   *fired_at  = <double *>cnp.PyArray_DATA(fired)
+        cdef int64_t  *sequences = <int64_t *>cnp.PyArray_DATA(sequence)
+        cdef double   *latencies = <double *>cnp.PyArray_DATA(latency)
+        for i in range(count):
+            triggers[i]  = events[i].trigger
+            fired_at[i]  = events[i].fired
+            sequences[i] = events[i].sequence
+            latencies[i] = events[i].latency
+        return dict(trigger=trigger, fired=fired, sequence=sequence, latency=latency)
+
+cdef class ExposureSequence(Stage):
+    """applies a precomputed sequence of exposures and/or gains frame by frame, e.g. for
+    HDR or multi-illumination imaging, from the acquisition thread without Python.
+
+    the settings are written to the camera through the properties resolved in `schedule()`,
+    and each frame is tagged with the settings that were in effect for it, to be `read()`.
+    up to `capacity` tags are kept until then."""
+    cdef ExposureSequenceStage    *_sequence
+    cdef PropertyExposureActuator *_actuator
+    cdef Device                    _device
+
+    def __cinit__(self, capacity=4096):
+        if capacity < 1:
+            raise ValueError("capacity must be positive")
+        self._sequence = new ExposureSequenceStage(capacity)
+        self._stage    = self._sequence
+        self._actuator = NULL
+        self._device   = None
+
+    def __dealloc__(self):
+        del self._sequence
+        if self._actuator != NULL:
+            del self._actuator
+
+    def schedule(self, Device device, exposures_us=None, gains=None, delay=1, deadline_us=0):
+        """exposes frame #n with `exposures_us[n % len(exposures_us)]` (and/or the gain
+        likewise) on `device`. if both are given, they must be of the same length.
+        the properties that are not given are left as they are.
+
+        a change is written when the frame `delay` frames before the one that it is meant for
+        is received, i.e. it is assumed to take effect after `delay` frames; frames whose
+        settings could not be written in time are tagged 'late'. a write is late if it takes
+        longer than `deadline_us` from the reception of that frame or, with `deadline_us` = 0,
+        if it completes after the exposure of its frame is expected to start.
+
+        the camera's own auto exposure (and/or auto gain) is turned off.
+        must be called before prepare().
+        """
+        cdef PropertyElementInterface exposure
+        cdef PropertyElementInterface gain
+        cdef AbsoluteValueInterfacePtr exposure_value
+        cdef AbsoluteValueInterfacePtr gain_value
+        cdef stdvector[ExposureSettings] steps
+        cdef size_t i
+        if device._state >= READY:
+            raise RuntimeError("the exposure sequence must be scheduled before prepare()")
+        if (exposures_us is None) and (gains is None):
+            raise ValueError("either exposures_us or gains must be given")
+        if delay < 1:
+            raise ValueError(f"delay must be positive: {delay}")
+        if deadline_us < 0:
+            raise ValueError(f"deadline_us must not be negative: {deadline_us}")
+        if exposures_us is not None:
+            exposures_us = [float(v) for v in exposures_us]
+            if len(exposures_us) == 0:
+                raise ValueError("exposures_us must not be empty")
+            if not device.has_exposure:
+                raise RuntimeError("the device does not have the 'Exposure' property")
+            min_us, max_us = device.exposure_range_us
+            for value in exposures_us:
+                if (value < min_us) or (value > max_us):
+                    raise ValueError(f"exposure out of range ({min_us}-{max_us} us): {value}")
+        if gains is not None:
+            gains = [float(v) for v in gains]
+            if len(gains) == 0:
+                raise ValueError("gains must not be empty")
+            if not device.has_gain:
+                raise RuntimeError("the device does not have the 'Gain' property")
+            gain_min, gain_max = device.gain_range
+            for value in gains:
+                if (value < gain_min) or (value > gain_max):
+                    raise ValueError(f"gain out of range ({gain_min}-{gain_max}): {value}")
+        if (exposures_us is not None) and (gains is not None) and (len(exposures_us) != len(gains)):
+            raise ValueError(f"exposures_us and gains differ in length: {len(exposures_us)} and {len(gains)}")
+
+        count = len(exposures_us) if exposures_us is not None else len(gains)
+        steps.resize(count)
+        for i in range(count):
+            steps[i].exposure = (exposures_us[i] / 1e6) if exposures_us is not None else 0.0
+            steps[i].gain     = gains[i] if gains is not None else 0.0
+
+        if exposures_us is not None:
+            if device.has_auto_exposure:
+                device.auto_exposure = False
+            exposure = device._props['Exposure']['Value']._get_interface('AbsoluteValue')
+            exposure_value = exposure._value
+        if gains is not None:
+            if device.has_auto_gain:
+                device.auto_gain = False
+            gain = device._props['Gain']['Value']._get_interface('AbsoluteValue')
+            gain_value = gain._value
+
+        if self._actuator != NULL:
+            del self._actuator
+        self._actuator = new PropertyExposureActuator(exposure_value, gain_value)
+        self._sequence.sequence(self._actuator, steps.data(), count, delay, float(deadline_us) / 1e6)
+        self._device = device
+
+    def clear(self):
+        """stops applying the sequence. must be called before prepare()."""
+        if (self._device is not None) and (self._device._state >= READY):
+            raise RuntimeError("the exposure sequence must be cleared before prepare()")
+        self._sequence.sequence(NULL, NULL, 0, 1, 0.0)
+        if self._actuator != NULL:
+            del self._actuator
+            self._actuator = NULL
+        self._device = None
+
+    @property
+    def steps(self):
+        """the number of steps in the sequence (0 if none is scheduled)."""
+        return int(self._sequence.steps())
+
+    @property
+    def stats(self):
+        """a dict of the 'frames' tagged, the settings 'writes' to the camera, and
+        the frames whose scheduled settings were not in effect in time ('late')."""
+        cdef SequenceStats stats = self._sequence.stats()
+        return dict(frames=int(stats.frames),
+                    writes=int(stats.writes),
+                    late=int(stats.late))
+
+    @property
+    def write_latency(self):
+        """the distribution of the time that writing the settings took, in microseconds."""
+        return as_python_latency(self._sequence.write_latency())
+
+    @property
+    def pending(self):
+        """the number of tags that have not been read yet."""
+        return int(self._sequence.pending())
+
+    @property
+    def dropped(self):
+        """the number of tags that were dropped because they had not been read in time."""
+        return int(self._sequence.dropped())
+
+    def read(self, max_tags=None):
+        """moves the tags so far out of the stage, as a dict of 'sequence' and 'timestamp'
+        (of the frames, as in the callbacks), 'step' (of the sequence in effect), 'late'
+        (whether it differs from the step scheduled for the frame), 'exposure_us' and 'gain'
+        (in effect; 0 for a property that is not sequenced).
+
+        must not be called from more than one thread at a time."""
+        cdef stdvector[SequenceTag] tags
+        cdef size_t count = self._sequence.pending()
+        cdef size_t i
+        if (max_tags is not None) and (max_tags < count):
+            count = max_tags
+        tags.resize(count)
+        if count > 0:
+            count = self._sequence.read(tags.data(), count)
+
+        cdef cnp.ndarray sequence  = _np.empty(count, dtype=_np.uint64)
+        cdef cnp.ndarray timestamp = _np.empty(count, dtype=_np.float64)
+        cdef cnp.ndarray step      = _np.empty(count, dtype=_np.uint32)
+        cdef cnp.ndarray late      = _np.empty(count, dtype=_np.bool_)
+        cdef cnp.ndarray exposure  = _np.empty(count, dtype=_np.float64)
+        cdef cnp.ndarray gain      = _np.empty(count, dtype=_np.float64)
+        cdef uint64_t *sequences  = <uint64_t *>cnp.PyArray_DATA(sequence)
+        cdef double   *timestamps = <double *>cnp.PyArray_DATA(timestamp)
+        cdef uint32_t *steps      = <uint32_t *>cnp.PyArray_DATA(step)
+        cdef uint8_t  *lates      = <uint8_t *>cnp.PyArray_DATA(late)
+        cdef double   *exposures  = <double *>cnp.PyArray_DATA(exposure)
+        cdef double   *gains      = <double *>cnp.PyArray_DATA(gain)
+        for i in range(count):
+            sequences[i]  = tags[i].sequence
+            timestamps[i] = tags[i].timestamp
+            steps[i]      = tags[i].step
+            lates[i]      = 1 if tags[i].late else 0
+            exposures[i]  = tags[i].exposure * 1e6
+            gains[i]      = tags[i].gain
+        return dict(sequence=sequence, timestamp=timestamp, step=step, late=late,
+                    exposure_us=exposure, gain=gain)
 
 cdef class Device:
     """the main interface to ImagingSource cameras."""
@@ -545,12 +2498,20 @@ cdef class Device:
     cdef FrameTypeDescriptor _desc
     cdef object      _props
     cdef object      _callbacks
+    cdef object      _consumers
+    cdef object      _stages
 
     cdef smart_ptr[GrabberSinkType]    _frame_sink
     cdef DefaultFrameNotificationSinkListener *_notification_listener
     cdef DefaultFrameQueueSinkListener        *_queue_listener
     cdef cppbool _topdown
 
+    cdef FrameCrop      _crop
+    cdef object         _crop_region # (x, y, width, height, bin) as requested
+    cdef NumpyFormatter _crop_fmt    # of the cropped frames
+    cdef size_t         _crop_size
+    cdef size_t         _exports     # the number of pooled frames that may be exported at a time
+
     @classmethod
     def list_names(cls):
         cdef Grabber *grabber = new Grabber()
@@ -561,37 +2522,49 @@ cdef class Device:
         del grabber
         return tuple(ret)
 
-    def __cinit__(self, name: str):
+    def __cinit__(self, name: str, *, _synthetic=None):
         """
         creates a Grabber context, and opens the device with `name` being its "unique name".
 
         `name` must be one of the string values being obtained from the `list_names()` method.
         RuntimeError will be thrown in case of any errors.
+
+        (`_synthetic=(color_format, width, height)` leaves the device closed, and describes
+        synthetic frames instead; only for `_frame_path_benchmark()`.)
         """
         cdef bint ret
 
-        # open
         self._grabber = new Grabber()
         self._state   = NODEV
-        ret = self._grabber.openDevByUniqueName(name.encode(DEFAULT_ENCODING))
-        if bool(ret) == False:
-            raise RuntimeError("failed to open device: " + name)
-        self._state   = IDLE
+        self._desc    = FrameTypeDescriptor()
+        if _synthetic is not None:
+            color, width, height = _synthetic
+            self._desc._synthesize(color, width, height)
+        else:
+            # open
+            ret = self._grabber.openDevByUniqueName(name.encode(DEFAULT_ENCODING))
+            if bool(ret) == False:
+                raise RuntimeError("failed to open device: " + name)
+            self._state   = IDLE
 
-        # setup video formats
-        fmts = self.list_video_formats()
-        if DEFAULT_VIDEO_FORMAT in fmts:
-            self.video_format = DEFAULT_VIDEO_FORMAT
+            # setup video formats
+            fmts = self.list_video_formats()
+            if DEFAULT_VIDEO_FORMAT in fmts:
+                self.video_format = DEFAULT_VIDEO_FORMAT
 
-        # set up properties
-        self._props = Properties(self)
+            # set up properties
+            self._props = Properties(self)
 
-        self._desc      = FrameTypeDescriptor()
         self._notification_listener = new DefaultFrameNotificationSinkListener(default_frame_callback,
                                                                                <void *>self)
         self._queue_listener = new DefaultFrameQueueSinkListener(default_frame_callback,
                                                                  <void *>self)
         self._callbacks = []
+        self._consumers = []
+        self._stages    = []
+        self._crop_region = None
+        self._crop_size   = 0
+        self._exports     = 4
 
     def __dealloc__(self):
         del self._grabber
@@ -841,9 +2814,274 @@ cdef class Device:
     def callbacks(self):
         return self._callbacks
 
-    def prepare(self, buffer_size=0):
-        """sets up acquisition for the 'live' mode."""
-        cdef size_t n_buffers = buffer_size
+    @property
+    def consumers(self):
+        return tuple(self._consumers)
+
+    def add_consumer(self, callback, rate=0.0, policy='latest', queue_size=2, batch=0):
+        """adds `callback` as a consumer that runs on its own thread.
+
+        unlike `callbacks` that run one after another, each consumer has its own queue
+        of `queue_size` frames, so that a slow consumer (e.g. plotting) does not delay
+        the others (e.g. recording). `rate` limits the frames delivered per second
+        (0 for unlimited), and `policy` is one of 'all', 'latest' and 'decimate'
+        (see `prepare()`; 'decimate' requires a positive `rate`). the frames are shared among the consumers without being copied.
+
+        with a non-zero `batch`, `callback` receives a `FrameBatch` of `batch` frames
+        at once (fewer at the end of the acquisition), collected natively into
+        a single block, e.g. to be handed to inference through DLPack.
+
+        consumers are only used when `buffer_size` > 0, and must be added before prepare().
+        """
+        cdef size_t depth = queue_size
+        cdef Consumer consumer
+        if self._state >= READY:
+            raise RuntimeError("consumers must be added before prepare()")
+        check_delivery(policy, rate)
+        if depth == 0:
+            raise ValueError("queue_size must be positive")
+        if batch < 0:
+            raise ValueError(f"batch must not be negative: {batch}")
+        consumer = Consumer(self, callback, policy, float(rate))
+        if batch > 0:
+            consumer._batcher = new FrameBatcher(consumer_batch_callback, <void *>consumer, batch)
+            consumer._index = self._queue_listener.add_consumer(batch_slot_callback,
+                                                                <void *>consumer._batcher,
+                                                                DELIVERY_POLICIES[policy],
+                                                                depth,
+                                                                float(rate))
+        else:
+            consumer._index = self._queue_listener.add_consumer(consumer_frame_callback,
+                                                                <void *>consumer,
+                                                                DELIVERY_POLICIES[policy],
+                                                                depth,
+                                                                float(rate))
+        self._consumers.append(consumer)
+        return consumer
+
+    def add_writer(self, TiffWriter writer, policy='all', queue_size=8, rate=0.0):
+        """adds `writer` as a consumer that writes the frames (as they are delivered,
+        i.e. after any crop) into TIFF files, on a thread of its own.
+
+        with the default policy, the acquisition waits for the disk rather than
+        losing frames once `queue_size` frames are pending; see `add_consumer()`
+        for the other arguments. the returned `Consumer` has no callback.
+        """
+        cdef size_t depth = queue_size
+        cdef Consumer consumer
+        if self._state >= READY:
+            raise RuntimeError("writers must be added before prepare()")
+        check_delivery(policy, rate)
+        if depth == 0:
+            raise ValueError("queue_size must be positive")
+        consumer = Consumer(self, None, policy, float(rate))
+        consumer._writer = writer
+        consumer._index  = self._queue_listener.add_consumer(tiff_slot_callback,
+                                                             <void *>writer._writer,
+                                                             DELIVERY_POLICIES[policy],
+                                                             depth,
+                                                             float(rate))
+        self._consumers.append(consumer)
+        return consumer
+
+    @property
+    def stages(self):
+        return tuple(self._stages)
+
+    def add_stage(self, Stage stage):
+        """adds a processing stage (e.g. `PixelStats`) that runs natively on every frame.
+
+        stages run one after another on the acquisition thread, before any of the
+        callbacks and consumers, and are not subject to the delivery policy.
+        they must be added before prepare()."""
+        if self._state >= READY:
+            raise RuntimeError("stages must be added before prepare()")
+        self._notification_listener.add_stage(stage._stage)
+        self._queue_listener.add_stage(stage._stage)
+        self._stages.append(stage)
+        return stage
+
+    def clear_stages(self):
+        """removes all the stages added through `add_stage()`."""
+        if self._state >= READY:
+            raise RuntimeError("stages cannot be removed after prepare()")
+        self._notification_listener.clear_stages()
+        self._queue_listener.clear_stages()
+        self._stages = []
+
+    @property
+    def cropping(self):
+        """the software crop region as a dict of 'x', 'y', 'width', 'height' and 'bin',
+        or None if the frames are not cropped."""
+        if self._crop_region is None:
+            return None
+        return dict(zip(('x', 'y', 'width', 'height', 'bin'), self._crop_region))
+
+    def crop(self, x=0, y=0, width=None, height=None, bin=1):
+        """crops the frames in software to the region (in pixels from the top-left corner),
+        for the models that cannot crop through video formats. `width` or `height` of None
+        extends the region to the edge of the frames, and `bin` > 1 averages every
+        `bin` x `bin` block of pixels.
+
+        the crop is applied after the stages (which see the whole frames), so that only
+        the region is copied for the consumers and the queued callbacks. without binning,
+        the callbacks that run on the acquisition thread receive views into the whole frames.
+        must be set before prepare()."""
+        if self._state >= READY:
+            raise RuntimeError("the crop region must be set before prepare()")
+        if (x < 0) or (y < 0):
+            raise ValueError(f"invalid offset of the crop region: {(x, y)}")
+        if ((width is not None) and (width < 1)) or ((height is not None) and (height < 1)):
+            raise ValueError(f"invalid size of the crop region: {(width, height)}")
+        if bin < 1:
+            raise ValueError("bin must be positive")
+        self._crop.clear()
+        self._crop.region(x, y, 0 if width is None else width, 0 if height is None else height)
+        self._crop.binning(bin)
+        self._crop_region = (int(x), int(y), width, height, int(bin))
+
+    def clear_crop(self):
+        """delivers the whole frames again. must be called before prepare()."""
+        if self._state >= READY:
+            raise RuntimeError("the crop region must be cleared before prepare()")
+        self._crop.clear()
+        self._crop_region = None
+
+    def set_thread_placement(self, thread='dequeue', cpus=(), priority=0, realtime=False):
+        """pins an acquisition thread to `cpus`, and/or changes its priority.
+
+        `thread` is either 'dequeue' (the thread that takes frames out of the sink)
+        or 'delivery' (the thread that runs `callbacks` when `queue_size` > 0).
+        use `Consumer.set_thread_placement()` for the threads of the other consumers.
+
+        `priority` is a nice value (-20 to 19), or a SCHED_FIFO priority (1 to 99)
+        if `realtime` is True. on Windows, these are mapped to the nearest thread priority.
+        the frame pool is allocated on the NUMA node of the dequeue thread.
+        failures (e.g. lack of privileges) are only reported, and acquisition continues.
+
+        only available when `buffer_size` > 0, and must be set before prepare().
+        """
+        if self._state >= READY:
+            raise RuntimeError("thread placement must be set before prepare()")
+        if thread == 'dequeue':
+            self._queue_listener.dequeue_placement(as_placement(cpus, priority, realtime))
+        elif thread == 'delivery':
+            self._queue_listener.consumer_placement(0, as_placement(cpus, priority, realtime))
+        else:
+            raise ValueError(f"unknown thread: '{thread}'")
+
+    def set_memory_policy(self, huge_pages=False, lock=False, numa_node=None):
+        """sets how the sink buffers and the frame pool are allocated.
+
+        - `huge_pages`: backs them with 2 MB pages, to reduce TLB misses when streaming
+          at high data rates. on Linux, pages have to be reserved (vm.nr_hugepages);
+          on Windows, the "Lock pages in memory" privilege is required.
+        - `lock`: keeps them resident in physical memory (mlock / VirtualLock).
+        - `numa_node`: binds them to a NUMA node (by default, the frame pool is
+          placed on the node of the dequeue thread).
+
+        whatever cannot be applied is only reported, and normal memory is used instead.
+        only available when `buffer_size` > 0, and must be set before prepare().
+        with `buffer_size='auto'`, the buffers added during acquisition are allocated
+        by the SDK without the policy.
+        """
+        cdef MemoryPolicy policy
+        if self._state >= READY:
+            raise RuntimeError("the memory policy must be set before prepare()")
+        if (numa_node is not None) and (numa_node < 0):
+            raise ValueError(f"numa_node must not be negative: {numa_node}")
+        policy.huge_pages = huge_pages
+        policy.lock       = lock
+        policy.numa_node  = -1 if numa_node is None else numa_node
+        self._queue_listener.memory(policy)
+
+    def set_export_limit(self, count=4):
+        """sets the number of pooled frames that may be shared with other libraries
+        at a time (see `Frame.__dlpack__()`), and the same for the batches of each
+        batched consumer. as many frames are added to the pool, so that the tensors
+        never hold up the acquisition. must be set before prepare()."""
+        if self._state >= READY:
+            raise RuntimeError("the export limit must be set before prepare()")
+        if count < 0:
+            raise ValueError(f"count must not be negative: {count}")
+        self._exports = count
+
+    def set_wait_strategy(self, strategy='block', spin_budget_us=0):
+        """sets how the dequeue thread waits for frames.
+
+        - 'block': sleeps until the sink notifies the arrival of frames (default).
+        - 'spin': busy-polls for frames, occupying a CPU core in exchange for
+          a lower and more stable latency (e.g. for closed-loop experiments).
+          if `spin_budget_us` > 0, the thread goes back to sleep after spinning
+          for that long without any frame.
+
+        only available when `buffer_size` > 0, and must be set before prepare().
+        consider pinning the dequeue thread using `set_thread_placement()` when spinning.
+        """
+        if self._state >= READY:
+            raise RuntimeError("the wait strategy must be set before prepare()")
+        if strategy not in WAIT_STRATEGIES.keys():
+            raise ValueError(f"unknown wait strategy: '{strategy}'")
+        self._queue_listener.wait_strategy(WAIT_STRATEGIES[strategy], float(spin_budget_us) / 1e6)
+
+    @property
+    def latency(self):
+        """the distributions of the latencies, in microseconds, from
+        the notification of frames to their dequeue ('dequeue'), and
+        from the dequeue to the start of the callbacks ('delivery';
+        only when `queue_size` > 0)."""
+        return dict(dequeue=as_python_latency(self._queue_listener.dequeue_latency()),
+                    delivery=as_python_latency(self._queue_listener.consumer_latency(0)))
+
+    def clear_consumers(self):
+        """removes all the consumers added through `add_consumer()`."""
+        if self._state >= READY:
+            raise RuntimeError("consumers cannot be removed after prepare()")
+        self._queue_listener.clear_consumers()
+        self._consumers = []
+
+    def prepare(self, buffer_size=0, policy='all', queue_size=0, target_rate=0.0,
+                drop_probability=1e-4, max_buffer_mb=1024, warmup=2.0):
+        """sets up acquisition for the 'live' mode.
+
+        when `buffer_size` > 0, frames are acquired through a queue of `buffer_size`
+        sink buffers. `buffer_size='auto'` decides the number from the frame rate instead:
+        the acquisition starts with 100 ms worth of buffers, the time that the acquisition
+        thread holds each frame is measured for the first `warmup` seconds, and the sink
+        is then grown so that the probability of dropping a frame stays below
+        `drop_probability`, and later whenever it runs out of free buffers, using up to
+        `max_buffer_mb` MiB. the decisions are logged to stderr.
+
+        with the sink buffers, a non-zero `queue_size` copies each frame into
+        an internal pool and runs the callbacks on a separate thread, so that slow
+        callbacks do not hold the sink buffers. `policy` then decides what to do
+        when the callbacks fall behind:
+
+        - 'all': keeps every frame, waiting for the callbacks if the queue is full.
+        - 'latest': drops the oldest pending frame in favor of the newest one.
+        - 'decimate': keeps to `target_rate` frames per second, which must then be positive,
+          and drops the oldest pending frame like 'latest' if the callbacks still fall behind.
+
+        with the other policies, a non-zero `target_rate` also limits the frames delivered per second.
+        """
+        cdef size_t n_buffers = 0
+        cdef size_t n_queued  = queue_size
+        cdef size_t n_max     = 0
+        cdef double fps       = 0.0
+        cdef FrameFormat delivered
+        auto_size = isinstance(buffer_size, str)
+        if auto_size:
+            if buffer_size != 'auto':
+                raise ValueError(f"buffer_size must be a number or 'auto': '{buffer_size}'")
+            if not (0 < drop_probability < 1):
+                raise ValueError(f"drop_probability must be between 0 and 1: {drop_probability}")
+            if warmup <= 0:
+                raise ValueError(f"warmup must be positive: {warmup}")
+        else:
+            n_buffers = buffer_size
+        check_delivery(policy, target_rate)
+        if (policy != 'all') and (n_queued == 0):
+            n_queued = 1
 
         if self._state >= READY:
             _warnings.warn("prepare() is called when the device has been already set up.",
@@ -852,6 +3090,46 @@ cdef class Device:
         # freeze frame type
         self._desc._load(self._grabber.getVideoFormat().getFrameType())
 
+        if auto_size:
+            fps       = self._grabber.getFPS()
+            n_max     = max(int(max_buffer_mb * 1048576 // max(self._desc._type.buffersize, 1)), 2)
+            n_buffers = min(max(int(_np.ceil(fps * 0.1)), 4), n_max)
+            self._queue_listener.auto_buffers(fps, drop_probability, n_max,
+                                              max(int(_np.ceil(fps * warmup)), 1))
+        else:
+            self._queue_listener.auto_buffers(0.0, 0.0, 0, 0)
+
+        # the frames arrive bottom-up if they could not be flipped in hardware
+        self._notification_listener.bottom_up(self._topdown)
+        self._queue_listener.bottom_up(self._topdown)
+
+        # software crop
+        if self._crop.active():
+            if not self._crop.prepare(as_frame_format(self._desc._type, self._topdown)):
+                raise ValueError(f"the crop region does not fit the frames: {self.cropping}")
+            self._crop_fmt          = self._desc.formatter
+            self._crop_fmt.shape[0] = self._crop.output().height
+            self._crop_fmt.shape[1] = self._crop.output().width
+            self._crop_size         = self._crop.output().size
+        self._notification_listener.crop(self._crop)
+        self._queue_listener.crop(self._crop)
+
+        # the writers receive the frames as they are delivered
+        if self._crop.active():
+            delivered = self._crop.output()
+        else:
+            delivered = as_frame_format(self._desc._type, self._topdown)
+        for consumer in self._consumers:
+            if (<Consumer>consumer)._writer is not None:
+                if not (<TiffWriter>(<Consumer>consumer)._writer)._writer.prepare(delivered):
+                    raise ValueError(f"frames of {self._desc.color_format} cannot be written into TIFF")
+
+        # exports through DLPack
+        self._queue_listener.holds(self._exports)
+        for consumer in self._consumers:
+            if (<Consumer>consumer)._batcher != NULL:
+                (<Consumer>consumer)._batcher.holds(self._exports)
+
         # setup callback
         if len(self._callbacks) == 0:
             self._notification_listener.setCallback(NULL)
@@ -859,11 +3137,16 @@ cdef class Device:
             self._notification_listener.setCallback(default_frame_callback)
 
         # prepare sink
-        if buffer_size == 0:
+        if n_buffers == 0:
+            if n_queued > 0:
+                LOGGER.warning("delivery policies require buffer_size > 0; frames are delivered directly")
+            if len(self._consumers) > 0:
+                LOGGER.warning("consumers require buffer_size > 0; they will not receive frames")
             self._frame_sink = as_sink(FrameNotificationSink.create(deref(self._notification_listener),
                                                                        self._desc._type))
         else:
             self._queue_listener.buffer_count(n_buffers)
+            self._queue_listener.delivery(DELIVERY_POLICIES[policy], n_queued, target_rate)
             self._frame_sink = as_sink(FrameQueueSink.create(deref(self._queue_listener),
                                                                    self._desc._type))
         if check_retval(self._grabber.setSinkType(self._frame_sink),
@@ -871,6 +3154,10 @@ cdef class Device:
             LOGGER.warn(as_python_str(self._grabber.getLastError().toString()))
             return
 
+        # the stages start over
+        for stage in self._stages:
+            (<Stage>stage)._prepare()
+
         # call prepareLive
         if check_retval(self._grabber.prepareLive(False),
                         "prepareLive() failed"):
@@ -879,14 +3166,16 @@ cdef class Device:
 
         self._state = READY
 
-    def start(self, buffer_size=0, strobe=False):
-        """starts the 'live' mode, beginning to acquire images."""
+    def start(self, buffer_size=0, strobe=False, **options):
+        """starts the 'live' mode, beginning to acquire images.
+
+        `options` are passed to prepare() in case the device has not been set up."""
         if self._state == RUNNING:
             _warnings.warn("the device is already in live.",
                            category=TISDeviceStatusWarning)
             return
         elif self._state < READY:
-            self.prepare(buffer_size)
+            self.prepare(buffer_size, **options)
 
         self.strobe = strobe
         if check_retval(self._grabber.startLive(False),
@@ -897,13 +3186,17 @@ cdef class Device:
         self._state = RUNNING
 
     def suspend(self, strobe=False):
+        cdef cppbool ret
         if self._state != RUNNING:
             _warnings.warn("suspend() is called when the device is not in live.",
                            category=TISDeviceStatusWarning)
             return
 
         self.strobe = strobe
-        if check_retval(self._grabber.suspendLive(),
+        # the GIL is released, as the sink waits for the callbacks and consumers to finish
+        with nogil:
+            ret = self._grabber.suspendLive()
+        if check_retval(ret,
                         "suspendLive() failed") == False:
             LOGGER.warn(as_python_str(self._grabber.getLastError().toString()))
             return
@@ -912,12 +3205,16 @@ cdef class Device:
 
     def stop(self, strobe=False):
         """stops acquisition, rendering the device back to the idle state."""
+        cdef cppbool ret
         if self._state < READY:
             _warnings.warn("stop() is called when the device has not been set up.",
                            category=TISDeviceStatusWarning)
             return
 
-        if check_retval(self._grabber.stopLive(),
+        # the GIL is released, as the sink waits for the callbacks and consumers to finish
+        with nogil:
+            ret = self._grabber.stopLive()
+        if check_retval(ret,
                         "stopLive() failed") == False:
             self.strobe = strobe
             LOGGER.warn(as_python_str(self._grabber.getLastError().toString()))
@@ -936,21 +3233,45 @@ cdef class Device:
     def frame_descriptor(self):
         return self._desc
 
-    cdef as_frame(self, size_t size, void *data):
+    @property
+    def delivery_stats(self):
+        """frame counts of the internal queue (meaningful only when `queue_size` > 0)."""
+        return as_python_stats(self._queue_listener.delivery_stats())
+
+    cdef _fill(self, Frame frame, size_t size, void *data, uint64_t sequence, double timestamp):
         cdef NumpyFormatter fmt = self._desc.formatter
+        cdef Py_ssize_t x = 0, y = 0
+        cdef Py_ssize_t width  = fmt.shape[1]
+        cdef Py_ssize_t height = fmt.shape[0]
+        if self._crop.active():
+            # the frames are either cropped already (into the pool or binned),
+            # or whole frames that the region is to be viewed in
+            if size == self._crop_size:
+                fmt = self._crop_fmt
+            else:
+                x, y = self._crop_region[:2]
+            width  = self._crop_fmt.shape[1]
+            height = self._crop_fmt.shape[0]
+        frame._wrap(<uint8_t *>data, fmt, self._topdown, x, y, width, height,
+                    sequence, timestamp, self._desc._colorfmt)
+
+    cdef as_frame(self, size_t size, void *data, uint64_t sequence, double timestamp):
+        cdef Frame frame
         if size == 0:
             return None
-        else:
-            arr = cnp.PyArray_SimpleNewFromData(
-                    fmt.ndims,
-                    fmt.shape,
-                    fmt.typenum,
-                    data
-                  )
-            if self._topdown:
-                return arr[::-1, :]
-            else:
-                return arr
+        frame = Frame.__new__(Frame)
+        self._fill(frame, size, data, sequence, timestamp)
+        frame._held_by(hold_pooled, self)
+        return frame
+
+    cdef as_batch(self, NativeFrameBatch *batch, Consumer consumer):
+        cdef FrameBatch frames = FrameBatch.__new__(FrameBatch)
+        self._fill(frames, batch.frame_size, batch.block.data, batch.sequences[0], batch.timestamps[0])
+        frames._stack(batch.count, batch.frame_size)
+        frames._held_by(hold_batch, consumer)
+        frames._sequences  = _np.array(<uint64_t[:batch.count]>batch.sequences)
+        frames._timestamps = _np.array(<double[:batch.count]>batch.timestamps)
+        return frames
 
 cdef class Properties:
     """the pythonic interface to 'VCDProperties' controls."""
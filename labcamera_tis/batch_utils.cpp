@@ -0,0 +1,103 @@
+/*
+ *  MIT License
+ *
+ *  Copyright (c) 2021 Keisuke Sehara
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+*/
+#include "batch_utils.hpp"
+#include <cstring>
+
+FrameBatcher::FrameBatcher(BatchCallback callback, void *user_data, const size_t& length):
+    callback_(callback),
+    user_data_(user_data),
+    length_((length > 0)? length : 1),
+    frame_size_(0),
+    current_(nullptr) { }
+
+void FrameBatcher::allocate_(const size_t& size)
+{
+    pool_.allocate(1, length_ * size);
+    frame_size_ = size;
+
+    const size_t count = pool_.count();
+    batches_.resize(count);
+    sequences_.resize(count * length_);
+    timestamps_.resize(count * length_);
+    for (size_t i = 0; i < count; i++) {
+        FrameBatch& batch = batches_[i];
+        batch.block      = nullptr;
+        batch.frame_size = size;
+        batch.count      = 0;
+        batch.sequences  = sequences_.data() + i * length_;
+        batch.timestamps = timestamps_.data() + i * length_;
+    }
+}
+
+void FrameBatcher::add(const FrameSlot *slot)
+{
+    if (slot->size != frame_size_) {
+        // the first frame, or the frame size has changed since the last acquisition
+        if (current_ != nullptr) {
+            deliver_();
+        }
+        allocate_(slot->size);
+    }
+    if (current_ == nullptr) {
+        // never waits, as there are more blocks than holds
+        FrameSlot *block = pool_.acquire();
+        current_ = &(batches_[pool_.index(block)]);
+        current_->block = block;
+        current_->count = 0;
+    }
+
+    const size_t index = current_->count;
+    std::memcpy(current_->block->data + index * frame_size_, slot->data, slot->size);
+    const size_t entry = pool_.index(current_->block) * length_ + index;
+    sequences_[entry]  = slot->sequence;
+    timestamps_[entry] = slot->timestamp;
+    if (++(current_->count) == length_) {
+        deliver_();
+    }
+}
+
+void FrameBatcher::deliver_()
+{
+    FrameBatch *batch = current_;
+    current_ = nullptr;
+    callback_(batch, user_data_);
+    pool_.release(batch->block);
+}
+
+void FrameBatcher::finish()
+{
+    if (current_ != nullptr) {
+        deliver_();
+    }
+    callback_(nullptr, user_data_);
+}
+
+void batch_slot_callback(FrameSlot *slot, void *batcher)
+{
+    if (slot != nullptr) {
+        ((FrameBatcher *)batcher)->add(slot);
+    } else {
+        ((FrameBatcher *)batcher)->finish();
+    }
+}
@@ -0,0 +1,109 @@
+/*
+ *  MIT License
+ *
+ *  Copyright (c) 2021 Keisuke Sehara
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+*/
+#ifndef BATCH_UTILS_HPP_
+#include <vector>
+#include "pool_utils.hpp"
+
+/**
+ *  consecutive frames of a consumer, stored one after another in a block.
+ */
+struct FrameBatch
+{
+    FrameSlot      *block;      // of the pool of the FrameBatcher
+    size_t          frame_size; // the distance between the frames in the block
+    size_t          count;      // # of frames in the block
+    const uint64_t *sequences;
+    const double   *timestamps;
+};
+
+/**
+ *  called on the consumer's thread once a batch is complete.
+ *  `batch` is nullptr at the end of the acquisition (after the last, partial batch).
+ *  the batcher releases the block after the callback returns.
+ */
+typedef void (*BatchCallback)(FrameBatch *batch, void *user_data);
+
+/**
+ *  collects the frames of a consumer into blocks of `length` frames, so that
+ *  they can be handed over at once (e.g. to inference) as a single array.
+ *  it is used as the SlotCallback of the consumer (see batch_slot_callback()).
+ *
+ *  the frames are copied once into the block on the consumer's thread.
+ *  the blocks can be held (see FramePool::hold()); there is always
+ *  one more block to collect the frames into.
+ */
+class FrameBatcher
+{
+private:
+    FramePool             pool_;
+    BatchCallback         callback_;
+    void                 *user_data_;
+    size_t                length_;
+    size_t                frame_size_;
+    std::vector<FrameBatch> batches_;    // one for each block
+    std::vector<uint64_t> sequences_;
+    std::vector<double>   timestamps_;
+    FrameBatch           *current_;     // being filled
+
+    /**
+     *  (re-)allocates the blocks for frames of `size` bytes.
+     */
+    void allocate_(const size_t& size);
+
+    /**
+     *  runs the callback on the current batch, and releases its block.
+     */
+    void deliver_();
+public:
+    FrameBatcher(BatchCallback callback, void *user_data, const size_t& length);
+
+    /**
+     *  sets the number of blocks that may be held at a time.
+     */
+    void       holds(const size_t& count) { pool_.holds(count); }
+    FrameHold *hold(const uint8_t *data) { return pool_.hold(data); }
+
+    void memory(const MemoryPolicy& policy) { pool_.memory(policy); }
+
+    /**
+     *  copies the frame in `slot` into the current block,
+     *  and delivers the block once it is full.
+     */
+    void add(const FrameSlot *slot);
+
+    /**
+     *  delivers the frames collected so far, and marks the end of the acquisition.
+     */
+    void finish();
+
+    size_t length() const { return length_; }
+};
+
+/**
+ *  the SlotCallback that feeds a consumer's frames to `batcher` (a FrameBatcher).
+ */
+void batch_slot_callback(FrameSlot *slot, void *batcher);
+
+#define BATCH_UTILS_HPP_
+#endif
@@ -0,0 +1,186 @@
+/*
+ *  MIT License
+ *
+ *  Copyright (c) 2021 Keisuke Sehara
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+*/
+#include "blob_utils.hpp"
+#include <algorithm>
+#include <cstring>
+
+BlobStage::BlobStage(const uint32_t& threshold, const size_t& min_area,
+                     const size_t& max_blobs, const size_t& capacity,
+                     const size_t& max_labels):
+    threshold_(threshold),
+    min_area_(min_area),
+    max_blobs_((max_blobs < 1)? 1 : (max_blobs > BlobRecord::CAPACITY)? BlobRecord::CAPACITY : max_blobs),
+    max_labels_((max_labels > 0)? max_labels : 1),
+    region_(),
+    x0_(0), y0_(0), width_(0), height_(0),
+    overflow_(false),
+    results_(capacity) { }
+
+void BlobStage::region(const size_t& x, const size_t& y, const size_t& width, const size_t& height)
+{
+    region_[0] = x;
+    region_[1] = y;
+    region_[2] = width;
+    region_[3] = height;
+}
+
+bool BlobStage::configure(const FrameFormat& format)
+{
+    if ((region_[0] >= format.width) || (region_[1] >= format.height)) {
+        return false;
+    }
+    x0_     = region_[0];
+    y0_     = region_[1];
+    width_  = std::min((region_[2] > 0)? region_[2] : format.width,  format.width  - x0_);
+    height_ = std::min((region_[3] > 0)? region_[3] : format.height, format.height - y0_);
+
+    // the worst case is allocated here, so that nothing is allocated per frame
+    mask_.assign(width_ + 8, 0);
+    previous_.reserve(width_ / 2 + 1);
+    current_.reserve(width_ / 2 + 1);
+    parent_.reserve(max_labels_);
+    area_.reserve(max_labels_);
+    sum_x_.reserve(max_labels_);
+    sum_y_.reserve(max_labels_);
+    roots_.reserve(max_labels_);
+    results_.reset();
+    return true;
+}
+
+uint32_t BlobStage::find_(uint32_t label)
+{
+    while (parent_[label] != label) {
+        parent_[label] = parent_[parent_[label]]; // path halving
+        label = parent_[label];
+    }
+    return label;
+}
+
+void BlobStage::add_run_(const uint32_t& start, const uint32_t& end, const size_t& y, size_t& candidate)
+{
+    // runs of the previous row that end before this one starts (even diagonally)
+    // cannot touch this or the following runs
+    while ((candidate < previous_.size()) && (previous_[candidate].end < start)) {
+        candidate++;
+    }
+
+    uint32_t label = UINT32_MAX;
+    for (size_t i = candidate; (i < previous_.size()) && (previous_[i].start <= end); i++) {
+        const uint32_t other = find_(previous_[i].label);
+        if (label == UINT32_MAX) {
+            label = other;
+        } else if (other != label) {
+            // the smaller label becomes the root
+            const uint32_t root = std::min(label, other);
+            parent_[std::max(label, other)] = root;
+            label = root;
+        }
+    }
+    if (label == UINT32_MAX) {
+        if (parent_.size() >= max_labels_) {
+            overflow_ = true;
+            return;
+        }
+        label = (uint32_t)parent_.size();
+        parent_.push_back(label);
+        area_.push_back(0);
+        sum_x_.push_back(0.0);
+        sum_y_.push_back(0.0);
+    }
+
+    const uint64_t length = end - start;
+    area_[label]  += length;
+    sum_x_[label] += (double)length * (double)(start + end - 1) / 2.0;
+    sum_y_[label] += (double)length * (double)y;
+
+    Run run = { start, end, label };
+    current_.push_back(run);
+}
+
+void BlobStage::label_row_(const size_t& y)
+{
+    const uint8_t *mask  = mask_.data();
+    const size_t   width = width_;
+    size_t candidate = 0;
+
+    current_.clear();
+    size_t x = 0;
+    while (x < width) {
+        // the mask is padded, so that the last word can be read as a whole
+        uint64_t word;
+        std::memcpy(&word, mask + x, sizeof(word));
+        if (word == 0) {
+            x += 8;
+            continue;
+        }
+        if (mask[x] == 0) {
+            x++;
+            continue;
+        }
+        const size_t start = x;
+        while ((x < width) && (mask[x] != 0)) {
+            x++;
+        }
+        add_run_((uint32_t)start, (uint32_t)x, y, candidate);
+    }
+    previous_.swap(current_);
+}
+
+void BlobStage::publish_(const FrameView& frame)
+{
+    // the moments of the merged labels are added up into their roots;
+    // roots always have the smallest label of their components
+    roots_.clear();
+    for (uint32_t label = 0; label < (uint32_t)parent_.size(); label++) {
+        const uint32_t root = find_(label);
+        if (root == label) {
+            roots_.push_back(label);
+            continue;
+        }
+        area_[root]  += area_[label];
+        sum_x_[root] += sum_x_[label];
+        sum_y_[root] += sum_y_[label];
+    }
+
+    const size_t count = std::min(max_blobs_, roots_.size());
+    std::partial_sort(roots_.begin(), roots_.begin() + count, roots_.end(),
+                      [this](const uint32_t& a, const uint32_t& b) { return area_[a] > area_[b]; });
+
+    BlobRecord record;
+    record.sequence  = frame.sequence;
+    record.timestamp = frame.timestamp;
+    record.count     = 0;
+    record.overflow  = overflow_? 1 : 0;
+    for (size_t i = 0; i < count; i++) {
+        const uint32_t label = roots_[i];
+        if (area_[label] < min_area_) {
+            break;
+        }
+        Blob& blob = record.blobs[record.count++];
+        blob.area  = area_[label];
+        blob.x     = (double)x0_ + sum_x_[label] / (double)area_[label];
+        blob.y     = sum_y_[label] / (double)area_[label];
+    }
+    results_.push(record);
+}
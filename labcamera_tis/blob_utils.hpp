@@ -0,0 +1,168 @@
+/*
+ *  MIT License
+ *
+ *  Copyright (c) 2021 Keisuke Sehara
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+*/
+#ifndef BLOB_UTILS_HPP_
+#include <vector>
+#include "stage_utils.hpp"
+#include "ring_utils.hpp"
+
+/**
+ *  a connected component, in pixels from the top-left corner of the frame.
+ */
+struct Blob
+{
+    double   x;    // centroid
+    double   y;
+    uint64_t area; // # of pixels
+};
+
+/**
+ *  the largest blobs of a frame, largest first.
+ */
+struct BlobRecord
+{
+    static const size_t CAPACITY = 8;
+
+    uint64_t sequence;
+    double   timestamp;
+    uint32_t count;    // # of valid entries in `blobs`
+    uint32_t overflow; // non-zero if there were too many components to label them all
+    Blob     blobs[CAPACITY];
+};
+
+/**
+ *  tracks bright spots (LEDs, reflective markers): thresholds each frame
+ *  (or a region of it), labels the 8-connected components in a single pass over
+ *  the rows, and publishes the centroids and the areas of the largest ones.
+ *  color frames are thresholded on their (BT.601) luma.
+ *
+ *  rows are thresholded into a mask by a loop that vectorizes, and the mask is
+ *  then scanned for runs (skipping empty stretches 8 pixels at a time); runs that
+ *  touch a run of the previous row are merged with a union-find. the records go
+ *  into a lock-free ring of `capacity` frames, to be read by a single reader.
+ */
+class BlobStage: public FormatStage<BlobStage>
+{
+private:
+    struct Run
+    {
+        uint32_t start;
+        uint32_t end;   // exclusive
+        uint32_t label;
+    };
+
+    uint32_t threshold_;   // pixels above this value are foreground
+    size_t   min_area_;
+    size_t   max_blobs_;
+    size_t   max_labels_;
+    size_t   region_[4];   // x, y, width, height as requested (0 for the edge)
+
+    size_t   x0_;          // the region, clipped to the frame
+    size_t   y0_;
+    size_t   width_;
+    size_t   height_;
+
+    std::vector<uint8_t>  mask_;    // of a row, padded with zeros
+    std::vector<Run>      previous_;
+    std::vector<Run>      current_;
+    std::vector<uint32_t> parent_;  // union-find over the labels
+    std::vector<uint64_t> area_;
+    std::vector<double>   sum_x_;
+    std::vector<double>   sum_y_;
+    std::vector<uint32_t> roots_;   // scratch space for publish_()
+    bool                  overflow_;
+
+    ResultRing<BlobRecord> results_;
+
+    uint32_t find_(uint32_t label);
+    void     add_run_(const uint32_t& start, const uint32_t& end, const size_t& y, size_t& candidate);
+
+    /**
+     *  labels the runs of `mask_`, being row `y` of the image.
+     */
+    void     label_row_(const size_t& y);
+    void     publish_(const FrameView& frame);
+public:
+    BlobStage(const uint32_t& threshold = 128, const size_t& min_area = 1,
+              const size_t& max_blobs = 1, const size_t& capacity = 1024,
+              const size_t& max_labels = 65536);
+
+    /**
+     *  restricts the tracking to a region, in pixels from the top-left corner.
+     *  must be set while there is no acquisition.
+     */
+    void region(const size_t& x, const size_t& y, const size_t& width, const size_t& height);
+
+    bool configure(const FrameFormat& format);
+
+    template<class Traits>
+    void run(const FrameView& frame);
+
+    const char *name() const override { return "BlobStage"; }
+
+    /**
+     *  moves up to `max_records` of the oldest records into `records`.
+     *  must not be called from more than one thread at a time.
+     */
+    size_t   read(BlobRecord *records, const size_t& max_records) { return results_.pop(records, max_records); }
+    size_t   pending() const { return results_.size(); }
+    uint64_t dropped() const { return results_.dropped(); }
+};
+
+template<class Traits>
+void BlobStage::run(const FrameView& frame)
+{
+    typedef typename Traits::value_type value_type;
+    // kept in locals: stores to the mask could alias the members as far as the compiler knows
+    const size_t   row_bytes = format_.row_bytes();
+    const uint32_t threshold = threshold_;
+    const size_t   width     = width_;
+    uint8_t       *mask      = mask_.data();
+
+    parent_.clear();
+    area_.clear();
+    sum_x_.clear();
+    sum_y_.clear();
+    previous_.clear();
+    overflow_ = false;
+
+    for (size_t y = y0_; y < y0_ + height_; y++) {
+        const size_t row = format_.bottom_up? (format_.height - 1 - y) : y;
+        const value_type *in = (const value_type *)(frame.data + row * row_bytes) + x0_ * Traits::channels;
+        if (Traits::channels == 1) {
+            for (size_t x = 0; x < width; x++) {
+                mask[x] = (uint8_t)(in[x] > threshold);
+            }
+        } else {
+            for (size_t x = 0; x < width; x++, in += Traits::channels) {
+                const uint32_t luma = (29 * (uint32_t)in[0] + 150 * (uint32_t)in[1] + 77 * (uint32_t)in[2]) >> 8;
+                mask[x] = (uint8_t)(luma > threshold);
+            }
+        }
+        label_row_(y);
+    }
+    publish_(frame);
+}
+
+#define BLOB_UTILS_HPP_
+#endif
@@ -0,0 +1,81 @@
+/*
+ *  MIT License
+ *
+ *  Copyright (c) 2021 Keisuke Sehara
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+*/
+#include "crop_utils.hpp"
+
+FrameCrop::FrameCrop():
+    x_(0), y_(0), width_(0), height_(0), bin_(1), active_(false),
+    input_(), output_(), offset_(0), kernel_(nullptr) { }
+
+void FrameCrop::region(const size_t& x, const size_t& y, const size_t& width, const size_t& height)
+{
+    x_      = x;
+    y_      = y;
+    width_  = width;
+    height_ = height;
+    active_ = true;
+}
+
+void FrameCrop::clear()
+{
+    x_      = 0;
+    y_      = 0;
+    width_  = 0;
+    height_ = 0;
+    bin_    = 1;
+    active_ = false;
+}
+
+bool FrameCrop::prepare(const FrameFormat& format)
+{
+    Binder binder = { nullptr, bin_ };
+    kernel_ = nullptr;
+    if (!visit_format(format, binder)) {
+        return false;
+    }
+    if ((x_ >= format.width) || (y_ >= format.height)) {
+        return false;
+    }
+    const size_t width  = std::min((width_  > 0)? width_  : format.width,  format.width  - x_) / bin_;
+    const size_t height = std::min((height_ > 0)? height_ : format.height, format.height - y_) / bin_;
+    if ((width == 0) || (height == 0)) {
+        return false;
+    }
+
+    input_         = format;
+    output_        = format;
+    output_.width  = width;
+    output_.height = height;
+    output_.size   = width * height * (format.bits_per_pixel / 8);
+
+    // the region is flipped in memory for bottom-up frames
+    const size_t bytes = format.bits_per_pixel / 8;
+    const size_t row   = format.bottom_up? (format.height - y_ - height * bin_) : y_;
+    offset_  = row * format.row_bytes() + x_ * bytes;
+    kernel_  = binder.kernel;
+
+    const size_t values = (format.color == FormatY16)? 1 : bytes;
+    lines_.assign((bin_ > 1)? (width * bin_ * values) : 0, 0);
+    sums_.assign((bin_ > 1)? (width * values) : 0, 0);
+    return true;
+}
@@ -0,0 +1,166 @@
+/*
+ *  MIT License
+ *
+ *  Copyright (c) 2021 Keisuke Sehara
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+*/
+#ifndef CROP_UTILS_HPP_
+#include <algorithm>
+#include <vector>
+#include "format_utils.hpp"
+
+/**
+ *  a software region of interest, optionally binned, for cameras that cannot
+ *  crop in hardware. the region is in pixels from the top-left corner of the image,
+ *  and the cropped frames keep the row order (and the color format) of the frames.
+ *
+ *  without binning, the region is a strided view into the frame, and needs
+ *  to be copied only where the frame is copied anyway (i.e. into the pool).
+ */
+class FrameCrop
+{
+private:
+    typedef void (*Kernel)(const FrameCrop *self, const uint8_t *src, uint8_t *dst);
+
+    template<class Traits>
+    static void copy_(const FrameCrop *self, const uint8_t *src, uint8_t *dst);
+
+    template<class Traits>
+    static void binned_(const FrameCrop *self, const uint8_t *src, uint8_t *dst);
+
+    struct Binder
+    {
+        Kernel kernel;
+        size_t bin;
+        template<class Traits> void apply() {
+            kernel = (bin > 1)? &FrameCrop::template binned_<Traits> : &FrameCrop::template copy_<Traits>;
+        }
+    };
+
+    size_t      x_;      // as requested
+    size_t      y_;
+    size_t      width_;  // 0 to the edge of the frame
+    size_t      height_;
+    size_t      bin_;
+    bool        active_;
+
+    FrameFormat input_;
+    FrameFormat output_;
+    size_t      offset_; // from the frame to the first value of the region, in bytes
+    Kernel      kernel_;
+    mutable std::vector<uint32_t> lines_; // the sums of the rows of a row of blocks
+    mutable std::vector<uint32_t> sums_;  // of a row of blocks
+public:
+    FrameCrop();
+
+    void region(const size_t& x, const size_t& y, const size_t& width, const size_t& height);
+    void binning(const size_t& bin) { bin_ = (bin > 0)? bin : 1; }
+    void clear();
+
+    bool   active() const { return active_; }
+    size_t bin() const { return bin_; }
+
+    /**
+     *  clips the region to frames of `format`.
+     *  @return false if the format is not supported, or if nothing is left of the region.
+     */
+    bool prepare(const FrameFormat& format);
+
+    /**
+     *  the layout of the cropped frames (valid after prepare()).
+     */
+    const FrameFormat& output() const { return output_; }
+
+    /**
+     *  the region as a strided view: the first value of the region in `frame`.
+     *  rows are then input().row_bytes() apart.
+     */
+    const uint8_t *view(const uint8_t *frame) const { return frame + offset_; }
+    const FrameFormat& input() const { return input_; }
+
+    /**
+     *  writes the cropped (and binned) frame, of output().size bytes, to `dst`.
+     *  not to be called from more than one thread at a time.
+     */
+    void apply(const uint8_t *src, uint8_t *dst) const { kernel_(this, src, dst); }
+};
+
+template<class Traits>
+void FrameCrop::copy_(const FrameCrop *self, const uint8_t *src, uint8_t *dst)
+{
+    const size_t in_bytes  = self->input_.row_bytes();
+    const size_t out_bytes = self->output_.row_bytes();
+    const uint8_t *in = src + self->offset_;
+    for (size_t row = 0; row < self->output_.height; row++, in += in_bytes, dst += out_bytes) {
+        std::memcpy(dst, in, out_bytes);
+    }
+}
+
+template<class Traits>
+void FrameCrop::binned_(const FrameCrop *self, const uint8_t *src, uint8_t *dst)
+{
+    typedef typename Traits::value_type value_type;
+    const size_t bin      = self->bin_;
+    const size_t in_bytes = self->input_.row_bytes();
+    const size_t values   = self->lines_.size();
+    const size_t outputs  = self->sums_.size();
+    const float  scale    = 1.0f / (float)(bin * bin);
+    uint32_t    *lines    = self->lines_.data();
+    uint32_t    *sums     = self->sums_.data();
+
+    const uint8_t *in  = src + self->offset_;
+    value_type    *out = (value_type *)dst;
+    for (size_t row = 0; row < self->output_.height; row++, in += bin * in_bytes, out += outputs) {
+        // the rows of the blocks are added up first, which vectorizes
+        std::fill(lines, lines + values, 0);
+        for (size_t k = 0; k < bin; k++) {
+            const value_type *line = (const value_type *)(in + k * in_bytes);
+            for (size_t i = 0; i < values; i++) {
+                lines[i] += line[i];
+            }
+        }
+        const uint32_t *sum = lines;
+        if (bin == 2) {
+            // the usual case, with a fixed trip count
+            for (size_t i = 0; i < outputs; i += Traits::channels, sum += 2 * Traits::channels) {
+                for (size_t c = 0; c < Traits::channels; c++) {
+                    sums[i + c] = sum[c] + sum[Traits::channels + c];
+                }
+            }
+        } else {
+            for (size_t i = 0; i < outputs; i += Traits::channels, sum += bin * Traits::channels) {
+                for (size_t c = 0; c < Traits::channels; c++) {
+                    uint32_t block = 0;
+                    for (size_t j = 0; j < bin; j++) {
+                        block += sum[j * Traits::channels + c];
+                    }
+                    sums[i + c] = block;
+                }
+            }
+        }
+        // a multiplication rather than a division, so that the loop vectorizes
+        for (size_t i = 0; i < outputs; i++) {
+            out[i] = (value_type)(int32_t)((float)(int32_t)sums[i] * scale + 0.5f);
+        }
+    }
+}
+
+#define CROP_UTILS_HPP_
+#endif
@@ -0,0 +1,166 @@
+/*
+ *  MIT License
+ *
+ *  Copyright (c) 2021 Keisuke Sehara
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+*/
+#include "device_utils.hpp"
+#include <iostream>
+
+NativeDevice::NativeDevice(FrameCallback callback, void *user_data):
+    grabber_(),
+    listener_(callback, user_data),
+    sink_(),
+    prepared_(false) { }
+
+NativeDevice::~NativeDevice()
+{
+    close();
+}
+
+std::vector<std::string> NativeDevice::list_names()
+{
+    DShowLib::Grabber        grabber;
+    std::vector<std::string> names;
+    for (auto& dev: *(grabber.getAvailableVideoCaptureDevices())) {
+        names.push_back(dev.getUniqueName());
+    }
+    return names;
+}
+
+bool NativeDevice::check_(const bool& ret, const char *action)
+{
+    if (!ret) {
+        std::cerr << "***" << action << " failed: "
+                  << grabber_.getLastError().toString() << std::endl;
+    }
+    return ret;
+}
+
+bool NativeDevice::open(const std::string& unique_name)
+{
+    return check_(grabber_.openDevByUniqueName(unique_name), "openDevByUniqueName()");
+}
+
+bool NativeDevice::is_open()
+{
+    return grabber_.isDevOpen();
+}
+
+void NativeDevice::close()
+{
+    if (prepared_) {
+        stop();
+    }
+    if (grabber_.isDevOpen()) {
+        check_(grabber_.closeDev(), "closeDev()");
+    }
+}
+
+std::vector<std::string> NativeDevice::list_video_formats()
+{
+    std::vector<std::string> formats;
+    for (auto& fmt: *(grabber_.getAvailableVideoFormats())) {
+        formats.push_back(fmt.toString());
+    }
+    return formats;
+}
+
+std::string NativeDevice::video_format()
+{
+    return grabber_.getVideoFormat().toString();
+}
+
+bool NativeDevice::video_format(const std::string& format)
+{
+    if (!check_(grabber_.setVideoFormat(format), "setVideoFormat()")) {
+        return false;
+    }
+    switch (grabber_.getVideoFormat().getFrameType().getColorformat()) {
+    case DShowLib::eUYVY:
+    case DShowLib::eY800:
+    case DShowLib::eYGB1:
+    case DShowLib::eYGB0:
+    case DShowLib::eY16:
+        if (!grabber_.isFlipVAvailable() || !grabber_.setFlipV(true)) {
+            std::cerr << "***cannot flip images vertically in hardware" << std::endl;
+        }
+        break;
+    default:
+        break;
+    }
+    return true;
+}
+
+DShowLib::FrameTypeInfo NativeDevice::frame_type()
+{
+    return grabber_.getVideoFormat().getFrameType();
+}
+
+double NativeDevice::frame_rate()
+{
+    return grabber_.getFPS();
+}
+
+bool NativeDevice::frame_rate(const double& fps)
+{
+    return check_(grabber_.setFPS(fps), "setFPS()");
+}
+
+bool NativeDevice::triggered(const bool& value)
+{
+    return check_(grabber_.setExternalTrigger(value), "setExternalTrigger()");
+}
+
+bool NativeDevice::prepare(const size_t& buffer_count)
+{
+    if (prepared_) {
+        return true;
+    }
+    listener_.buffer_count(buffer_count);
+    sink_ = as_sink(DShowLib::FrameQueueSink::create(listener_, frame_type()));
+    if (!check_(grabber_.setSinkType(sink_), "setSinkType()")
+        || !check_(grabber_.prepareLive(false), "prepareLive()")) {
+        return false;
+    }
+    prepared_ = true;
+    return true;
+}
+
+bool NativeDevice::start()
+{
+    if (!prepared_) {
+        std::cerr << "***start() is called before prepare()" << std::endl;
+        return false;
+    }
+    return check_(grabber_.startLive(false), "startLive()");
+}
+
+bool NativeDevice::suspend()
+{
+    return check_(grabber_.suspendLive(), "suspendLive()");
+}
+
+bool NativeDevice::stop()
+{
+    bool ret  = check_(grabber_.stopLive(), "stopLive()");
+    prepared_ = false;
+    return ret;
+}
@@ -0,0 +1,91 @@
+/*
+ *  MIT License
+ *
+ *  Copyright (c) 2021 Keisuke Sehara
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+*/
+#ifndef DEVICE_UTILS_HPP_
+#include <tisudshl.h>
+#include <string>
+#include <vector>
+#include "sink_utils.hpp"
+
+/**
+ *  drives a camera from C++, without going through the Python module.
+ *  frames are acquired through a FrameQueueSink, and delivered to
+ *  the callback and the consumers of listener().
+ *
+ *  DShowLib::InitLibrary() must have been called beforehand.
+ */
+class NativeDevice
+{
+private:
+    DShowLib::Grabber                          grabber_;
+    DefaultFrameQueueSinkListener              listener_;
+    smart_ptr<DShowLib::GrabberSinkType>       sink_;
+    bool                                       prepared_;
+
+    /**
+     *  reports the last error of the grabber to std::cerr.
+     *  @return `ret`
+     */
+    bool check_(const bool& ret, const char *action);
+public:
+    /**
+     *  `callback` may be nullptr when frames are only handled by consumers.
+     */
+    NativeDevice(FrameCallback callback = nullptr, void *user_data = nullptr);
+    ~NativeDevice();
+
+    /**
+     *  @return the unique names of the available devices.
+     */
+    static std::vector<std::string> list_names();
+
+    bool open(const std::string& unique_name);
+    bool is_open();
+    void close();
+
+    std::vector<std::string> list_video_formats();
+    std::string              video_format();
+    /**
+     *  also flips bottom-up formats vertically in hardware, where possible.
+     */
+    bool                     video_format(const std::string& format);
+    DShowLib::FrameTypeInfo  frame_type();
+
+    double frame_rate();
+    bool   frame_rate(const double& fps);
+    bool   triggered(const bool& value);
+
+    /**
+     *  the listener to configure (delivery, consumers, threads)
+     *  before calling prepare().
+     */
+    DefaultFrameQueueSinkListener& listener() { return listener_; }
+
+    bool prepare(const size_t& buffer_count);
+    bool start();
+    bool suspend();
+    bool stop();
+};
+
+#define DEVICE_UTILS_HPP_
+#endif
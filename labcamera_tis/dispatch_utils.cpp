@@ -0,0 +1,170 @@
+/*
+ *  MIT License
+ *
+ *  Copyright (c) 2021 Keisuke Sehara
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+*/
+#include "dispatch_utils.hpp"
+#include <cstring>
+
+void consumer_context(FrameConsumer *consumer, FramePool *pool) {
+    consumer->run(pool);
+}
+
+FrameConsumer::FrameConsumer(FramePool *pool):
+    active(false),
+    callback(nullptr),
+    user_data(nullptr),
+    depth(0),
+    queue(pool) { }
+
+void FrameConsumer::run(FramePool *pool)
+{
+    if (!placement.is_default()) {
+        apply_placement(placement, "consumer");
+    }
+    while(true)
+    {
+        FrameSlot *slot = queue.pop();
+        if (slot == nullptr) {
+            break;
+        }
+        latency.record(monotonic_seconds() - slot->timestamp);
+        callback(slot, user_data);
+        pool->release(slot);
+    }
+    // mark end-of-acquisition
+    callback(nullptr, user_data);
+}
+
+FrameDispatcher::FrameDispatcher():
+    running_(false) { }
+
+void FrameDispatcher::configure(const size_t& index,
+                                SlotCallback callback, void *user_data,
+                                const DeliveryPolicy& policy, const size_t& depth,
+                                const double& target_rate)
+{
+    while (consumers_.size() <= index) {
+        consumers_.emplace_back(new FrameConsumer(&pool_));
+    }
+    FrameConsumer& consumer = *(consumers_[index]);
+    consumer.active    = (depth > 0) && (callback != nullptr);
+    consumer.callback  = callback;
+    consumer.user_data = user_data;
+    consumer.depth     = depth;
+    consumer.queue.configure(policy, depth, target_rate);
+}
+
+size_t FrameDispatcher::add_consumer(SlotCallback callback, void *user_data,
+                                     const DeliveryPolicy& policy, const size_t& depth,
+                                     const double& target_rate)
+{
+    size_t index = consumers_.size();
+    configure(index, callback, user_data, policy, depth, target_rate);
+    return index;
+}
+
+void FrameDispatcher::clear(const size_t& index)
+{
+    for (size_t i = index; i < consumers_.size(); i++) {
+        consumers_[i]->active = false;
+    }
+}
+
+bool FrameDispatcher::active() const
+{
+    for (auto& consumer: consumers_) {
+        if (consumer->active) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void FrameDispatcher::start(const size_t& size)
+{
+    // each consumer holds at most `depth` pending slots plus the one
+    // being processed; one more slot is being filled by dispatch()
+    size_t count = 1;
+    for (auto& consumer: consumers_) {
+        if (consumer->active) {
+            count += consumer->depth + 1;
+        }
+    }
+    pool_.allocate(count, size);
+    accepted_.reserve(consumers_.size());
+
+    for (auto& consumer: consumers_) {
+        if (consumer->active) {
+            consumer->queue.reset();
+            consumer->latency.reset();
+            consumer->worker = std::thread(consumer_context, consumer.get(), &pool_);
+        }
+    }
+    running_ = true;
+}
+
+void FrameDispatcher::dispatch(const uint8_t *data, const size_t& size,
+                               const uint64_t& sequence, const double& timestamp,
+                               const FrameCrop *crop)
+{
+    accepted_.clear();
+    for (auto& consumer: consumers_) {
+        if (consumer->active && consumer->queue.accepts(timestamp)) {
+            accepted_.push_back(consumer.get());
+        }
+    }
+    if (accepted_.empty()) {
+        return;
+    }
+
+    FrameSlot *slot = pool_.acquire(accepted_.size());
+    if (crop != nullptr) {
+        crop->apply(data, slot->data);
+        slot->size = crop->output().size;
+    } else {
+        std::memcpy(slot->data, data, size);
+        slot->size = size;
+    }
+    slot->sequence  = sequence;
+    slot->timestamp = timestamp;
+    for (auto consumer: accepted_) {
+        consumer->queue.push(slot);
+    }
+}
+
+void FrameDispatcher::stop()
+{
+    if (!running_) {
+        return;
+    }
+    for (auto& consumer: consumers_) {
+        if (consumer->active) {
+            consumer->queue.close();
+        }
+    }
+    for (auto& consumer: consumers_) {
+        if (consumer->worker.joinable()) {
+            consumer->worker.join();
+        }
+    }
+    running_ = false;
+}
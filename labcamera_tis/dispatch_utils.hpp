@@ -0,0 +1,143 @@
+/*
+ *  MIT License
+ *
+ *  Copyright (c) 2021 Keisuke Sehara
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+*/
+#ifndef DISPATCH_UTILS_HPP_
+#include <memory>
+#include <thread>
+#include <vector>
+#include "pool_utils.hpp"
+#include "thread_utils.hpp"
+#include "stats_utils.hpp"
+#include "crop_utils.hpp"
+
+/**
+ *  called on the consumer's own thread.
+ *  `slot` is nullptr at the end of the acquisition.
+ *  the dispatcher releases `slot` after the callback returns.
+ */
+typedef void (*SlotCallback)(FrameSlot *slot, void *user_data);
+
+/**
+ *  a consumer of pooled frames, with its own queue, policy and worker thread.
+ */
+struct FrameConsumer
+{
+    bool          active;
+    SlotCallback  callback;
+    void         *user_data;
+    size_t        depth;
+    FrameQueue    queue;
+    std::thread   worker;
+
+    ThreadPlacement  placement;
+    LatencyHistogram latency; // from reception to the start of the callback
+
+    FrameConsumer(FramePool *pool);
+    void run(FramePool *pool);
+};
+
+/**
+ *  copies each frame once into a FramePool, and shares the slot
+ *  (by reference counting) with all the consumers that accept it.
+ *  a consumer that falls behind only affects its own queue.
+ */
+class FrameDispatcher
+{
+private:
+    FramePool                                   pool_;
+    std::vector<std::unique_ptr<FrameConsumer>> consumers_;
+    std::vector<FrameConsumer*>                 accepted_; // scratch space for dispatch()
+    bool                                        running_;
+public:
+    FrameDispatcher();
+
+    /**
+     *  (re-)configures the consumer at `index`, adding consumers as needed.
+     *  a `depth` of 0 de-activates the consumer.
+     *  must not be called during acquisition.
+     */
+    void configure(const size_t& index,
+                   SlotCallback callback, void *user_data,
+                   const DeliveryPolicy& policy, const size_t& depth,
+                   const double& target_rate);
+
+    /**
+     *  appends a consumer.
+     *  @return the index of the consumer.
+     */
+    size_t add_consumer(SlotCallback callback, void *user_data,
+                        const DeliveryPolicy& policy, const size_t& depth,
+                        const double& target_rate);
+
+    /**
+     *  de-activates all the consumers from `index` on.
+     */
+    void clear(const size_t& index = 0);
+
+    /**
+     *  @return whether any consumer is active.
+     */
+    bool active() const;
+
+    void placement(const size_t& index, const ThreadPlacement& placement) {
+        consumers_[index]->placement = placement;
+    }
+
+    void memory(const MemoryPolicy& policy) { pool_.memory(policy); }
+
+    /**
+     *  see FramePool::holds() and FramePool::hold().
+     */
+    void       holds(const size_t& count) { pool_.holds(count); }
+    FrameHold *hold(const uint8_t *data) { return pool_.hold(data); }
+
+    /**
+     *  allocates the pool for frames of `size` bytes, and starts the workers.
+     *  the pool memory is first touched by the calling thread, so that it is
+     *  placed on the NUMA node of the calling thread (unless the memory policy
+     *  binds it to a node).
+     */
+    void start(const size_t& size);
+
+    /**
+     *  hands the frame over to the consumers that accept it.
+     *  the frame is copied at most once; only the region of `crop`
+     *  is copied if it is given (the pool is then to be started with its size).
+     */
+    void dispatch(const uint8_t *data, const size_t& size,
+                  const uint64_t& sequence, const double& timestamp,
+                  const FrameCrop *crop = nullptr);
+
+    /**
+     *  lets the consumers drain their queues, and joins the workers.
+     */
+    void stop();
+
+    size_t        size() const { return consumers_.size(); }
+    bool          is_active(const size_t& index) const { return consumers_[index]->active; }
+    DeliveryStats stats(const size_t& index) { return consumers_[index]->queue.stats(); }
+    const LatencyHistogram *latency(const size_t& index) const { return &(consumers_[index]->latency); }
+};
+
+#define DISPATCH_UTILS_HPP_
+#endif
@@ -0,0 +1,84 @@
+/*
+ *  MIT License
+ *
+ *  Copyright (c) 2021 Keisuke Sehara
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+*/
+#include "dlpack_utils.hpp"
+
+/**
+ *  a DLManagedTensor along with the storage of its shape and strides,
+ *  allocated at once.
+ */
+struct ExportedTensor
+{
+    DLManagedTensor managed;
+    int64_t         shape[DLPACK_MAX_DIMS];
+    int64_t         strides[DLPACK_MAX_DIMS];
+    TensorRelease   release;
+    void           *context;
+};
+
+static void delete_tensor(DLManagedTensor *self)
+{
+    ExportedTensor *tensor = (ExportedTensor *)(self->manager_ctx);
+    if (tensor->release != nullptr) {
+        tensor->release(tensor->context);
+    }
+    delete tensor;
+}
+
+DLManagedTensor *export_tensor(void *data, const int& ndim, const int64_t *shape,
+                               const int64_t *strides, const uint8_t& bits,
+                               TensorRelease release, void *context)
+{
+    const int64_t itemsize = bits / 8;
+    if ((ndim < 1) || (ndim > DLPACK_MAX_DIMS) || (itemsize == 0)) {
+        return nullptr;
+    }
+    for (int i = 0; i < ndim; i++) {
+        if (strides[i] % itemsize != 0) {
+            return nullptr;
+        }
+    }
+
+    ExportedTensor *tensor = new ExportedTensor();
+    for (int i = 0; i < ndim; i++) {
+        tensor->shape[i]   = shape[i];
+        tensor->strides[i] = strides[i] / itemsize;
+    }
+    tensor->release = release;
+    tensor->context = context;
+
+    DLTensor& dl = tensor->managed.dl_tensor;
+    dl.data               = data;
+    dl.device.device_type = kDLCPU;
+    dl.device.device_id   = 0;
+    dl.ndim               = ndim;
+    dl.dtype.code         = kDLUInt;
+    dl.dtype.bits         = bits;
+    dl.dtype.lanes        = 1;
+    dl.shape              = tensor->shape;
+    dl.strides            = tensor->strides;
+    dl.byte_offset        = 0;
+    tensor->managed.manager_ctx = tensor;
+    tensor->managed.deleter     = delete_tensor;
+    return &(tensor->managed);
+}
@@ -0,0 +1,100 @@
+/*
+ *  MIT License
+ *
+ *  Copyright (c) 2021 Keisuke Sehara
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+*/
+#ifndef DLPACK_UTILS_HPP_
+#include <cstddef>
+#include <cstdint>
+
+/*
+ *  the parts of the DLPack ABI (dlpack.h, v0.8) that are needed to export
+ *  frames. skipped when dlpack.h itself has been included.
+ */
+#ifndef DLPACK_DLPACK_H_
+enum DLDeviceType
+{
+    kDLCPU = 1,
+};
+
+enum DLDataTypeCode
+{
+    kDLInt   = 0,
+    kDLUInt  = 1,
+    kDLFloat = 2,
+};
+
+struct DLDevice
+{
+    int32_t device_type; // DLDeviceType
+    int32_t device_id;
+};
+
+struct DLDataType
+{
+    uint8_t  code;       // DLDataTypeCode
+    uint8_t  bits;
+    uint16_t lanes;
+};
+
+struct DLTensor
+{
+    void       *data;
+    DLDevice    device;
+    int32_t     ndim;
+    DLDataType  dtype;
+    int64_t    *shape;
+    int64_t    *strides;     // in elements, not in bytes
+    uint64_t    byte_offset;
+};
+
+struct DLManagedTensor
+{
+    DLTensor  dl_tensor;
+    void     *manager_ctx;
+    void    (*deleter)(DLManagedTensor *self);
+};
+#endif
+
+/**
+ *  called by the deleter of an exported tensor, to release what it views.
+ */
+typedef void (*TensorRelease)(void *context);
+
+/**
+ *  the maximum number of dimensions of an exported tensor
+ *  (a batch of frames with color channels).
+ */
+#define DLPACK_MAX_DIMS 4
+
+/**
+ *  wraps `ndim` dimensions of unsigned integers of `bits` bits at `data` into
+ *  a DLManagedTensor on the CPU. `shape` and `strides` (in bytes) are copied into it.
+ *  the deleter of the tensor calls `release(context)` and frees the tensor.
+ *  @return nullptr if `ndim` is not supported, or `strides` are not
+ *          multiples of the element size.
+ */
+DLManagedTensor *export_tensor(void *data, const int& ndim, const int64_t *shape,
+                               const int64_t *strides, const uint8_t& bits,
+                               TensorRelease release, void *context);
+
+#define DLPACK_UTILS_HPP_
+#endif
@@ -0,0 +1,170 @@
+/*
+ *  MIT License
+ *
+ *  Copyright (c) 2021 Keisuke Sehara
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+*/
+#ifndef FORMAT_UTILS_HPP_
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+/**
+ *  the values of DShowLib::tColorformatEnum (udshl/simplectypes.h),
+ *  repeated here so that frame processing can be built without the SDK.
+ */
+enum ColorFormat
+{
+    FormatInvalid = 0,
+    FormatRGB32   = 1,  // 32 bit BGRA
+    FormatRGB24   = 2,  // 24 bit BGR
+    FormatY800    = 7,  // 8 bit grayscale top-down
+    FormatY16     = 11, // 16 bit grayscale top-down
+};
+
+/**
+ *  the layout of a frame, fixed during an acquisition.
+ */
+struct FrameFormat
+{
+    ColorFormat color;
+    unsigned    bits_per_pixel;
+    size_t      width;
+    size_t      height;
+    size_t      size;      // buffer size in bytes
+    bool        bottom_up; // whether the first row in memory is the bottom row of the image
+
+    size_t row_bytes() const { return (height > 0)? (size / height) : 0; }
+};
+
+/**
+ *  a frame as seen by the processing stages.
+ */
+struct FrameView
+{
+    const uint8_t *data;
+    size_t         size;
+    uint64_t       sequence;
+    double         timestamp; // monotonic_seconds() at reception
+};
+
+/**
+ *  compile-time properties of a color format at a given bit depth.
+ *  only the formats that the Python module supports are defined.
+ */
+template<ColorFormat Color, unsigned BitsPerPixel>
+struct FormatTraits;
+
+template<>
+struct FormatTraits<FormatY800, 8>
+{
+    typedef uint8_t value_type;
+    static const ColorFormat color    = FormatY800;
+    static const size_t      channels = 1;
+    static const unsigned    bits     = 8;  // per value
+};
+
+template<>
+struct FormatTraits<FormatY16, 16>
+{
+    typedef uint16_t value_type; // little-endian
+    static const ColorFormat color    = FormatY16;
+    static const size_t      channels = 1;
+    static const unsigned    bits     = 16;
+};
+
+template<>
+struct FormatTraits<FormatRGB24, 24>
+{
+    typedef uint8_t value_type;
+    static const ColorFormat color    = FormatRGB24;
+    static const size_t      channels = 3; // B, G, R
+    static const unsigned    bits     = 8;
+};
+
+template<>
+struct FormatTraits<FormatRGB32, 32>
+{
+    typedef uint8_t value_type;
+    static const ColorFormat color    = FormatRGB32;
+    static const size_t      channels = 4; // B, G, R, A
+    static const unsigned    bits     = 8;
+};
+
+typedef FormatTraits<FormatY800,   8> Y800Traits;
+typedef FormatTraits<FormatY16,   16> Y16Traits;
+typedef FormatTraits<FormatRGB24, 24> RGB24Traits;
+typedef FormatTraits<FormatRGB32, 32> RGB32Traits;
+
+/**
+ *  calls `visitor.template apply<Traits>()` with the traits of `format`.
+ *  meant to be called once (e.g. at prepare()) to select a specialization,
+ *  so that the per-frame code does not branch on the format.
+ *
+ *  @return false if the format is not supported.
+ */
+template<class Visitor>
+bool visit_format(const FrameFormat& format, Visitor& visitor)
+{
+    switch (format.color) {
+    case FormatY800:
+        if (format.bits_per_pixel != 8) return false;
+        visitor.template apply<Y800Traits>();
+        return true;
+    case FormatY16:
+        if (format.bits_per_pixel != 16) return false;
+        visitor.template apply<Y16Traits>();
+        return true;
+    case FormatRGB24:
+        if (format.bits_per_pixel != 24) return false;
+        visitor.template apply<RGB24Traits>();
+        return true;
+    case FormatRGB32:
+        if (format.bits_per_pixel != 32) return false;
+        visitor.template apply<RGB32Traits>();
+        return true;
+    default:
+        return false;
+    }
+}
+
+/**
+ *  converts a frame into 8-bit intensities (one value per pixel):
+ *  Y16 is shifted right by `shift` bits (and saturated), and
+ *  colors are converted using the (integer) BT.601 luma weights.
+ */
+template<class Traits>
+void to_gray8(const uint8_t *src, uint8_t *dst,
+              const size_t& width, const size_t& height, const unsigned& shift = 0)
+{
+    const typename Traits::value_type *in = (const typename Traits::value_type *)src;
+    const size_t pixels = width * height;
+    for (size_t i = 0; i < pixels; i++, in += Traits::channels) {
+        if (Traits::channels == 1) {
+            unsigned value = ((unsigned)in[0]) >> shift;
+            dst[i] = (uint8_t)((value > 255)? 255 : value);
+        } else {
+            dst[i] = (uint8_t)((29 * in[0] + 150 * in[1] + 77 * in[2]) >> 8);
+        }
+    }
+}
+
+#define FORMAT_UTILS_HPP_
+#endif
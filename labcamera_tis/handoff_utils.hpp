@@ -0,0 +1,229 @@
+/*
+ *  MIT License
+ *
+ *  Copyright (c) 2021 Keisuke Sehara
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+*/
+#ifndef HANDOFF_UTILS_HPP_
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include "pool_utils.hpp"
+#include "thread_utils.hpp"
+
+/**
+ *  the hand-off of frames from the thread that the sink notifies to the dequeue thread.
+ *  `Sink` only has to report the size of its output queue through getOutputQueueSize()
+ *  (e.g. DShowLib::FrameQueueSink), so that the hand-off can be driven by a fake sink
+ *  for testing (see benchmarks/handoff.cpp).
+ *
+ *  the notifying thread calls notify() for every notification of the sink, and the
+ *  dequeue thread calls wait() before dequeueing each frame, popping() right before
+ *  taking it out of the sink, and popped() afterwards.
+ *  each frame is stamped at the first notification that sees it in the output queue,
+ *  so that popped() reports the latency of that frame even when frames back up.
+ */
+template<class Sink>
+class FrameHandoff
+{
+public:
+    static const size_t STAMPS = 8192; // more than the sink buffers
+private:
+    std::mutex              io_;
+    std::condition_variable reception_;
+    std::atomic<bool>       quit_;
+    std::atomic<uint64_t>   queued_;   // # of notifications (modified under io_)
+
+    WaitStrategy            wait_;
+    double                  spin_budget_; // in seconds; 0 to spin until a frame arrives
+
+    std::atomic<double>     stamps_[STAMPS]; // by the number of frames seen so far
+    std::atomic<uint64_t>   stamped_;  // # of frames stamped (written by notify())
+    std::atomic<uint64_t>   popped_;   // twice the # of frames dequeued, plus 1 while dequeueing one
+
+    /**
+     *  stamps the frames in the output queue that have not been stamped yet with `now`.
+     */
+    void stamp_(Sink& sink, const double& now) {
+        // the frames seen so far are the ones dequeued plus the ones in the queue.
+        // this is exact if no frame is being dequeued meanwhile, and a lower bound
+        // otherwise; the rest is stamped by the next call if the dequeue thread
+        // does not finish popping within the attempts
+        uint64_t seen = 0;
+        for (int attempt = 0; attempt < 64; attempt++) {
+            const uint64_t popped = popped_.load(std::memory_order_seq_cst);
+            if (popped % 2 == 1) {
+                std::this_thread::yield(); // a frame is on its way
+                continue;
+            }
+            const size_t queued = sink.getOutputQueueSize();
+            seen = std::max(seen, popped / 2 + queued);
+            if (popped_.load(std::memory_order_seq_cst) == popped) {
+                break;
+            }
+        }
+        uint64_t stamped = stamped_.load(std::memory_order_relaxed);
+        for (; stamped < seen; stamped++) {
+            stamps_[stamped % STAMPS].store(now, std::memory_order_relaxed);
+        }
+        stamped_.store(stamped, std::memory_order_release);
+    }
+
+    /**
+     *  busy-polls for the next frame within the spin budget
+     *  @return whether a frame has arrived
+     */
+    bool spin_(Sink& sink) {
+        uint64_t     seen  = queued_.load(std::memory_order_acquire);
+        const double start = (spin_budget_ > 0.0)? monotonic_seconds() : 0.0;
+        for (uint64_t i = 0; ; i++) {
+            // the atomic is cheap to poll; the sink is asked only
+            // when it has changed, or once in a while otherwise
+            uint64_t current = queued_.load(std::memory_order_acquire);
+            if ((current != seen) || (i % 64 == 0)) {
+                seen = current;
+                if (sink.getOutputQueueSize() > 0) {
+                    return true;
+                }
+            }
+            if (quit_) {
+                return false;
+            }
+            if ((spin_budget_ > 0.0) && (i % 64 == 63)
+                && (monotonic_seconds() - start > spin_budget_)) {
+                return false;
+            }
+            cpu_relax();
+        }
+    }
+public:
+    FrameHandoff(): quit_(false), queued_(0), wait_(WaitBlocking), spin_budget_(0.0),
+                    stamped_(0), popped_(0) { }
+
+    /**
+     *  starts over for a new connection of the sink. must be called
+     *  before the dequeue thread is started.
+     */
+    void reset() {
+        quit_    = false;
+        stamped_ = 0;
+        popped_  = 0;
+    }
+
+    /**
+     *  sets how wait() waits. WaitSpinning trades a CPU core for the wake-up
+     *  latency of the condition variable; with a non-zero `spin_budget` (in seconds),
+     *  the dequeue thread goes back to sleep after spinning for that long without a frame.
+     */
+    void strategy(const WaitStrategy& strategy, const double& spin_budget) {
+        wait_        = strategy;
+        spin_budget_ = spin_budget;
+    }
+
+    /**
+     *  called for every notification of `sink`. `cancel` ends the waits for good.
+     */
+    void notify(Sink& sink, const bool& cancel) {
+        // the sink is not called while holding io_,
+        // which may be the lock order that the SDK uses
+        stamp_(sink, monotonic_seconds());
+
+        std::unique_lock<std::mutex> lock(io_);
+        // updated under io_, so that the dequeue thread cannot miss it
+        // between reading the counter and starting to wait
+        queued_.fetch_add(1, std::memory_order_release);
+        if (cancel) {
+            quit_ = true; // never revert quit()
+        }
+        reception_.notify_one(); // supposed to be the dequeue thread
+    }
+
+    /**
+     *  marks so that the dequeue thread knows that
+     *  it does not have to wait for frames any more.
+     */
+    void quit() {
+        std::unique_lock<std::mutex> lock(io_);
+        quit_ = true;
+        reception_.notify_all();
+    }
+
+    /**
+     *  waits for the next frame to be received.
+     *  frames are detected through the output queue of the sink, and
+     *  the wait ends whenever notify() has been called since then.
+     *  @return whether to continue waiting for frames
+     */
+    bool wait(Sink& sink) {
+        if (wait_ == WaitSpinning) {
+            if (spin_(sink)) {
+                return true;
+            } else if (quit_) {
+                return false;
+            }
+        }
+        while (true) {
+            // the counter is read _before_ asking the sink, so that any frame
+            // queued after the check below bumps it, and ends the wait
+            const uint64_t seen = queued_.load(std::memory_order_acquire);
+            if (sink.getOutputQueueSize() > 0) {
+                return true;
+            }
+
+            std::unique_lock<std::mutex> lock(io_);
+            reception_.wait(lock, [this, seen]{
+                return quit_ || (queued_.load(std::memory_order_relaxed) != seen);
+            });
+            if (quit_) {
+                return false;
+            }
+        }
+    }
+
+    /**
+     *  called by the dequeue thread right before it takes a frame out of the sink,
+     *  so that notify() does not miss the frame while it is on its way.
+     */
+    void popping() {
+        popped_.fetch_add(1, std::memory_order_seq_cst);
+    }
+
+    /**
+     *  called by the dequeue thread after dequeueing a frame at `now`.
+     *  @return the time since the notification that first saw the frame,
+     *          or 0 if it has been found by polling before its notification.
+     */
+    double popped(const double& now) {
+        const uint64_t index   = popped_.load(std::memory_order_relaxed) / 2;
+        double         latency = 0.0;
+        if (index < stamped_.load(std::memory_order_acquire)) {
+            latency = now - stamps_[index % STAMPS].load(std::memory_order_relaxed);
+        }
+        popped_.fetch_add(1, std::memory_order_seq_cst);
+        return latency;
+    }
+};
+
+#define HANDOFF_UTILS_HPP_
+#endif
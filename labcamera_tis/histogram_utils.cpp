@@ -0,0 +1,217 @@
+/*
+ *  MIT License
+ *
+ *  Copyright (c) 2021 Keisuke Sehara
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+*/
+#include "histogram_utils.hpp"
+#include <cmath>
+#include <cstring>
+
+double histogram_quantile(const std::vector<uint64_t>& counts, const uint64_t& total,
+                          const double& q, const unsigned& shift)
+{
+    if (total == 0) {
+        return 0.0;
+    }
+    const double rank = q * (double)total;
+    uint64_t cumulative = 0;
+    for (size_t bin = 0; bin < counts.size(); bin++) {
+        cumulative += counts[bin];
+        if ((double)cumulative >= rank) {
+            return (double)(bin << shift);
+        }
+    }
+    return (double)((counts.size() - 1) << shift);
+}
+
+ExposureAdvisor::ExposureAdvisor():
+    target_(), limits_(), current_(), wait_(0)
+{
+    target_.quantile      = 0.99;
+    target_.level         = 0.8;
+    target_.max_saturated = 0.01;
+    target_.tolerance     = 0.1;
+    target_.interval      = 4;
+}
+
+void ExposureAdvisor::configure(const ExposureTarget& target, const ExposureLimits& limits)
+{
+    target_ = target;
+    limits_ = limits;
+}
+
+void ExposureAdvisor::reset(const ExposureSettings& current)
+{
+    current_ = current;
+    wait_    = 0;
+}
+
+double ExposureAdvisor::gain_factor_(const double& gain) const
+{
+    if (limits_.gain_db) {
+        return std::pow(10.0, gain / 20.0);
+    }
+    // a linear range may start at 0, which would leave nothing to divide by
+    return (gain > 0.0)? gain : 1.0;
+}
+
+double ExposureAdvisor::gain_value_(const double& factor) const
+{
+    return limits_.gain_db? (20.0 * std::log10(factor)) : factor;
+}
+
+bool ExposureAdvisor::advise(const double& level, const double& saturated, ExposureSettings& next)
+{
+    if (wait_ > 0) {
+        wait_--;
+        return false;
+    }
+
+    double ratio;
+    if (saturated > target_.max_saturated) {
+        // the level says nothing about how much is clipped
+        ratio = 0.5;
+    } else if (level <= 0.0) {
+        ratio = 2.0;
+    } else {
+        ratio = target_.level / level;
+        if (std::fabs(ratio - 1.0) <= target_.tolerance) {
+            return false;
+        }
+        ratio = std::fmin(std::fmax(ratio, 0.5), 2.0);
+    }
+
+    // the exposure takes over as much of the brightness as possible
+    const double brightness = current_.exposure * gain_factor_(current_.gain) * ratio;
+    const double gain_min   = gain_factor_(limits_.gain_min);
+    next.exposure = brightness / gain_min;
+    next.gain     = limits_.gain_min;
+    if (next.exposure > limits_.exposure_max) {
+        next.exposure = limits_.exposure_max;
+        next.gain     = gain_value_(brightness / limits_.exposure_max);
+        next.gain     = std::fmin(std::fmax(next.gain, limits_.gain_min), limits_.gain_max);
+    } else if (next.exposure < limits_.exposure_min) {
+        next.exposure = limits_.exposure_min;
+    }
+
+    if ((next.exposure == current_.exposure) && (next.gain == current_.gain)) {
+        // at the limits
+        return false;
+    }
+    current_ = next;
+    wait_    = target_.interval;
+    return true;
+}
+
+HistogramStage::HistogramStage(const size_t& bins, const size_t& step):
+    bins_(bins),
+    step_((step > 0)? step : 1),
+    used_(256),
+    shift_(0),
+    full_scale_(255.0),
+    kernels_(nullptr),
+    summary_(),
+    actuator_(nullptr),
+    adjusting_(true),
+    adjustments_(0) { }
+
+bool HistogramStage::configure(const FrameFormat& format)
+{
+    std::unique_lock<std::mutex> lock(io_);
+    if (format.color == FormatY16) {
+        used_       = (bins_ == 4096)? 4096 : 256;
+        shift_      = (bins_ == 4096)? 4 : 8;
+        full_scale_ = 65535.0;
+    } else {
+        used_       = 256;
+        shift_      = 0;
+        full_scale_ = 255.0;
+    }
+    kernels_ = &pixel_kernels();
+    counts_.assign(used_, 0);
+    latest_.assign(used_, 0);
+    summary_ = HistogramSummary();
+    if (actuator_ != nullptr) {
+        advisor_.reset(actuator_->read());
+    }
+    return true;
+}
+
+void HistogramStage::auto_exposure(ExposureActuator *actuator,
+                                   const ExposureTarget& target,
+                                   const ExposureLimits& limits)
+{
+    actuator_ = actuator;
+    advisor_.configure(target, limits);
+    adjustments_ = 0;
+}
+
+void HistogramStage::publish_(const FrameView& frame)
+{
+    HistogramSummary summary;
+    summary.sequence  = frame.sequence;
+    summary.timestamp = frame.timestamp;
+    summary.count     = 0;
+
+    double sum = 0.0;
+    for (size_t bin = 0; bin < used_; bin++) {
+        summary.count += counts_[bin];
+        sum += (double)counts_[bin] * (double)(bin << shift_);
+    }
+    const double total = (summary.count > 0)? (double)summary.count : 1.0;
+    summary.mean      = sum / total;
+    summary.saturated = (double)counts_[used_ - 1] / total;
+    summary.low       = histogram_quantile(counts_, summary.count, 0.01, shift_);
+    summary.median    = histogram_quantile(counts_, summary.count, 0.5,  shift_);
+    summary.high      = histogram_quantile(counts_, summary.count, 0.99, shift_);
+
+    {
+        std::unique_lock<std::mutex> lock(io_);
+        latest_.swap(counts_);
+        summary_ = summary;
+    }
+
+    if ((actuator_ != nullptr) && adjusting_.load(std::memory_order_relaxed)) {
+        ExposureSettings next;
+        // latest_ is only modified on this thread
+        const double level = histogram_quantile(latest_, summary.count, advisor_.target().quantile, shift_);
+        if (advisor_.advise(level / full_scale_, summary.saturated, next)) {
+            actuator_->write(next);
+            adjustments_.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+}
+
+HistogramSummary HistogramStage::latest(uint64_t *counts, const size_t& capacity)
+{
+    std::unique_lock<std::mutex> lock(io_);
+    if (counts != nullptr) {
+        const size_t size = (capacity < latest_.size())? capacity : latest_.size();
+        std::memcpy(counts, latest_.data(), size * sizeof(uint64_t));
+    }
+    return summary_;
+}
+
+double HistogramStage::percentile(const double& q)
+{
+    std::unique_lock<std::mutex> lock(io_);
+    return histogram_quantile(latest_, summary_.count, q, shift_);
+}
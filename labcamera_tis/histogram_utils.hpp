@@ -0,0 +1,226 @@
+/*
+ *  MIT License
+ *
+ *  Copyright (c) 2021 Keisuke Sehara
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+*/
+#ifndef HISTOGRAM_UTILS_HPP_
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include "stage_utils.hpp"
+#include "simd_utils.hpp"
+
+/**
+ *  the intensities of a frame, summarized by HistogramStage.
+ *  intensities are in the units of the pixel values (0-255 or 0-65535).
+ */
+struct HistogramSummary
+{
+    uint64_t sequence;
+    double   timestamp;
+    uint64_t count;     // # of values counted
+    double   mean;
+    double   saturated; // fraction of the values in the highest bin
+    double   low;       // the 1st percentile
+    double   median;
+    double   high;      // the 99th percentile
+};
+
+/**
+ *  exposure in seconds, and gain in dB (or as a factor; see ExposureLimits).
+ */
+struct ExposureSettings
+{
+    double exposure;
+    double gain;
+};
+
+struct ExposureLimits
+{
+    double exposure_min;
+    double exposure_max;
+    double gain_min;
+    double gain_max;
+    bool   gain_db;     // whether the gain is in dB rather than a factor (0 or less counting as 1)
+};
+
+/**
+ *  what the auto-exposure loop aims at.
+ */
+struct ExposureTarget
+{
+    double quantile;      // the intensity to control, e.g. 0.99 for the 99th percentile
+    double level;         // where it should be, as a fraction of the full scale
+    double max_saturated; // fraction of saturated values above which the exposure is halved
+    double tolerance;     // relative deviation from `level` that is left as it is
+    size_t interval;      // # of frames to wait for a change to take effect
+};
+
+/**
+ *  writes exposure settings to the camera.
+ *  called from the dequeue thread, and therefore should not look anything up.
+ */
+class ExposureActuator
+{
+public:
+    virtual ~ExposureActuator() { }
+    virtual ExposureSettings read() = 0;
+    virtual void write(const ExposureSettings& settings) = 0;
+};
+
+/**
+ *  the software auto-exposure loop: lengthens the exposure first and
+ *  raises the gain only when the exposure is at its maximum (and the
+ *  other way around), so that the behavior does not depend on the camera model.
+ */
+class ExposureAdvisor
+{
+private:
+    ExposureTarget   target_;
+    ExposureLimits   limits_;
+    ExposureSettings current_;
+    size_t           wait_;
+
+    double gain_factor_(const double& gain) const;
+    double gain_value_(const double& factor) const;
+public:
+    ExposureAdvisor();
+
+    void configure(const ExposureTarget& target, const ExposureLimits& limits);
+
+    /**
+     *  starts over from the `current` settings of the camera.
+     */
+    void reset(const ExposureSettings& current);
+
+    /**
+     *  @param level     the intensity at the target quantile, as a fraction of the full scale.
+     *  @param saturated the fraction of saturated values.
+     *  @return whether the settings are to be changed to `next`.
+     */
+    bool advise(const double& level, const double& saturated, ExposureSettings& next);
+
+    const ExposureTarget&   target() const { return target_; }
+    const ExposureSettings& current() const { return current_; }
+};
+
+/**
+ *  counts the intensities of every frame (all the color channels together), either
+ *  of all the pixels or of every `step`-th pixel of every `step`-th row.
+ *  Y16 frames are counted in 256 or 4096 bins, and the others in 256 bins.
+ *
+ *  with an ExposureActuator, the stage also runs the auto-exposure loop
+ *  on the dequeue thread, writing the exposure at most once in `interval` frames.
+ */
+class HistogramStage: public FormatStage<HistogramStage>
+{
+private:
+    size_t              bins_;     // as configured
+    size_t              step_;
+    size_t              used_;     // bins used for the current format
+    unsigned            shift_;    // from values to bins
+    double              full_scale_;
+    const PixelKernels *kernels_;
+    std::vector<uint64_t> counts_; // of the current frame
+
+    std::mutex            io_;     // guards the copies below
+    std::vector<uint64_t> latest_;
+    HistogramSummary      summary_;
+
+    ExposureActuator     *actuator_;
+    ExposureAdvisor       advisor_;
+    std::atomic<bool>     adjusting_;
+    std::atomic<uint64_t> adjustments_;
+
+    /**
+     *  publishes `counts_`, and runs the auto-exposure loop.
+     */
+    void publish_(const FrameView& frame);
+public:
+    HistogramStage(const size_t& bins = 256, const size_t& step = 1);
+
+    bool configure(const FrameFormat& format);
+
+    template<class Traits>
+    void run(const FrameView& frame);
+
+    const char *name() const override { return "HistogramStage"; }
+
+    /**
+     *  runs the auto-exposure loop with `actuator` (owned by the caller),
+     *  or stops it if `actuator` is nullptr. must be called while there is no acquisition.
+     */
+    void auto_exposure(ExposureActuator *actuator, const ExposureTarget& target, const ExposureLimits& limits);
+
+    /**
+     *  pauses or resumes the auto-exposure loop, at any time.
+     */
+    void adjusting(const bool& value) { adjusting_ = value; }
+    bool adjusting() const { return adjusting_; }
+
+    uint64_t adjustments() const { return adjustments_.load(std::memory_order_relaxed); }
+
+    size_t bins() const { return used_; }
+
+    /**
+     *  copies the counts of the latest frame into `counts` (of `capacity` elements).
+     */
+    HistogramSummary latest(uint64_t *counts = nullptr, const size_t& capacity = 0);
+
+    /**
+     *  the lower edge of the bin where the `q` quantile of the latest frame falls.
+     */
+    double percentile(const double& q);
+};
+
+/**
+ *  the lower edge of the bin where the `q` quantile of `counts` falls.
+ */
+double histogram_quantile(const std::vector<uint64_t>& counts, const uint64_t& total,
+                          const double& q, const unsigned& shift);
+
+template<class Traits>
+void HistogramStage::run(const FrameView& frame)
+{
+    const size_t row_bytes = format_.row_bytes();
+    // the alpha channel of RGB32 is not counted
+    const size_t colors    = (Traits::channels == 4)? 3 : Traits::channels;
+    std::fill(counts_.begin(), counts_.end(), 0);
+
+    if ((Traits::bits == 8) && (colors == Traits::channels) && (step_ == 1)) {
+        kernels_->histogram8(frame.data, row_bytes, format_.width * colors, format_.height, counts_.data());
+    } else {
+        for (size_t row = 0; row < format_.height; row += step_) {
+            const typename Traits::value_type *in =
+                (const typename Traits::value_type *)(frame.data + row * row_bytes);
+            for (size_t x = 0; x < format_.width; x += step_) {
+                for (size_t c = 0; c < colors; c++) {
+                    counts_[in[x * Traits::channels + c] >> shift_]++;
+                }
+            }
+        }
+    }
+    publish_(frame);
+}
+
+#define HISTOGRAM_UTILS_HPP_
+#endif
@@ -0,0 +1,372 @@
+/*
+ *  MIT License
+ *
+ *  Copyright (c) 2021 Keisuke Sehara
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+*/
+#include "io_utils.hpp"
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include "pool_utils.hpp"
+
+struct FilePatch
+{
+    uint64_t             offset;
+    std::vector<uint8_t> data;
+};
+
+/**
+ *  a file of a stream. it is opened and written by the thread of its target;
+ *  the patches are added by the producer before the file is closed.
+ */
+struct ScheduledFile
+{
+    std::string            path;
+    size_t                 target;
+    std::ofstream          out;
+    bool                   opened;
+    std::atomic<bool>      failed;
+    std::vector<FilePatch> patches;
+
+    ScheduledFile(const std::string& path, const size_t& target):
+        path(path), target(target), opened(false), failed(false) { }
+};
+
+static bool is_absolute(const std::string& path)
+{
+    if (path.empty()) {
+        return false;
+    }
+    // also takes drive letters on Windows
+    return (path[0] == '/') || (path[0] == '\\') || ((path.size() > 1) && (path[1] == ':'));
+}
+
+static std::string join(const std::string& root, const std::string& path)
+{
+    if (root.empty()) {
+        return path;
+    }
+    // the directories of an absolute path would put the file on another disk
+    // than the target it is accounted to: only its name is kept
+    const std::string name = is_absolute(path)? path.substr(path.find_last_of("/\\:") + 1) : path;
+    const char last = root[root.size() - 1];
+    return ((last == '/') || (last == '\\'))? (root + name) : (root + "/" + name);
+}
+
+WriteStream::WriteStream(WriteScheduler *scheduler, const std::string& name):
+    scheduler_(scheduler),
+    name_(name),
+    since_(0.0),
+    stats_() { }
+
+std::string WriteStream::open(const std::string& path)
+{
+    close();
+
+    std::unique_lock<std::mutex> lock(scheduler_->io_);
+    if (scheduler_->targets_.empty()) {
+        return std::string();
+    }
+    const size_t index = scheduler_->least_loaded_();
+    WriteScheduler::Target& target = *(scheduler_->targets_[index]);
+    file_ = std::make_shared<ScheduledFile>(join(target.root, path), index);
+    target.stats.files++;
+    return file_->path;
+}
+
+bool WriteStream::write(const void *data, const size_t& size)
+{
+    if (!file_ || file_->failed.load()) {
+        return false;
+    }
+    const size_t   chunk = scheduler_->chunk_bytes_;
+    const uint8_t *src   = (const uint8_t *)data;
+    size_t         left  = size;
+    while (left > 0) {
+        if (chunk_.capacity() == 0) {
+            std::unique_lock<std::mutex> lock(scheduler_->io_);
+            if (!spare_.empty()) {
+                chunk_ = std::move(spare_.back());
+                spare_.pop_back();
+            }
+        }
+        if (chunk_.empty()) {
+            chunk_.reserve(chunk);
+            since_ = monotonic_seconds();
+        }
+        const size_t n = std::min(left, chunk - chunk_.size());
+        chunk_.insert(chunk_.end(), src, src + n);
+        src  += n;
+        left -= n;
+        if (chunk_.size() >= chunk) {
+            submit_(false);
+        }
+    }
+    if (!chunk_.empty() && (monotonic_seconds() - since_ > scheduler_->flush_interval_)) {
+        submit_(false);
+    }
+    return !file_->failed.load();
+}
+
+void WriteStream::patch(const uint64_t& offset, const void *data, const size_t& size)
+{
+    if (!file_) {
+        return;
+    }
+    FilePatch patch;
+    patch.offset = offset;
+    patch.data.assign((const uint8_t *)data, (const uint8_t *)data + size);
+    file_->patches.push_back(patch);
+}
+
+void WriteStream::close()
+{
+    if (!file_) {
+        return;
+    }
+    submit_(true);
+    file_.reset();
+}
+
+void WriteStream::submit_(const bool& close)
+{
+    WriteScheduler::Request request;
+    request.file   = file_;
+    request.data   = std::move(chunk_);
+    request.stream = this;
+    request.since  = monotonic_seconds();
+    request.close  = close;
+    chunk_ = std::vector<uint8_t>();
+
+    const size_t size = request.data.size();
+    const size_t max  = scheduler_->max_pending_;
+    std::unique_lock<std::mutex> lock(scheduler_->io_);
+    if ((size > 0) && (stats_.pending > 0) && (stats_.pending + size > max)) {
+        // back-pressure: a single chunk is always accepted
+        const double start = monotonic_seconds();
+        stats_.stalls++;
+        scheduler_->written_.wait(lock, [this, size, max]{
+            return (stats_.pending == 0) || (stats_.pending + size <= max);
+        });
+        stats_.stalled += monotonic_seconds() - start;
+    }
+    stats_.submitted += size;
+    stats_.pending   += size;
+    waiting_.push_back(request.since);
+
+    WriteScheduler::Target& target = *(scheduler_->targets_[file_->target]);
+    target.stats.pending += size;
+    target.requests++;
+    target.queue.push_back(std::move(request));
+    scheduler_->queued_.notify_all();
+}
+
+bool WriteStream::failed()
+{
+    std::unique_lock<std::mutex> lock(scheduler_->io_);
+    return (stats_.errors > 0) || (file_ && file_->failed.load());
+}
+
+StreamStats WriteStream::stats()
+{
+    std::unique_lock<std::mutex> lock(scheduler_->io_);
+    StreamStats stats = stats_;
+    stats.lag = waiting_.empty()? 0.0 : (monotonic_seconds() - waiting_.front());
+    return stats;
+}
+
+static void write_context(WriteScheduler *scheduler, const size_t index)
+{
+    scheduler->run(index);
+}
+
+WriteScheduler::WriteScheduler(const size_t& chunk_bytes, const size_t& max_pending,
+                               const double& flush_interval):
+    chunk_bytes_(std::max(chunk_bytes, (size_t)4096)),
+    max_pending_(max_pending),
+    flush_interval_(flush_interval),
+    quit_(false) { }
+
+WriteScheduler::~WriteScheduler()
+{
+    {
+        std::unique_lock<std::mutex> lock(io_);
+        quit_ = true;
+        queued_.notify_all();
+    }
+    for (auto& target: targets_) {
+        target->thread.join();
+    }
+}
+
+size_t WriteScheduler::add_target(const std::string& root)
+{
+    std::unique_lock<std::mutex> lock(io_);
+    std::unique_ptr<Target> target(new Target());
+    target->root     = root;
+    target->requests = 0;
+    target->stats    = TargetStats();
+    targets_.push_back(std::move(target));
+
+    const size_t index = targets_.size() - 1;
+    targets_[index]->thread = std::thread(write_context, this, index);
+    return index;
+}
+
+WriteStream *WriteScheduler::stream(const std::string& name)
+{
+    std::unique_lock<std::mutex> lock(io_);
+    streams_.push_back(std::unique_ptr<WriteStream>(new WriteStream(this, name)));
+    return streams_.back().get();
+}
+
+size_t WriteScheduler::least_loaded_() const
+{
+    size_t best = 0;
+    for (size_t i = 1; i < targets_.size(); i++) {
+        const TargetStats& stats = targets_[i]->stats;
+        const TargetStats& least = targets_[best]->stats;
+        if ((stats.pending < least.pending)
+            || ((stats.pending == least.pending) && (stats.files < least.files))) {
+            best = i;
+        }
+    }
+    return best;
+}
+
+void WriteScheduler::run(const size_t& index)
+{
+    Target *target;
+    {
+        std::unique_lock<std::mutex> lock(io_);
+        target = targets_[index].get();
+    }
+    while (true) {
+        Request request;
+        {
+            std::unique_lock<std::mutex> lock(io_);
+            queued_.wait(lock, [this, target]{ return quit_ || !target->queue.empty(); });
+            if (target->queue.empty()) {
+                return;
+            }
+            request = std::move(target->queue.front());
+            target->queue.pop_front();
+        }
+        const bool   was_failed = request.file->failed.load();
+        perform_(request);
+        const bool   ok   = !request.file->failed.load();
+        const size_t size = request.data.size();
+        const double done = monotonic_seconds();
+
+        std::unique_lock<std::mutex> lock(io_);
+        WriteStream *stream = request.stream;
+        target->requests--;
+        target->stats.pending -= size;
+        stream->stats_.pending -= size;
+        if (ok) {
+            target->stats.written  += size;
+            stream->stats_.written += size;
+        } else if (!was_failed) {
+            stream->stats_.errors++;
+        }
+        stream->stats_.max_lag = std::max(stream->stats_.max_lag, done - request.since);
+        auto waiting = std::find(stream->waiting_.begin(), stream->waiting_.end(), request.since);
+        if (waiting != stream->waiting_.end()) {
+            stream->waiting_.erase(waiting);
+        }
+        if (request.data.capacity() > 0) {
+            request.data.clear();
+            stream->spare_.push_back(std::move(request.data));
+        }
+        written_.notify_all();
+    }
+}
+
+void WriteScheduler::perform_(Request& request)
+{
+    ScheduledFile& file = *(request.file);
+    if (!file.failed.load()) {
+        if (!file.opened) {
+            file.opened = true;
+            file.out.open(file.path, std::ios::binary | std::ios::trunc);
+        }
+        if (!request.data.empty()) {
+            file.out.write((const char *)request.data.data(), request.data.size());
+        }
+        if (request.close) {
+            for (const FilePatch& patch: file.patches) {
+                file.out.seekp(patch.offset);
+                file.out.write((const char *)patch.data.data(), patch.data.size());
+            }
+        }
+        if (!file.out) {
+            std::cerr << "***write scheduler: failed to write " << file.path
+                      << "; the rest of the file is discarded" << std::endl;
+            file.failed.store(true);
+        }
+    }
+    if (request.close && file.out.is_open()) {
+        file.out.close();
+    }
+}
+
+void WriteScheduler::drain()
+{
+    std::unique_lock<std::mutex> lock(io_);
+    written_.wait(lock, [this]{
+        for (auto& target: targets_) {
+            if (target->requests > 0) {
+                return false;
+            }
+        }
+        return true;
+    });
+}
+
+size_t WriteScheduler::target_count()
+{
+    std::unique_lock<std::mutex> lock(io_);
+    return targets_.size();
+}
+
+std::string WriteScheduler::target_root(const size_t& index)
+{
+    std::unique_lock<std::mutex> lock(io_);
+    return targets_[index]->root;
+}
+
+TargetStats WriteScheduler::target_stats(const size_t& index)
+{
+    std::unique_lock<std::mutex> lock(io_);
+    return targets_[index]->stats;
+}
+
+size_t WriteScheduler::stream_count()
+{
+    std::unique_lock<std::mutex> lock(io_);
+    return streams_.size();
+}
+
+WriteStream *WriteScheduler::stream_at(const size_t& index)
+{
+    std::unique_lock<std::mutex> lock(io_);
+    return streams_[index].get();
+}
@@ -0,0 +1,229 @@
+/*
+ *  MIT License
+ *
+ *  Copyright (c) 2021 Keisuke Sehara
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+*/
+#ifndef IO_UTILS_HPP_
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct StreamStats
+{
+    uint64_t submitted; // bytes handed to the stream
+    uint64_t written;   // bytes written to the disk
+    uint64_t pending;   // bytes submitted to a disk but not written yet
+    double   lag;       // age of the oldest pending chunk, in seconds
+    double   max_lag;   // of the chunks written so far
+    uint64_t stalls;    // times write() waited for the disk
+    double   stalled;   // seconds spent waiting in write()
+    uint64_t errors;    // files that could not be opened or written
+};
+
+struct TargetStats
+{
+    uint64_t written; // bytes
+    uint64_t pending; // bytes queued for this target
+    size_t   files;   // files assigned so far
+};
+
+class WriteScheduler;
+struct ScheduledFile;
+
+/**
+ *  the writes of a single producer (e.g. a TiffWriter) through a WriteScheduler.
+ *  the bytes are coalesced into chunks, which are written by the thread of the
+ *  target disk of the file. all the methods but stats() are to be called
+ *  from the producer thread.
+ */
+class WriteStream
+{
+private:
+    WriteScheduler *scheduler_;
+    std::string     name_;
+
+    std::shared_ptr<ScheduledFile> file_; // the file being written
+    std::vector<uint8_t>           chunk_;
+    double                         since_; // when chunk_ started to be filled
+
+    // guarded by the scheduler
+    std::vector<std::vector<uint8_t>> spare_;   // chunks that have been written
+    std::deque<double>                waiting_; // the submission times of pending chunks
+    StreamStats                       stats_;
+
+    WriteStream(const WriteStream&);
+    WriteStream& operator=(const WriteStream&);
+
+    friend class WriteScheduler;
+
+    /**
+     *  hands chunk_ to the target of file_, waiting for the disk if
+     *  the stream has too many bytes pending.
+     */
+    void submit_(const bool& close);
+public:
+    WriteStream(WriteScheduler *scheduler, const std::string& name);
+
+    const std::string& name() const { return name_; }
+
+    /**
+     *  starts a new file (closing the current one, if any) on the least loaded target.
+     *  a relative `path` is placed under the root of the target, and only
+     *  the file name of an absolute one.
+     *  @return the actual path of the file, or an empty string if there is no target.
+     */
+    std::string open(const std::string& path);
+
+    /**
+     *  appends `size` bytes to the current file.
+     *  @return false if the file has failed to be opened or written.
+     */
+    bool write(const void *data, const size_t& size);
+
+    /**
+     *  overwrites `size` bytes at `offset` of the current file when it is closed
+     *  (e.g. a header that is only known at the end).
+     */
+    void patch(const uint64_t& offset, const void *data, const size_t& size);
+
+    /**
+     *  hands the rest of the current file to its target, to be closed
+     *  after it is written. does not wait for the disk.
+     */
+    void close();
+
+    /**
+     *  @return whether any file of the stream has failed so far.
+     */
+    bool failed();
+
+    StreamStats stats();
+};
+
+/**
+ *  a process-wide scheduler of the writes of all the recording streams (e.g. of several
+ *  devices). each target (a disk, or a directory on it) has a writer thread of its own,
+ *  and the files are balanced across the targets as they are opened. the streams
+ *  coalesce their writes into chunks of `chunk_bytes`, so that the disks see large
+ *  sequential writes instead of interleaved small ones.
+ *
+ *  a stream has up to `max_pending` bytes waiting for its disk; beyond that, its
+ *  writes wait for the disk (i.e. the back-pressure goes to the consumer queue of the
+ *  stream, and then to the delivery policy). a partially filled chunk is submitted
+ *  once it is older than `flush_interval` seconds, on the next write.
+ */
+class WriteScheduler
+{
+private:
+    struct Request
+    {
+        std::shared_ptr<ScheduledFile> file;
+        std::vector<uint8_t>           data;
+        WriteStream                   *stream;
+        double                         since;
+        bool                           close;
+    };
+
+    struct Target
+    {
+        std::string         root;
+        std::thread         thread;
+        std::deque<Request> queue;
+        size_t              requests; // queued or being written
+        TargetStats         stats;
+    };
+
+    size_t chunk_bytes_;
+    size_t max_pending_;
+    double flush_interval_;
+
+    std::vector<std::unique_ptr<Target>>      targets_;
+    std::vector<std::unique_ptr<WriteStream>> streams_;
+    std::mutex              io_;
+    std::condition_variable queued_;
+    std::condition_variable written_;
+    bool                    quit_;
+
+    WriteScheduler(const WriteScheduler&);
+    WriteScheduler& operator=(const WriteScheduler&);
+
+    friend class WriteStream;
+
+    /**
+     *  writes a single request. called without holding io_.
+     */
+    void perform_(Request& request);
+
+    /**
+     *  @return the index of the target with the fewest bytes pending
+     *          (and then the fewest files). must be called holding io_.
+     */
+    size_t least_loaded_() const;
+public:
+    WriteScheduler(const size_t& chunk_bytes = 8 << 20,
+                   const size_t& max_pending = 256 << 20,
+                   const double& flush_interval = 1.0);
+
+    /**
+     *  drains the queues of all the targets before returning.
+     *  the streams must have been closed beforehand.
+     */
+    ~WriteScheduler();
+
+    /**
+     *  adds a disk (or a directory on it) to be written, and starts its thread.
+     *  @return the index of the target.
+     */
+    size_t add_target(const std::string& root);
+
+    void run(const size_t& index); // writes for target #`index` until destroyed
+
+    /**
+     *  waits until everything that has been submitted so far is written.
+     */
+    void drain();
+
+    /**
+     *  @return a new stream, owned by the scheduler.
+     */
+    WriteStream *stream(const std::string& name);
+
+    size_t       chunk_bytes() const { return chunk_bytes_; }
+    size_t       max_pending() const { return max_pending_; }
+    double       flush_interval() const { return flush_interval_; }
+
+    size_t       target_count();
+    std::string  target_root(const size_t& index);
+    TargetStats  target_stats(const size_t& index);
+
+    size_t       stream_count();
+    WriteStream *stream_at(const size_t& index);
+};
+
+#define IO_UTILS_HPP_
+#endif
@@ -0,0 +1,251 @@
+/*
+ *  MIT License
+ *
+ *  Copyright (c) 2021 Keisuke Sehara
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+*/
+#include "memory_utils.hpp"
+#include <cstring>
+#include <iostream>
+
+#ifdef _WIN32
+#include <windows.h>
+#ifdef _MSC_VER
+#pragma comment(lib, "advapi32.lib") // for the privilege of large pages
+#endif
+#else
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+static size_t round_up(const size_t& size, const size_t& unit)
+{
+    return ((size + unit - 1) / unit) * unit;
+}
+
+FrameMemory::FrameMemory():
+    data_(nullptr), size_(0), mapped_(0), huge_(false), locked_(false) { }
+
+#ifdef _WIN32
+
+/**
+ *  enables SeLockMemoryPrivilege for the process, as required for large pages.
+ */
+static bool enable_lock_privilege()
+{
+    HANDLE token;
+    if (!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token)) {
+        return false;
+    }
+    TOKEN_PRIVILEGES privileges;
+    privileges.PrivilegeCount           = 1;
+    privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+    bool success = LookupPrivilegeValueA(nullptr, "SeLockMemoryPrivilege", &(privileges.Privileges[0].Luid))
+                && AdjustTokenPrivileges(token, FALSE, &privileges, 0, nullptr, nullptr)
+                && (GetLastError() == ERROR_SUCCESS);
+    CloseHandle(token);
+    return success;
+}
+
+static void *virtual_alloc(const size_t& size, const DWORD& type, const int& node)
+{
+    if (node >= 0) {
+        return VirtualAllocExNuma(GetCurrentProcess(), nullptr, size, type, PAGE_READWRITE, (DWORD)node);
+    }
+    return VirtualAlloc(nullptr, size, type, PAGE_READWRITE);
+}
+
+bool FrameMemory::allocate(const size_t& size, const MemoryPolicy& policy)
+{
+    release();
+    if (size == 0) {
+        return true;
+    }
+
+    void *data = nullptr;
+    if (policy.huge_pages) {
+        const size_t large = GetLargePageMinimum();
+        if ((large > 0) && enable_lock_privilege()) {
+            mapped_ = round_up(size, large);
+            data    = virtual_alloc(mapped_, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, policy.numa_node);
+        }
+        if (data == nullptr) {
+            std::cerr << "***failed to allocate large pages (error " << GetLastError()
+                      << "); using normal pages" << std::endl;
+        } else {
+            huge_   = true;
+            locked_ = true;
+        }
+    }
+    if (data == nullptr) {
+        SYSTEM_INFO info;
+        GetSystemInfo(&info);
+        mapped_ = round_up(size, info.dwPageSize);
+        data    = virtual_alloc(mapped_, MEM_RESERVE | MEM_COMMIT, policy.numa_node);
+        if ((data == nullptr) && (policy.numa_node >= 0)) {
+            std::cerr << "***failed to allocate on NUMA node " << policy.numa_node
+                      << " (error " << GetLastError() << ")" << std::endl;
+            data = virtual_alloc(mapped_, MEM_RESERVE | MEM_COMMIT, -1);
+        }
+        if (data == nullptr) {
+            std::cerr << "***failed to allocate " << size << " bytes of frame memory" << std::endl;
+            mapped_ = 0;
+            return false;
+        }
+    }
+    data_ = (uint8_t *)data;
+    size_ = size;
+
+    if (policy.lock && !locked_) {
+        // the working set has to be large enough for the pages to be locked
+        SIZE_T minimum, maximum;
+        HANDLE process = GetCurrentProcess();
+        if (GetProcessWorkingSetSize(process, &minimum, &maximum)) {
+            SetProcessWorkingSetSize(process, minimum + mapped_, maximum + mapped_);
+        }
+        if (VirtualLock(data_, mapped_)) {
+            locked_ = true;
+        } else {
+            std::cerr << "***failed to lock frame memory (error " << GetLastError() << ")" << std::endl;
+        }
+    }
+    // committed pages are zero-filled on first touch
+    std::memset(data_, 0, mapped_);
+    return true;
+}
+
+void FrameMemory::release()
+{
+    if (data_ != nullptr) {
+        if (locked_ && !huge_) {
+            VirtualUnlock(data_, mapped_);
+        }
+        VirtualFree(data_, 0, MEM_RELEASE);
+    }
+    data_   = nullptr;
+    size_   = 0;
+    mapped_ = 0;
+    huge_   = false;
+    locked_ = false;
+}
+
+#else
+
+static const size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+/**
+ *  binds [data, data + size) to `node` through mbind(2), without depending on libnuma.
+ */
+static bool bind_node(void *data, const size_t& size, const int& node)
+{
+#ifdef SYS_mbind
+    const int     MPOL_BIND_ = 2;
+    unsigned long mask[16]   = { 0 };
+    const size_t  bits       = 8 * sizeof(unsigned long);
+    if ((node < 0) || ((size_t)node >= 16 * bits)) {
+        errno = EINVAL;
+        return false;
+    }
+    mask[node / bits] = 1UL << (node % bits);
+    return syscall(SYS_mbind, data, size, MPOL_BIND_, mask, 16 * bits, 0) == 0;
+#else
+    errno = ENOSYS;
+    return false;
+#endif
+}
+
+bool FrameMemory::allocate(const size_t& size, const MemoryPolicy& policy)
+{
+    release();
+    if (size == 0) {
+        return true;
+    }
+
+    void *data = MAP_FAILED;
+#ifdef MAP_HUGETLB
+    if (policy.huge_pages) {
+        mapped_ = round_up(size, HUGE_PAGE_SIZE);
+        data    = mmap(nullptr, mapped_, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (data == MAP_FAILED) {
+            std::cerr << "***failed to allocate huge pages (" << std::strerror(errno)
+                      << "; see vm.nr_hugepages); using normal pages" << std::endl;
+        } else {
+            huge_ = true;
+        }
+    }
+#else
+    if (policy.huge_pages) {
+        std::cerr << "***huge pages are not supported on this platform" << std::endl;
+    }
+#endif
+    if (data == MAP_FAILED) {
+        mapped_ = round_up(size, (size_t)sysconf(_SC_PAGESIZE));
+        data    = mmap(nullptr, mapped_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (data == MAP_FAILED) {
+            std::cerr << "***failed to allocate " << size << " bytes of frame memory: "
+                      << std::strerror(errno) << std::endl;
+            mapped_ = 0;
+            return false;
+        }
+#ifdef MADV_HUGEPAGE
+        if (policy.huge_pages) {
+            madvise(data, mapped_, MADV_HUGEPAGE);
+        }
+#endif
+    }
+    data_ = (uint8_t *)data;
+    size_ = size;
+
+    // before the pages are touched, so that they are faulted in on the node
+    if ((policy.numa_node >= 0) && !bind_node(data_, mapped_, policy.numa_node)) {
+        std::cerr << "***failed to bind frame memory to NUMA node " << policy.numa_node
+                  << ": " << std::strerror(errno) << std::endl;
+    }
+    if (policy.lock) {
+        if (mlock(data_, mapped_) == 0) {
+            locked_ = true;
+        } else {
+            std::cerr << "***failed to lock frame memory: " << std::strerror(errno)
+                      << " (see `ulimit -l`)" << std::endl;
+        }
+    }
+    std::memset(data_, 0, mapped_);
+    return true;
+}
+
+void FrameMemory::release()
+{
+    if (data_ != nullptr) {
+        if (locked_) {
+            munlock(data_, mapped_);
+        }
+        munmap(data_, mapped_);
+    }
+    data_   = nullptr;
+    size_   = 0;
+    mapped_ = 0;
+    huge_   = false;
+    locked_ = false;
+}
+
+#endif
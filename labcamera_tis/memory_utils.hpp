@@ -0,0 +1,86 @@
+/*
+ *  MIT License
+ *
+ *  Copyright (c) 2021 Keisuke Sehara
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+*/
+#ifndef MEMORY_UTILS_HPP_
+#include <cstddef>
+#include <cstdint>
+
+/**
+ *  how frame memory is to be allocated.
+ *
+ *  - huge_pages: backs the memory with 2 MB pages (MAP_HUGETLB on Linux, which
+ *    needs pages reserved in vm.nr_hugepages; MEM_LARGE_PAGES on Windows, which
+ *    needs the "Lock pages in memory" privilege). falls back to normal pages
+ *    (with transparent huge pages on Linux) when they are not available.
+ *  - lock: keeps the memory resident (mlock / VirtualLock), so that it is never
+ *    paged out during acquisition. large pages on Windows are always locked.
+ *  - numa_node: binds the memory to a NUMA node; -1 to place it on the node of
+ *    the thread that allocates it.
+ */
+struct MemoryPolicy
+{
+    bool huge_pages;
+    bool lock;
+    int  numa_node;
+
+    MemoryPolicy(): huge_pages(false), lock(false), numa_node(-1) { }
+
+    bool is_default() const { return !huge_pages && !lock && (numa_node < 0); }
+};
+
+/**
+ *  a block of frame memory, allocated according to a MemoryPolicy.
+ *  the memory is touched (zero-filled) by the allocating thread.
+ *  failures to apply any part of the policy are reported to std::cerr,
+ *  and the memory is allocated without it.
+ */
+class FrameMemory
+{
+private:
+    uint8_t *data_;
+    size_t   size_;   // as requested
+    size_t   mapped_; // as allocated (a multiple of the page size)
+    bool     huge_;
+    bool     locked_;
+
+    FrameMemory(const FrameMemory&);
+    FrameMemory& operator=(const FrameMemory&);
+public:
+    FrameMemory();
+    ~FrameMemory() { release(); }
+
+    /**
+     *  (re-)allocates `size` bytes.
+     *  @return false if no memory could be allocated at all.
+     */
+    bool allocate(const size_t& size, const MemoryPolicy& policy = MemoryPolicy());
+    void release();
+
+    uint8_t *data() const { return data_; }
+    size_t   size() const { return size_; }
+    bool     huge() const { return huge_; }
+    bool     locked() const { return locked_; }
+};
+
+#define MEMORY_UTILS_HPP_
+#endif
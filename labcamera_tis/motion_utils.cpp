@@ -0,0 +1,138 @@
+/*
+ *  MIT License
+ *
+ *  Copyright (c) 2021 Keisuke Sehara
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+*/
+#include "motion_utils.hpp"
+
+MotionEnergyStage::MotionEnergyStage(const size_t& capacity):
+    kernels_(nullptr),
+    previous_(nullptr),
+    capacity_((capacity > 0)? capacity : 1),
+    width_(1),
+    head_(0),
+    pending_(0),
+    dropped_(0) { }
+
+void MotionEnergyStage::add_region(const size_t& x, const size_t& y,
+                                   const size_t& width, const size_t& height)
+{
+    MotionRegion region = { x, y, width, height };
+    regions_.push_back(region);
+}
+
+bool MotionEnergyStage::configure(const FrameFormat& format)
+{
+    const size_t channels = format.bits_per_pixel / ((format.color == FormatY16)? 16 : 8);
+
+    // regions are converted to rows and values in memory, i.e. flipped for bottom-up frames
+    bounded_.clear();
+    for (const MotionRegion& region : regions_) {
+        MotionRegion bounded = { 0, 0, 0, 0 };
+        if ((region.x < format.width) && (region.y < format.height)) {
+            const size_t width  = std::min(region.width,  format.width  - region.x);
+            const size_t height = std::min(region.height, format.height - region.y);
+            bounded.x      = region.x * channels;
+            bounded.width  = width * channels;
+            bounded.y      = format.bottom_up? (format.height - region.y - height) : region.y;
+            bounded.height = height;
+        }
+        bounded_.push_back(bounded);
+    }
+
+    kernels_ = &pixel_kernels();
+    pool_.allocate(2, format.size);
+    previous_ = nullptr;
+    energy_.assign(1 + bounded_.size(), 0);
+
+    std::unique_lock<std::mutex> lock(io_);
+    width_   = 1 + bounded_.size();
+    sequences_.assign(capacity_, 0);
+    timestamps_.assign(capacity_, 0.0);
+    energies_.assign(capacity_ * width_, 0);
+    head_    = 0;
+    pending_ = 0;
+    dropped_ = 0;
+    return true;
+}
+
+void MotionEnergyStage::finish()
+{
+    if (previous_ != nullptr) {
+        pool_.release(previous_);
+        previous_ = nullptr;
+    }
+}
+
+void MotionEnergyStage::push_(const FrameView& frame)
+{
+    std::unique_lock<std::mutex> lock(io_);
+    if (pending_ == capacity_) {
+        head_ = (head_ + 1) % capacity_;
+        pending_--;
+        dropped_++;
+    }
+    const size_t index = (head_ + pending_) % capacity_;
+    sequences_[index]  = frame.sequence;
+    timestamps_[index] = frame.timestamp;
+    std::memcpy(energies_.data() + index * width_, energy_.data(), width_ * sizeof(uint64_t));
+    pending_++;
+}
+
+size_t MotionEnergyStage::read(uint64_t *sequences, double *timestamps,
+                               uint64_t *energies, const size_t& max_records)
+{
+    std::unique_lock<std::mutex> lock(io_);
+    const size_t count = std::min(pending_, max_records);
+    for (size_t i = 0; i < count; i++) {
+        const size_t index = (head_ + i) % capacity_;
+        if (sequences != nullptr) {
+            sequences[i] = sequences_[index];
+        }
+        if (timestamps != nullptr) {
+            timestamps[i] = timestamps_[index];
+        }
+        if (energies != nullptr) {
+            std::memcpy(energies + i * width_, energies_.data() + index * width_, width_ * sizeof(uint64_t));
+        }
+    }
+    head_     = (head_ + count) % capacity_;
+    pending_ -= count;
+    return count;
+}
+
+size_t MotionEnergyStage::columns()
+{
+    std::unique_lock<std::mutex> lock(io_);
+    return width_;
+}
+
+size_t MotionEnergyStage::pending()
+{
+    std::unique_lock<std::mutex> lock(io_);
+    return pending_;
+}
+
+uint64_t MotionEnergyStage::dropped()
+{
+    std::unique_lock<std::mutex> lock(io_);
+    return dropped_;
+}
@@ -0,0 +1,141 @@
+/*
+ *  MIT License
+ *
+ *  Copyright (c) 2021 Keisuke Sehara
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+*/
+#ifndef MOTION_UTILS_HPP_
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+#include <vector>
+#include "stage_utils.hpp"
+#include "simd_utils.hpp"
+#include "pool_utils.hpp"
+
+/**
+ *  a rectangle of a frame, in pixels from the top-left corner.
+ */
+struct MotionRegion
+{
+    size_t x;
+    size_t y;
+    size_t width;
+    size_t height;
+};
+
+/**
+ *  the motion energy of behavioral video: the sum of absolute differences (SAD)
+ *  from the previous frame, of the whole frame and of each region, over all
+ *  the color channels. the first frame of each acquisition has no record.
+ *
+ *  the previous frame is kept in a pool of two slots, so that the stage
+ *  does not allocate during the acquisition. the records are kept in a ring
+ *  of `capacity` frames until they are read; the oldest ones are overwritten
+ *  (and counted as dropped) if they are not read in time.
+ */
+class MotionEnergyStage: public FormatStage<MotionEnergyStage>
+{
+private:
+    std::vector<MotionRegion> regions_;  // as added
+    std::vector<MotionRegion> bounded_;  // clipped to the current format, in rows and values
+    const PixelKernels       *kernels_;
+    FramePool                 pool_;
+    FrameSlot                *previous_;
+    std::vector<uint64_t>     energy_;   // of the current frame
+
+    std::mutex                io_;       // guards the ring below
+    size_t                    capacity_;
+    size_t                    width_;    // # of values per record (1 + # of regions)
+    std::vector<uint64_t>     sequences_;
+    std::vector<double>       timestamps_;
+    std::vector<uint64_t>     energies_;
+    size_t                    head_;     // the oldest record
+    size_t                    pending_;
+    uint64_t                  dropped_;
+
+    /**
+     *  appends `energy_` to the ring.
+     */
+    void push_(const FrameView& frame);
+public:
+    MotionEnergyStage(const size_t& capacity = 4096);
+
+    /**
+     *  regions must be added while there is no acquisition.
+     */
+    void   add_region(const size_t& x, const size_t& y, const size_t& width, const size_t& height);
+    void   clear_regions() { regions_.clear(); }
+    size_t regions() const { return regions_.size(); }
+
+    bool configure(const FrameFormat& format);
+
+    template<class Traits>
+    void run(const FrameView& frame);
+
+    void finish() override;
+
+    const char *name() const override { return "MotionEnergyStage"; }
+
+    /**
+     *  moves up to `max_records` of the oldest records out of the ring.
+     *  `energies` receives columns() values per record: the whole frame first.
+     *  @return the number of records that have been read.
+     */
+    size_t read(uint64_t *sequences, double *timestamps, uint64_t *energies, const size_t& max_records);
+
+    /**
+     *  the # of values per record, as of the latest acquisition.
+     */
+    size_t   columns();
+    size_t   pending();
+    uint64_t dropped();
+};
+
+template<class Traits>
+void MotionEnergyStage::run(const FrameView& frame)
+{
+    if (previous_ != nullptr) {
+        const size_t  row_bytes = format_.row_bytes();
+        const uint8_t *previous = previous_->data;
+        uint64_t (*sad)(const uint8_t *, const uint8_t *, size_t, size_t, size_t) =
+            (Traits::bits == 8)? kernels_->sad8 : kernels_->sad16;
+
+        energy_[0] = sad(frame.data, previous, row_bytes, format_.width * Traits::channels, format_.height);
+        for (size_t i = 0; i < bounded_.size(); i++) {
+            const MotionRegion& region = bounded_[i];
+            const size_t offset = region.y * row_bytes + region.x * sizeof(typename Traits::value_type);
+            energy_[i + 1] = sad(frame.data + offset, previous + offset, row_bytes, region.width, region.height);
+        }
+        push_(frame);
+    }
+
+    FrameSlot *slot = pool_.acquire();
+    std::memcpy(slot->data, frame.data, (frame.size < slot->size)? frame.size : slot->size);
+    slot->sequence  = frame.sequence;
+    slot->timestamp = frame.timestamp;
+    if (previous_ != nullptr) {
+        pool_.release(previous_);
+    }
+    previous_ = slot;
+}
+
+#define MOTION_UTILS_HPP_
+#endif
@@ -0,0 +1,138 @@
+/*
+ *  MIT License
+ *
+ *  Copyright (c) 2021 Keisuke Sehara
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+*/
+#include "pipeline_utils.hpp"
+#include <iostream>
+
+bool prepare_crop(FrameCrop& crop, const FrameFormat& format, std::vector<uint8_t>& cropped)
+{
+    cropped.clear();
+    if (!crop.active()) {
+        return false;
+    }
+    if (!crop.prepare(format)) {
+        std::cerr << "***the crop region does not fit the frames; "
+                  << "frames are delivered as they are" << std::endl;
+        return false;
+    }
+    if (crop.bin() > 1) {
+        cropped.resize(crop.output().size);
+    }
+    return true;
+}
+
+static void delivery_context(FrameSlot *slot, void *pipeline) {
+    ((FramePipeline *)pipeline)->deliver(slot);
+}
+
+FramePipeline::FramePipeline(FrameCallback callback, void *user_data):
+    callback_(callback),
+    user_data_(user_data),
+    size_(0),
+    sequence_(0),
+    depth_(0),
+    dispatching_(false),
+    cropping_(false)
+{
+    delivery(DeliverAll, 0, 0.0);
+}
+
+void FramePipeline::delivery(const DeliveryPolicy& policy,
+                             const size_t& depth,
+                             const double& target_rate)
+{
+    depth_ = depth;
+    dispatcher_.configure(0, delivery_context, this, policy, depth, target_rate);
+}
+
+void FramePipeline::prepare(const FrameFormat& format)
+{
+    size_        = format.size;
+    sequence_    = 0;
+    dispatching_ = dispatcher_.active();
+    stages_.prepare(format);
+
+    cropping_ = prepare_crop(crop_, format, cropped_);
+}
+
+void FramePipeline::start()
+{
+    if (dispatching_) {
+        dispatcher_.start(cropping_? crop_.output().size : size_);
+    }
+}
+
+void FramePipeline::process(uint8_t *data, const double& timestamp)
+{
+    const uint64_t sequence = sequence_++;
+
+    FrameView view = { data, size_, sequence, timestamp };
+    stages_.process(view);
+    if (dispatching_) {
+        dispatcher_.dispatch(data, size_, sequence, timestamp,
+                             cropping_? &crop_ : nullptr);
+    }
+    if ((depth_ == 0) && (callback_ != nullptr)) {
+        if (cropping_ && (crop_.bin() > 1)) {
+            crop_.apply(data, cropped_.data());
+            callback_(cropped_.size(), cropped_.data(), sequence, timestamp, user_data_);
+        } else {
+            callback_(size_, data, sequence, timestamp, user_data_);
+        }
+    }
+}
+
+void FramePipeline::finish()
+{
+    stages_.finish();
+    if (dispatching_) {
+        dispatcher_.stop();
+    }
+
+    // mark end-of-acquisition
+    if (callback_ != nullptr) {
+        callback_(0, nullptr, sequence_, 0.0, user_data_);
+    }
+}
+
+void FramePipeline::report()
+{
+    for (size_t i = 0; i < dispatcher_.size(); i++) {
+        if (!dispatcher_.is_active(i)) {
+            continue;
+        }
+        DeliveryStats stats = dispatcher_.stats(i);
+        std::cerr << ">>> delivery stats (consumer #" << i << "): delivered " << stats.delivered
+                  << " of " << stats.received << " frames, overwritten " << stats.overwritten
+                  << ", decimated " << stats.decimated
+                  << ", stalled " << stats.stalled << " times" << std::endl;
+    }
+}
+
+void FramePipeline::deliver(FrameSlot *slot)
+{
+    // the end-of-acquisition is marked in finish()
+    if ((slot != nullptr) && (callback_ != nullptr)) {
+        callback_(slot->size, slot->data, slot->sequence, slot->timestamp, user_data_);
+    }
+}
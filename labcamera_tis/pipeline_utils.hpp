@@ -0,0 +1,137 @@
+/*
+ *  MIT License
+ *
+ *  Copyright (c) 2021 Keisuke Sehara
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+*/
+#ifndef PIPELINE_UTILS_HPP_
+#include <vector>
+#include "dispatch_utils.hpp"
+#include "stage_utils.hpp"
+#include "crop_utils.hpp"
+
+/**
+ *  receives a frame of `size` bytes at `data`, valid until it returns.
+ *  the end of an acquisition is marked by `size` == 0 and `data` == nullptr.
+ */
+typedef void (*FrameCallback)(size_t size, void *data, uint64_t sequence, double timestamp, void *user_data);
+
+/**
+ *  prepares `crop` for frames of `format`, sizing `cropped` for binned frames.
+ *  @return whether the frames are to be cropped.
+ */
+bool prepare_crop(FrameCrop& crop, const FrameFormat& format, std::vector<uint8_t>& cropped);
+
+/**
+ *  what happens to every frame after it has been received: the stages,
+ *  the crop, the hand-over to the consumers and the callback.
+ *  it is driven by the frame queue sink listener during acquisition,
+ *  and by ReplaySource for recorded frames.
+ */
+class FramePipeline
+{
+private:
+    const FrameCallback  callback_;
+          void          *user_data_;
+          size_t         size_;
+          uint64_t       sequence_;
+
+          size_t          depth_;       // 0 to run the callback directly on the calling thread
+          bool            dispatching_;
+          FrameDispatcher dispatcher_;  // consumer #0 runs the callback when depth_ > 0
+
+          StageChain           stages_;
+          FrameCrop            crop_;
+          bool                 cropping_;
+          std::vector<uint8_t> cropped_;  // binned frames for the callback on the calling thread
+public:
+    FramePipeline(FrameCallback callback, void *user_data);
+
+    /**
+     *  see DefaultFrameQueueSinkListener::delivery().
+     */
+    void delivery(const DeliveryPolicy& policy, const size_t& depth, const double& target_rate);
+    DeliveryStats delivery_stats() { return dispatcher_.stats(0); }
+
+    void add_stage(FrameStage *stage) { stages_.add(stage); }
+    void clear_stages() { stages_.clear(); }
+    void crop(const FrameCrop& crop) { crop_ = crop; }
+
+    size_t add_consumer(SlotCallback callback, void *user_data,
+                        const DeliveryPolicy& policy, const size_t& depth,
+                        const double& target_rate) {
+        return dispatcher_.add_consumer(callback, user_data, policy, depth, target_rate);
+    }
+    void clear_consumers() { dispatcher_.clear(1); }
+
+    void consumer_placement(const size_t& index, const ThreadPlacement& placement) {
+        dispatcher_.placement(index, placement);
+    }
+
+    /**
+     *  sets how the frame pool of the consumers is allocated.
+     */
+    void memory(const MemoryPolicy& policy) { dispatcher_.memory(policy); }
+
+    /**
+     *  lets up to `count` pooled frames be held at a time, e.g. by tensors
+     *  that share their memory. only the pooled frames (i.e. the ones
+     *  delivered on the consumer threads) can be held.
+     */
+    void       holds(const size_t& count) { dispatcher_.holds(count); }
+    FrameHold *hold(const uint8_t *data) { return dispatcher_.hold(data); }
+
+    size_t        consumers() const { return dispatcher_.size(); }
+    bool          is_active(const size_t& index) const { return dispatcher_.is_active(index); }
+    DeliveryStats consumer_stats(const size_t& index) { return dispatcher_.stats(index); }
+    const LatencyHistogram *consumer_latency(const size_t& index) const { return dispatcher_.latency(index); }
+
+    /**
+     *  prepares the stages and the crop for frames of `format`.
+     */
+    void prepare(const FrameFormat& format);
+
+    /**
+     *  starts the consumers. to be called from the thread that calls process(),
+     *  so that the frame pool is placed on its NUMA node.
+     */
+    void start();
+
+    /**
+     *  runs a frame through the pipeline. `data` is not used after returning.
+     */
+    void process(uint8_t *data, const double& timestamp);
+
+    /**
+     *  finishes the stages, lets the consumers drain their queues,
+     *  and marks the end of the acquisition to the callback.
+     */
+    void finish();
+
+    /**
+     *  writes the delivery statistics of the active consumers to std::cerr.
+     */
+    void report();
+
+    void deliver(FrameSlot *slot); // runs the callback on a pooled frame
+};
+
+#define PIPELINE_UTILS_HPP_
+#endif
@@ -0,0 +1,123 @@
+/*
+ *  MIT License
+ *
+ *  Copyright (c) 2021 Keisuke Sehara
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+*/
+#include "pixelstats_utils.hpp"
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+PixelStatsStage::PixelStatsStage():
+    values_(0),
+    height_(0),
+    channels_(0),
+    bottom_up_(false),
+    kernels_(nullptr),
+    count_(0),
+    reset_(false) { }
+
+bool PixelStatsStage::configure(const FrameFormat& format)
+{
+    std::unique_lock<std::mutex> lock(layout_);
+    channels_  = (format.color == FormatY16)? 1 : (format.bits_per_pixel / 8);
+    values_    = format.width * channels_;
+    height_    = format.height;
+    bottom_up_ = format.bottom_up;
+    kernels_   = &pixel_kernels();
+
+    const size_t total = values_ * height_;
+    rows_.assign(STRIPE_ROWS * values_, 0.0f);
+    reference_.assign(total, 0.0f);
+    sum_.assign(total, 0.0);
+    sum_sq_.assign(total, 0.0);
+    min_.assign(total, 0.0f);
+    max_.assign(total, 0.0f);
+    stripes_.clear();
+    for (size_t row = 0; row < height_; row += STRIPE_ROWS) {
+        stripes_.emplace_back(new Stripe());
+        stripes_.back()->count = 0;
+    }
+    count_ = 0;
+    reset_ = false;
+    return true;
+}
+
+void PixelStatsStage::update_rows_(Stripe& stripe, const size_t& first, const size_t& last, const bool& restart)
+{
+    const size_t offset = first * values_;
+    const size_t count  = (last - first) * values_;
+
+    std::unique_lock<std::mutex> lock(stripe.io);
+    if (restart) {
+        std::memcpy(reference_.data() + offset, rows_.data(), count * sizeof(float));
+        std::memcpy(min_.data() + offset, rows_.data(), count * sizeof(float));
+        std::memcpy(max_.data() + offset, rows_.data(), count * sizeof(float));
+        std::memset(sum_.data() + offset, 0, count * sizeof(double));
+        std::memset(sum_sq_.data() + offset, 0, count * sizeof(double));
+        stripe.count = 1;
+    } else {
+        kernels_->accumulate(rows_.data(), reference_.data() + offset,
+                             sum_.data() + offset, sum_sq_.data() + offset,
+                             min_.data() + offset, max_.data() + offset, count);
+        stripe.count++;
+    }
+}
+
+uint64_t PixelStatsStage::snapshot(double *mean, double *variance, double *minimum, double *maximum,
+                                   const size_t& capacity)
+{
+    std::unique_lock<std::mutex> layout(layout_);
+    if ((capacity != values_ * height_) || (count_.load(std::memory_order_relaxed) == 0)) {
+        return 0;
+    }
+
+    const double missing = std::numeric_limits<double>::quiet_NaN();
+    uint64_t fewest = std::numeric_limits<uint64_t>::max();
+    for (size_t i = 0; i < stripes_.size(); i++) {
+        Stripe& stripe = *(stripes_[i]);
+        const size_t first = i * STRIPE_ROWS;
+        const size_t last  = (first + STRIPE_ROWS < height_)? (first + STRIPE_ROWS) : height_;
+
+        std::unique_lock<std::mutex> lock(stripe.io);
+        const uint64_t n = stripe.count;
+        fewest = (n < fewest)? n : fewest;
+        for (size_t row = first; row < last; row++) {
+            const size_t src = row * values_;
+            const size_t dst = (bottom_up_? (height_ - 1 - row) : row) * values_;
+            for (size_t j = 0; j < values_; j++) {
+                const double sum = sum_[src + j];
+                if (n == 0) {
+                    mean[dst + j]     = missing;
+                    variance[dst + j] = missing;
+                    minimum[dst + j]  = missing;
+                    maximum[dst + j]  = missing;
+                    continue;
+                }
+                mean[dst + j]     = reference_[src + j] + sum / n;
+                variance[dst + j] = (n > 1)? std::fmax((sum_sq_[src + j] - sum * sum / n) / (n - 1), 0.0) : 0.0;
+                minimum[dst + j]  = min_[src + j];
+                maximum[dst + j]  = max_[src + j];
+            }
+        }
+    }
+    return fewest;
+}
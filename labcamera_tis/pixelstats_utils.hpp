@@ -0,0 +1,140 @@
+/*
+ *  MIT License
+ *
+ *  Copyright (c) 2021 Keisuke Sehara
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+*/
+#ifndef PIXELSTATS_UTILS_HPP_
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "stage_utils.hpp"
+#include "simd_utils.hpp"
+
+/**
+ *  keeps the running mean, variance and extrema of every value of the frames
+ *  (i.e. of each channel of each pixel), in constant memory.
+ *
+ *  the sums are of the differences from the first frame, which keeps them
+ *  exact in double precision for about two million frames of 16-bit values.
+ *  the planes are updated in stripes of rows, each under its own lock,
+ *  so that snapshot() can be called during acquisition: the dequeue thread
+ *  only waits for the stripe being copied, if any.
+ */
+class PixelStatsStage: public FormatStage<PixelStatsStage>
+{
+private:
+    struct Stripe
+    {
+        std::mutex io;
+        uint64_t   count; // # of frames in the rows of this stripe
+    };
+
+    std::mutex          layout_;     // held while the planes are (re-)allocated or read
+    size_t              values_;     // per row
+    size_t              height_;
+    size_t              channels_;
+    bool                bottom_up_;
+    const PixelKernels *kernels_;
+
+    std::vector<float>  rows_;       // the values of the current stripe
+    std::vector<float>  reference_;  // the first frame
+    std::vector<double> sum_;
+    std::vector<double> sum_sq_;
+    std::vector<float>  min_;
+    std::vector<float>  max_;
+    std::vector<std::unique_ptr<Stripe>> stripes_;
+
+    std::atomic<uint64_t> count_;
+    std::atomic<bool>     reset_;
+
+    /**
+     *  adds `rows_` to rows [first, last) of the planes.
+     */
+    void update_rows_(Stripe& stripe, const size_t& first, const size_t& last, const bool& restart);
+public:
+    static const size_t STRIPE_ROWS = 16;
+
+    PixelStatsStage();
+
+    bool configure(const FrameFormat& format);
+
+    template<class Traits>
+    void run(const FrameView& frame);
+
+    const char *name() const override { return "PixelStatsStage"; }
+
+    /**
+     *  starts over from the next frame.
+     */
+    void reset() { reset_ = true; }
+
+    /**
+     *  the number of frames accumulated so far.
+     */
+    uint64_t count() const { return count_.load(std::memory_order_relaxed); }
+
+    size_t width() const { return (channels_ > 0)? (values_ / channels_) : 0; }
+    size_t height() const { return height_; }
+    size_t channels() const { return channels_; }
+
+    /**
+     *  copies the statistics so far into arrays of `capacity` (= width x height x channels)
+     *  values each, with the rows in top-down order. the variance is unbiased, and values
+     *  that have not been observed yet are NaN. a stripe may include one frame more
+     *  than the others while the acquisition is running.
+     *
+     *  @return the number of frames in the stripe with the fewest of them,
+     *          or 0 (without copying) if nothing has been accumulated,
+     *          or if `capacity` does not match the current frame format.
+     */
+    uint64_t snapshot(double *mean, double *variance, double *minimum, double *maximum,
+                      const size_t& capacity);
+};
+
+template<class Traits>
+void PixelStatsStage::run(const FrameView& frame)
+{
+    const bool   restart   = reset_.exchange(false) || (count_.load(std::memory_order_relaxed) == 0);
+    const size_t row_bytes = format_.row_bytes();
+    for (size_t i = 0; i < stripes_.size(); i++) {
+        const size_t first = i * STRIPE_ROWS;
+        const size_t last  = (first + STRIPE_ROWS < height_)? (first + STRIPE_ROWS) : height_;
+        // unpacked outside the lock of the stripe
+        for (size_t row = first; row < last; row++) {
+            float *values = rows_.data() + (row - first) * values_;
+            if (Traits::bits == 16) {
+                kernels_->unpack16(frame.data + row * row_bytes, values, values_);
+            } else {
+                kernels_->unpack8(frame.data + row * row_bytes, values, values_);
+            }
+        }
+        update_rows_(*(stripes_[i]), first, last, restart);
+    }
+    if (restart) {
+        count_.store(1, std::memory_order_relaxed);
+    } else {
+        count_.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+#define PIXELSTATS_UTILS_HPP_
+#endif
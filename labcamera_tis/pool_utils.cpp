@@ -0,0 +1,210 @@
+/*
+ *  MIT License
+ *
+ *  Copyright (c) 2021 Keisuke Sehara
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+*/
+#include "pool_utils.hpp"
+#include <chrono>
+#include <new>
+
+double monotonic_seconds()
+{
+    using namespace std::chrono;
+    return duration_cast<duration<double>>(steady_clock::now().time_since_epoch()).count();
+}
+
+FramePool::FramePool():
+    stride_(0),
+    generation_(0),
+    max_holds_(0),
+    holds_(0) { }
+
+void FramePool::allocate(const size_t& count, const size_t& size)
+{
+    std::unique_lock<std::mutex> lock(io_);
+    if (!storage_ || (storage_.use_count() > 1)) {
+        // the old memory is left to the holds that still refer to it
+        storage_ = std::make_shared<FrameMemory>();
+    }
+    // slots start at cache-line boundaries, for the pixel kernels
+    const size_t total = count + max_holds_;
+    stride_ = ((size + 63) / 64) * 64;
+    if (!storage_->allocate(total * stride_, policy_)) {
+        throw std::bad_alloc();
+    }
+    generation_++;
+    holds_ = 0;
+    slots_.resize(total);
+    free_.clear();
+    for (size_t i = 0; i < total; i++) {
+        FrameSlot& slot = slots_[i];
+        slot.data      = storage_->data() + i * stride_;
+        slot.size      = size;
+        slot.sequence  = 0;
+        slot.timestamp = 0.0;
+        slot.refs      = 0;
+        free_.push_back(&slot);
+    }
+}
+
+FrameSlot *FramePool::acquire(const size_t& refs)
+{
+    std::unique_lock<std::mutex> lock(io_);
+    released_.wait(lock, [this]{ return !free_.empty(); });
+    FrameSlot *slot = free_.back();
+    free_.pop_back();
+    slot->refs = refs;
+    return slot;
+}
+
+void FramePool::release(FrameSlot *slot)
+{
+    std::unique_lock<std::mutex> lock(io_);
+    if (--(slot->refs) == 0) {
+        free_.push_back(slot);
+        released_.notify_one();
+    }
+}
+
+FrameHold *FramePool::hold(const uint8_t *data)
+{
+    std::unique_lock<std::mutex> lock(io_);
+    if (!storage_ || (stride_ == 0) || (holds_ >= max_holds_)) {
+        return nullptr;
+    }
+    const uint8_t *base = storage_->data();
+    if ((data < base) || (data >= base + slots_.size() * stride_)) {
+        return nullptr;
+    }
+    FrameSlot *slot = &(slots_[(size_t)(data - base) / stride_]);
+    if ((slot->data != data) || (slot->refs == 0)) {
+        return nullptr;
+    }
+    slot->refs++;
+    holds_++;
+    return new FrameHold(this, slot, generation_, storage_);
+}
+
+void FramePool::unhold_(FrameSlot *slot, const uint64_t& generation)
+{
+    std::unique_lock<std::mutex> lock(io_);
+    if (generation != generation_) {
+        return; // the slot has gone with the old generation
+    }
+    holds_--;
+    if (--(slot->refs) == 0) {
+        free_.push_back(slot);
+        released_.notify_one();
+    }
+}
+
+FrameQueue::FrameQueue(FramePool *pool):
+    pool_(pool),
+    policy_(DeliverAll),
+    capacity_(1),
+    period_(0.0),
+    next_due_(0.0),
+    closed_(false),
+    stats_() { }
+
+void FrameQueue::configure(const DeliveryPolicy& policy,
+                           const size_t& capacity,
+                           const double& target_rate)
+{
+    std::unique_lock<std::mutex> lock(io_);
+    policy_   = policy;
+    capacity_ = (capacity > 0)? capacity : 1;
+    period_   = (target_rate > 0.0)? (1.0 / target_rate) : 0.0;
+}
+
+void FrameQueue::reset()
+{
+    std::unique_lock<std::mutex> lock(io_);
+    pending_.clear();
+    closed_   = false;
+    next_due_ = 0.0;
+    stats_    = DeliveryStats();
+}
+
+bool FrameQueue::accepts(const double& timestamp)
+{
+    std::unique_lock<std::mutex> lock(io_);
+    stats_.received++;
+    if (period_ <= 0.0) {
+        return true;
+    }
+    if (timestamp < next_due_) {
+        stats_.decimated++;
+        return false;
+    }
+    // keep to the schedule, but do not try to catch up after a gap
+    next_due_ += period_;
+    if (next_due_ <= timestamp) {
+        next_due_ = timestamp + period_;
+    }
+    return true;
+}
+
+void FrameQueue::push(FrameSlot *slot)
+{
+    std::unique_lock<std::mutex> lock(io_);
+    if (pending_.size() >= capacity_) {
+        if (policy_ == DeliverAll) {
+            stats_.stalled++;
+            popped_.wait(lock, [this]{ return closed_ || (pending_.size() < capacity_); });
+        } else {
+            FrameSlot *oldest = pending_.front();
+            pending_.pop_front();
+            stats_.overwritten++;
+            pool_->release(oldest);
+        }
+    }
+    pending_.push_back(slot);
+    pushed_.notify_one();
+}
+
+FrameSlot *FrameQueue::pop()
+{
+    std::unique_lock<std::mutex> lock(io_);
+    pushed_.wait(lock, [this]{ return closed_ || !pending_.empty(); });
+    if (pending_.empty()) {
+        return nullptr;
+    }
+    FrameSlot *slot = pending_.front();
+    pending_.pop_front();
+    stats_.delivered++;
+    popped_.notify_one();
+    return slot;
+}
+
+void FrameQueue::close()
+{
+    std::unique_lock<std::mutex> lock(io_);
+    closed_ = true;
+    pushed_.notify_all();
+    popped_.notify_all();
+}
+
+DeliveryStats FrameQueue::stats()
+{
+    std::unique_lock<std::mutex> lock(io_);
+    return stats_;
+}
@@ -0,0 +1,218 @@
+/*
+ *  MIT License
+ *
+ *  Copyright (c) 2021 Keisuke Sehara
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+*/
+#ifndef POOL_UTILS_HPP_
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include "memory_utils.hpp"
+
+/**
+ *  returns the current time of the steady clock, in seconds.
+ */
+double monotonic_seconds();
+
+/**
+ *  a frame that has been copied out of the sink into a FramePool.
+ */
+struct FrameSlot
+{
+    uint8_t  *data;
+    size_t    size;
+    uint64_t  sequence;
+    double    timestamp; // monotonic_seconds() at reception
+    size_t    refs;      // # of consumers still holding this slot (guarded by the pool)
+};
+
+/**
+ *  what to do when the consumer cannot keep up with the acquisition.
+ */
+enum DeliveryPolicy
+{
+    DeliverAll       = 0, // keep everything; the dequeue thread waits for the consumer
+    DeliverLatest    = 1, // discard the oldest pending frame in favor of the newest one
+    DeliverDecimated = 2, // DeliverLatest at a fixed `target_rate`, which must be set
+};
+
+struct DeliveryStats
+{
+    uint64_t received;    // frames offered to the queue
+    uint64_t delivered;   // frames handed to the consumer
+    uint64_t overwritten; // dropped by DeliverLatest/DeliverDecimated because the queue was full
+    uint64_t decimated;   // dropped to meet the target rate
+    uint64_t stalled;     // times DeliverAll had to wait for the consumer
+};
+
+class FrameHold;
+
+/**
+ *  a fixed set of frame buffers that are allocated once per acquisition.
+ *  a slot may be shared by several consumers, and returns to the pool
+ *  when the last of them releases it.
+ */
+class FramePool
+{
+private:
+    std::shared_ptr<FrameMemory> storage_; // shared with the holds
+    MemoryPolicy            policy_;
+    size_t                  stride_;
+    uint64_t                generation_;   // bumped by every allocate()
+    size_t                  max_holds_;
+    size_t                  holds_;        // of this generation
+    std::vector<FrameSlot>  slots_;
+    std::vector<FrameSlot*> free_;
+    std::mutex              io_;
+    std::condition_variable released_;
+
+    friend class FrameHold;
+    void unhold_(FrameSlot *slot, const uint64_t& generation);
+public:
+    FramePool();
+
+    /**
+     *  sets how the slots are allocated from the next allocate() on.
+     */
+    void memory(const MemoryPolicy& policy) { policy_ = policy; }
+
+    /**
+     *  sets the number of slots that may be held at a time (see hold()).
+     *  as many slots are added to the pool from the next allocate() on,
+     *  so that the holds never starve the consumers.
+     */
+    void holds(const size_t& count) { max_holds_ = count; }
+
+    /**
+     *  (re-)allocates `count` slots of `size` bytes each (plus the ones for the holds).
+     *  must not be called while any slot is in use, other than by holds.
+     */
+    void allocate(const size_t& count, const size_t& size);
+
+    /**
+     *  @return a free slot held `refs` times, waiting for one
+     *          to be released if necessary.
+     */
+    FrameSlot *acquire(const size_t& refs = 1);
+
+    void       release(FrameSlot *slot);
+
+    /**
+     *  keeps the slot that `data` points to out of the pool, until the returned
+     *  hold is deleted. the slot must be in use by the caller.
+     *  @return nullptr if `data` is not in the pool, or all holds are in use.
+     */
+    FrameHold *hold(const uint8_t *data);
+
+    size_t count() const { return slots_.size(); }
+    size_t index(const FrameSlot *slot) const { return (size_t)(slot - slots_.data()); }
+};
+
+/**
+ *  a pooled frame that is kept out of the pool, e.g. while it is exported
+ *  to another library (see FramePool::hold()). the memory stays valid even
+ *  if the pool is re-allocated in the meantime, but the pool itself
+ *  must outlive the hold.
+ */
+class FrameHold
+{
+private:
+    FramePool                   *pool_;
+    FrameSlot                   *slot_;
+    uint8_t                     *data_;
+    uint64_t                     generation_;
+    std::shared_ptr<FrameMemory> storage_;
+
+    FrameHold(const FrameHold&);
+    FrameHold& operator=(const FrameHold&);
+public:
+    FrameHold(FramePool *pool, FrameSlot *slot, const uint64_t& generation,
+              const std::shared_ptr<FrameMemory>& storage):
+        pool_(pool), slot_(slot), data_(slot->data), generation_(generation), storage_(storage) { }
+    ~FrameHold() { pool_->unhold_(slot_, generation_); }
+
+    uint8_t *data() const { return data_; }
+};
+
+/**
+ *  a bounded FIFO of pooled frames that applies a DeliveryPolicy
+ *  between the producer (the dequeue thread) and a single consumer.
+ */
+class FrameQueue
+{
+private:
+    FramePool               *pool_;
+    DeliveryPolicy           policy_;
+    size_t                   capacity_;
+    double                   period_;
+    double                   next_due_;
+
+    std::deque<FrameSlot*>   pending_;
+    std::mutex               io_;
+    std::condition_variable  pushed_;
+    std::condition_variable  popped_;
+    bool                     closed_;
+    DeliveryStats            stats_;
+public:
+    FrameQueue(FramePool *pool);
+
+    void configure(const DeliveryPolicy& policy,
+                   const size_t& capacity,
+                   const double& target_rate);
+
+    /**
+     *  resets the statistics and re-opens the queue for a new acquisition.
+     */
+    void reset();
+
+    /**
+     *  @return whether a frame received at `timestamp` is to be pushed
+     *          (always true unless a target rate is set).
+     */
+    bool accepts(const double& timestamp);
+
+    /**
+     *  enqueues `slot` according to the policy. slots that are dropped
+     *  are returned to the pool.
+     */
+    void push(FrameSlot *slot);
+
+    /**
+     *  waits for the next frame.
+     *  @return nullptr once the queue is closed and empty.
+     */
+    FrameSlot *pop();
+
+    /**
+     *  marks the end of the acquisition; pop() drains the remaining frames.
+     */
+    void close();
+
+    DeliveryStats stats();
+    DeliveryPolicy policy() const { return policy_; }
+};
+
+#define POOL_UTILS_HPP_
+#endif
@@ -0,0 +1,115 @@
+/*
+ *  MIT License
+ *
+ *  Copyright (c) 2021 Keisuke Sehara
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+*/
+#include "preview_utils.hpp"
+#include <algorithm>
+#include <cstring>
+
+PreviewStage::PreviewStage(const size_t& factor, const double& rate):
+    factor_((factor > 0)? factor : 1),
+    period_((rate > 0.0)? (1.0 / rate) : 0.0),
+    next_due_(0.0),
+    width_(0),
+    height_(0),
+    colors_(1),
+    info_(),
+    low_(0.0),
+    high_(65535.0) { }
+
+void PreviewStage::window(const double& low, const double& high)
+{
+    std::unique_lock<std::mutex> lock(io_);
+    low_  = low;
+    high_ = high;
+}
+
+bool PreviewStage::configure(const FrameFormat& format)
+{
+    const size_t channels = (format.color == FormatY16)? 1 : (format.bits_per_pixel / 8);
+    colors_   = (channels == 4)? 3 : channels;
+    width_    = format.width  / factor_;
+    height_   = format.height / factor_;
+    next_due_ = 0.0;
+    lines_.assign(width_ * factor_ * channels, 0);
+    sums_.assign(width_ * colors_, 0);
+    back_.assign(width_ * height_ * colors_, 0);
+
+    std::unique_lock<std::mutex> lock(io_);
+    front_.assign(back_.size(), 0);
+    info_          = PreviewInfo();
+    info_.width    = width_;
+    info_.height   = height_;
+    info_.channels = colors_;
+    return true;
+}
+
+bool PreviewStage::due_(const double& timestamp)
+{
+    if (period_ <= 0.0) {
+        return true;
+    }
+    if (timestamp < next_due_) {
+        return false;
+    }
+    // keep to the schedule, but do not try to catch up after a gap
+    next_due_ += period_;
+    if (next_due_ <= timestamp) {
+        next_due_ = timestamp + period_;
+    }
+    return true;
+}
+
+void PreviewStage::store_row_(const size_t& row, const uint32_t *sums, const bool& wide,
+                              const double& low, const double& scale)
+{
+    const size_t values = width_ * colors_;
+    uint8_t     *out    = back_.data() + row * values;
+    // multiplications and integer clamps rather than divisions and branches,
+    // so that the loop vectorizes
+    const float  block  = (float)(factor_ * factor_);
+    const float  gain   = wide? (float)(scale / block) : (1.0f / block);
+    const float  offset = wide? (float)(low * scale) : 0.0f;
+    for (size_t i = 0; i < values; i++) {
+        int32_t value = (int32_t)((float)(int32_t)sums[i] * gain - offset + 0.5f);
+        value  = (value < 0)? 0 : value;
+        out[i] = (uint8_t)((value > 255)? 255 : value);
+    }
+}
+
+void PreviewStage::publish_(const FrameView& frame)
+{
+    std::unique_lock<std::mutex> lock(io_);
+    front_.swap(back_);
+    info_.sequence  = frame.sequence;
+    info_.timestamp = frame.timestamp;
+    info_.count++;
+}
+
+PreviewInfo PreviewStage::latest(uint8_t *image, const size_t& capacity)
+{
+    std::unique_lock<std::mutex> lock(io_);
+    if ((image != nullptr) && (front_.size() <= capacity)) {
+        std::memcpy(image, front_.data(), front_.size());
+    }
+    return info_;
+}
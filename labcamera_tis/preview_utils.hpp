@@ -0,0 +1,158 @@
+/*
+ *  MIT License
+ *
+ *  Copyright (c) 2021 Keisuke Sehara
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+*/
+#ifndef PREVIEW_UTILS_HPP_
+#include <algorithm>
+#include <mutex>
+#include <vector>
+#include "stage_utils.hpp"
+
+/**
+ *  describes the preview that has been published last.
+ */
+struct PreviewInfo
+{
+    uint64_t sequence;  // of the frame
+    double   timestamp;
+    uint64_t count;     // # of previews published in this acquisition
+    size_t   width;
+    size_t   height;
+    size_t   channels;  // 1 for grayscale, 3 for color (in the channel order of the frames)
+};
+
+/**
+ *  a small 8-bit copy of the frames for the GUIs: every `factor` x `factor`
+ *  block of pixels is averaged, and frames are decimated to `rate` (in Hz; 0 to keep all).
+ *  Y16 values are mapped to 8 bits through a window, and the alpha channel
+ *  of RGB32 is dropped. the preview is always top-down.
+ *
+ *  frames that are not due cost nothing but a comparison. the preview is written
+ *  into a back buffer, and swapped with the front buffer once it is complete.
+ */
+class PreviewStage: public FormatStage<PreviewStage>
+{
+private:
+    size_t                factor_;
+    double                period_;
+    double                next_due_;
+    size_t                width_;    // of the preview
+    size_t                height_;
+    size_t                colors_;
+    std::vector<uint32_t> lines_;    // the sums of the rows of a row of blocks
+    std::vector<uint32_t> sums_;     // of a row of blocks
+    std::vector<uint8_t>  back_;
+
+    std::mutex            io_;       // guards the members below
+    std::vector<uint8_t>  front_;
+    PreviewInfo           info_;
+    double                low_;
+    double                high_;
+
+    /**
+     *  @return whether a preview is to be made out of the frame received at `timestamp`.
+     */
+    bool due_(const double& timestamp);
+
+    /**
+     *  maps the sums of a row of blocks to a row of the back buffer.
+     */
+    void store_row_(const size_t& row, const uint32_t *sums, const bool& wide,
+                    const double& low, const double& scale);
+    void publish_(const FrameView& frame);
+public:
+    PreviewStage(const size_t& factor = 1, const double& rate = 0.0);
+
+    /**
+     *  maps Y16 values from `low` to `high` onto 0-255. can be changed at any time.
+     */
+    void window(const double& low, const double& high);
+
+    bool configure(const FrameFormat& format);
+
+    template<class Traits>
+    void run(const FrameView& frame);
+
+    const char *name() const override { return "PreviewStage"; }
+
+    /**
+     *  copies the latest preview into `image` (of `capacity` bytes) if it fits.
+     *  `count` is 0 if there is no preview yet.
+     */
+    PreviewInfo latest(uint8_t *image = nullptr, const size_t& capacity = 0);
+};
+
+template<class Traits>
+void PreviewStage::run(const FrameView& frame)
+{
+    if ((width_ == 0) || (height_ == 0) || !due_(frame.timestamp)) {
+        return;
+    }
+    double low, scale;
+    {
+        std::unique_lock<std::mutex> lock(io_);
+        low   = low_;
+        scale = (high_ > low_)? (255.0 / (high_ - low_)) : 0.0;
+    }
+
+    // the alpha channel of RGB32 is dropped
+    const size_t colors    = (Traits::channels == 4)? 3 : Traits::channels;
+    const size_t factor    = factor_;
+    const size_t row_bytes = format_.row_bytes();
+    const size_t values    = width_ * factor * Traits::channels;
+    for (size_t row = 0; row < height_; row++) {
+        // the rows of the blocks are added up first, which vectorizes
+        uint32_t *lines = lines_.data();
+        std::fill(lines, lines + values, 0);
+        for (size_t k = 0; k < factor; k++) {
+            const size_t line = row * factor + k;
+            const size_t src  = format_.bottom_up? (format_.height - 1 - line) : line;
+            const typename Traits::value_type *in =
+                (const typename Traits::value_type *)(frame.data + src * row_bytes);
+            for (size_t i = 0; i < values; i++) {
+                lines[i] += in[i];
+            }
+        }
+
+        // without binning, the sums of the rows are those of the blocks
+        const uint32_t *sums = lines_.data();
+        if ((factor > 1) || (colors != Traits::channels)) {
+            uint32_t *sum = sums_.data();
+            for (size_t x = 0; x < width_; x++, sum += colors) {
+                for (size_t c = 0; c < colors; c++) {
+                    sum[c] = 0;
+                }
+                for (size_t j = 0; j < factor; j++, lines += Traits::channels) {
+                    for (size_t c = 0; c < colors; c++) {
+                        sum[c] += lines[c];
+                    }
+                }
+            }
+            sums = sums_.data();
+        }
+        store_row_(row, sums, (Traits::bits == 16), low, scale);
+    }
+    publish_(frame);
+}
+
+#define PREVIEW_UTILS_HPP_
+#endif
@@ -99,3 +99,27 @@ std::vector<std::string> getStringOptions(MapStringsInterfacePtr& option) {
 void setCurrentString(MapStringsInterfacePtr& option, const std::string& newval) {
     option->setString(newval);
 }
+
+PropertyExposureActuator::PropertyExposureActuator(AbsoluteValueInterfacePtr& exposure,
+                                                   AbsoluteValueInterfacePtr& gain):
+    exposure_(exposure), gain_(gain) { }
+
+ExposureSettings PropertyExposureActuator::read()
+{
+    ExposureSettings settings;
+    settings.exposure = (exposure_ != nullptr)? getAbsoluteValue(exposure_) : 0.0;
+    settings.gain     = (gain_ != nullptr)? getAbsoluteValue(gain_) : 0.0;
+    return settings;
+}
+
+void PropertyExposureActuator::write(const ExposureSettings& settings)
+{
+    if (exposure_ != nullptr) {
+        double exposure = settings.exposure;
+        setAbsoluteValue(exposure_, exposure);
+    }
+    if (gain_ != nullptr) {
+        double gain = settings.gain;
+        setAbsoluteValue(gain_, gain);
+    }
+}
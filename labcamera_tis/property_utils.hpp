@@ -24,6 +24,7 @@
 
 #ifndef PROPERTY_UTILS_HPP_
 #include <tisudshl.h>
+#include "histogram_utils.hpp"
 
 typedef smart_com<DShowLib::IVCDPropertyItems>     COMPropertyItemsPtr;
 typedef smart_com<DShowLib::IVCDPropertyItem>      COMPropertyItemPtr;
@@ -78,5 +79,22 @@ getStringOptions(MapStringsInterfacePtr& option);
 void
 setCurrentString(MapStringsInterfacePtr& option, const std::string& newval);
 
+/**
+ *  writes the exposure (and the gain) through the 'AbsoluteValue' interfaces
+ *  of 'Exposure/Value' (and 'Gain/Value') resolved beforehand.
+ *  either is left as it is if its interface is null.
+ */
+class PropertyExposureActuator: public ExposureActuator
+{
+private:
+    AbsoluteValueInterfacePtr exposure_;
+    AbsoluteValueInterfacePtr gain_;
+public:
+    PropertyExposureActuator(AbsoluteValueInterfacePtr& exposure, AbsoluteValueInterfacePtr& gain);
+
+    ExposureSettings read() override;
+    void write(const ExposureSettings& settings) override;
+};
+
 #define PROPERTY_UTILS_HPP_
 #endif
@@ -0,0 +1,191 @@
+/*
+ *  MIT License
+ *
+ *  Copyright (c) 2021 Keisuke Sehara
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+*/
+#include "replay_utils.hpp"
+#include <iostream>
+#include <sstream>
+#include "thread_utils.hpp"
+
+ReplaySource::ReplaySource():
+    format_(), preloaded_(false), cancel_(false) { }
+
+bool ReplaySource::open(const std::string& path, const FrameFormat& format,
+                        const std::string& index, const bool& preload)
+{
+    offsets_.clear();
+    timestamps_.clear();
+    frame_.clear();
+    preloaded_ = false;
+    if (file_.is_open()) {
+        file_.close();
+    }
+    file_.clear();
+
+    if (format.size == 0) {
+        std::cerr << "***invalid frame size for replay" << std::endl;
+        return false;
+    }
+    file_.open(path, std::ios::in | std::ios::binary);
+    if (!file_.is_open()) {
+        std::cerr << "***failed to open the recording: " << path << std::endl;
+        return false;
+    }
+    file_.seekg(0, std::ios::end);
+    const uint64_t file_size = (uint64_t)file_.tellg();
+    format_ = format;
+
+    if (!index.empty()) {
+        if (!read_index_(index, file_size)) {
+            return false;
+        }
+    } else {
+        const uint64_t count = file_size / format.size;
+        if (count * format.size != file_size) {
+            std::cerr << "***the recording does not end at a frame boundary; "
+                      << "the last " << (file_size - count * format.size)
+                      << " bytes are ignored" << std::endl;
+        }
+        offsets_.resize(count);
+        for (uint64_t i = 0; i < count; i++) {
+            offsets_[i] = i * format.size;
+        }
+    }
+
+    if (preload) {
+        frame_.resize(offsets_.size() * format.size);
+        for (size_t i = 0; i < offsets_.size(); i++) {
+            file_.seekg((std::streamoff)offsets_[i]);
+            if (!file_.read((char *)frame_.data() + i * format.size, format.size)) {
+                std::cerr << "***failed to read frame #" << i << " of the recording" << std::endl;
+                return false;
+            }
+        }
+        preloaded_ = true;
+    } else {
+        frame_.resize(format.size);
+    }
+    return true;
+}
+
+bool ReplaySource::read_index_(const std::string& path, const uint64_t& file_size)
+{
+    std::ifstream in(path);
+    if (!in.is_open()) {
+        std::cerr << "***failed to open the index: " << path << std::endl;
+        return false;
+    }
+    std::string line;
+    size_t      number = 0;
+    while (std::getline(in, line)) {
+        number++;
+        const size_t start = line.find_first_not_of(" \t\r");
+        if ((start == std::string::npos) || (line[start] == '#')) {
+            continue;
+        }
+        std::istringstream fields(line);
+        uint64_t offset;
+        double   timestamp;
+        if (!(fields >> offset >> timestamp)) {
+            std::cerr << "***invalid index entry at line " << number << ": " << line << std::endl;
+            return false;
+        }
+        if (offset + format_.size > file_size) {
+            std::cerr << "***the index refers beyond the end of the recording at line "
+                      << number << std::endl;
+            return false;
+        }
+        offsets_.push_back(offset);
+        timestamps_.push_back(timestamp);
+    }
+    return true;
+}
+
+uint8_t *ReplaySource::load_(const size_t& index)
+{
+    if (preloaded_) {
+        return frame_.data() + index * format_.size;
+    }
+    file_.seekg((std::streamoff)offsets_[index]);
+    if (!file_.read((char *)frame_.data(), format_.size)) {
+        file_.clear();
+        return nullptr;
+    }
+    return frame_.data();
+}
+
+ReplayStats ReplaySource::run(FramePipeline& pipeline, const ReplayTiming& timing,
+                              const double& rate, const size_t& loops)
+{
+    ReplayStats stats = { 0, 0.0, 0.0 };
+    const size_t count = offsets_.size();
+
+    bool   paced    = (timing != ReplayFastest);
+    bool   original = (timing == ReplayOriginal) && indexed();
+    double period   = (rate > 0.0)? (1.0 / rate) : 0.0;
+    if (paced && !original && (period <= 0.0)) {
+        std::cerr << "***no rate to replay at; replaying as fast as possible" << std::endl;
+        paced = false;
+    }
+    // the schedule continues across loops at the mean interval of the recording
+    double span = period * count;
+    if (original) {
+        const double recorded = timestamps_.back() - timestamps_.front();
+        span = recorded + ((count > 1)? (recorded / (count - 1)) : 0.0);
+    }
+
+    cancel_ = false;
+    pipeline.prepare(format_);
+    pipeline.start();
+
+    const double start = monotonic_seconds();
+    for (size_t loop = 0; (loop < loops) && !cancel_; loop++) {
+        for (size_t i = 0; (i < count) && !cancel_; i++) {
+            uint8_t *data = load_(i);
+            if (data == nullptr) {
+                std::cerr << "***failed to read frame #" << i << " of the recording" << std::endl;
+                cancel_ = true;
+                break;
+            }
+
+            double timestamp;
+            if (paced) {
+                const double offset = original? (timestamps_[i] - timestamps_.front())
+                                              : (period * i);
+                timestamp = start + span * loop + offset;
+                wait_until(timestamp);
+                const double lag = monotonic_seconds() - timestamp;
+                if (lag > stats.max_lag) {
+                    stats.max_lag = lag;
+                }
+            } else {
+                timestamp = monotonic_seconds();
+            }
+            pipeline.process(data, timestamp);
+            stats.frames++;
+        }
+    }
+
+    pipeline.finish();
+    stats.elapsed = monotonic_seconds() - start;
+    return stats;
+}
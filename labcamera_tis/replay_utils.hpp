@@ -0,0 +1,104 @@
+/*
+ *  MIT License
+ *
+ *  Copyright (c) 2021 Keisuke Sehara
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+*/
+#ifndef REPLAY_UTILS_HPP_
+#include <atomic>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "pipeline_utils.hpp"
+
+/**
+ *  how the frames of a recording are paced during replay.
+ */
+enum ReplayTiming
+{
+    ReplayOriginal  = 0, // at the recorded intervals (requires an index)
+    ReplayFixedRate = 1, // at `rate` frames per second
+    ReplayFastest   = 2, // as fast as the pipeline accepts them
+};
+
+struct ReplayStats
+{
+    uint64_t frames;   // frames run through the pipeline
+    double   elapsed;  // in seconds, from the first frame to the end of finish()
+    double   max_lag;  // the largest delay of a frame behind its schedule, in seconds
+};
+
+/**
+ *  reads the frames of a recording, and runs them through a FramePipeline
+ *  in the same way as the frame queue sink listener does during acquisition,
+ *  so that the stages and the consumers can be exercised without a camera.
+ *
+ *  a raw recording consists of frames of `format.size` bytes, back to back.
+ *  an index is a text file with a line of `<byte offset> <timestamp in seconds>`
+ *  per frame; empty lines and lines starting with '#' are ignored.
+ */
+class ReplaySource
+{
+private:
+    std::ifstream         file_;
+    FrameFormat           format_;
+    std::vector<uint64_t> offsets_;
+    std::vector<double>   timestamps_; // empty without an index
+    std::vector<uint8_t>  frame_;      // or all the frames if preloaded
+    bool                  preloaded_;
+    std::atomic<bool>     cancel_;
+
+    bool read_index_(const std::string& path, const uint64_t& file_size);
+    uint8_t *load_(const size_t& index);
+public:
+    ReplaySource();
+
+    /**
+     *  opens the recording at `path` with frames of `format`, and the index at
+     *  `index` (if not empty). if `preload` is set, all the frames are read
+     *  into memory here, so that the replay does not include any file I/O.
+     *  @return whether the recording can be replayed; errors are reported to std::cerr.
+     */
+    bool open(const std::string& path, const FrameFormat& format,
+              const std::string& index = "", const bool& preload = false);
+
+    size_t             frames() const { return offsets_.size(); }
+    bool               indexed() const { return !timestamps_.empty(); }
+    const FrameFormat& format() const { return format_; }
+
+    /**
+     *  runs all the frames through `pipeline` `loops` times, on the calling thread
+     *  (which thereby takes the role of the dequeue thread). `rate` is used with
+     *  ReplayFixedRate, and with ReplayOriginal if there is no index.
+     *
+     *  the timestamps of the frames are their scheduled times (as monotonic_seconds()),
+     *  or the actual times with ReplayFastest.
+     */
+    ReplayStats run(FramePipeline& pipeline, const ReplayTiming& timing,
+                    const double& rate = 0.0, const size_t& loops = 1);
+
+    /**
+     *  makes run() return after the current frame. may be called from any thread.
+     */
+    void cancel() { cancel_ = true; }
+};
+
+#define REPLAY_UTILS_HPP_
+#endif
@@ -0,0 +1,97 @@
+/*
+ *  MIT License
+ *
+ *  Copyright (c) 2021 Keisuke Sehara
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+*/
+#ifndef RING_UTILS_HPP_
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ *  a bounded, lock-free ring of results between a single producer
+ *  (a stage on the dequeue thread) and a single consumer (the reader).
+ *  the producer never waits: results that do not fit are dropped and counted.
+ */
+template<class T>
+class ResultRing
+{
+private:
+    std::vector<T>        items_;
+    std::atomic<uint64_t> head_;    // # of results pushed (written by the producer)
+    char                  pad_[64]; // keeps the two indices on different cache lines
+    std::atomic<uint64_t> tail_;    // # of results popped (written by the consumer)
+    std::atomic<uint64_t> dropped_;
+public:
+    explicit ResultRing(const size_t& capacity = 1024):
+        items_((capacity > 0)? capacity : 1), head_(0), tail_(0), dropped_(0) { }
+
+    /**
+     *  empties the ring. must not be called while it is in use.
+     */
+    void reset() {
+        head_.store(0, std::memory_order_relaxed);
+        tail_.store(0, std::memory_order_relaxed);
+        dropped_.store(0, std::memory_order_relaxed);
+    }
+
+    /**
+     *  called by the producer only.
+     *  @return false if the ring is full (the result is dropped).
+     */
+    bool push(const T& item) {
+        const uint64_t head = head_.load(std::memory_order_relaxed);
+        if (head - tail_.load(std::memory_order_acquire) >= items_.size()) {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        items_[head % items_.size()] = item;
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     *  called by the consumer only.
+     *  @return the number of results moved into `items` (at most `max_items`).
+     */
+    size_t pop(T *items, const size_t& max_items) {
+        const uint64_t tail  = tail_.load(std::memory_order_relaxed);
+        const uint64_t avail = head_.load(std::memory_order_acquire) - tail;
+        const size_t   count = (avail < max_items)? (size_t)avail : max_items;
+        for (size_t i = 0; i < count; i++) {
+            items[i] = items_[(tail + i) % items_.size()];
+        }
+        tail_.store(tail + count, std::memory_order_release);
+        return count;
+    }
+
+    size_t size() const {
+        // the tail first, so that it cannot have passed the head that is read
+        const uint64_t tail = tail_.load(std::memory_order_acquire);
+        return (size_t)(head_.load(std::memory_order_acquire) - tail);
+    }
+    size_t   capacity() const { return items_.size(); }
+    uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+};
+
+#define RING_UTILS_HPP_
+#endif
@@ -0,0 +1,159 @@
+/*
+ *  MIT License
+ *
+ *  Copyright (c) 2021 Keisuke Sehara
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+*/
+#include "sequence_utils.hpp"
+#include "pool_utils.hpp"
+
+static bool same_settings(const ExposureSettings& a, const ExposureSettings& b)
+{
+    return (a.exposure == b.exposure) && (a.gain == b.gain);
+}
+
+ExposureSequenceStage::ExposureSequenceStage(const size_t& capacity):
+    actuator_(nullptr),
+    delay_(1),
+    deadline_(0.0),
+    step_(0),
+    effective_(),
+    deferred_(false),
+    last_(0.0),
+    period_(0.0),
+    frames_(0),
+    writes_(0),
+    late_(0),
+    tags_(capacity) { }
+
+void ExposureSequenceStage::sequence(ExposureActuator *actuator, const ExposureSettings *steps,
+                                     const size_t& count, const size_t& delay, const double& deadline)
+{
+    if ((actuator == nullptr) || (count == 0)) {
+        actuator_ = nullptr;
+        steps_.clear();
+        return;
+    }
+    actuator_ = actuator;
+    steps_.assign(steps, steps + count);
+    delay_    = (delay > 0)? delay : 1;
+    deadline_ = deadline;
+}
+
+bool ExposureSequenceStage::prepare(const FrameFormat&)
+{
+    if ((actuator_ == nullptr) || steps_.empty()) {
+        return false;
+    }
+    Scheduled_ none = { UINT64_MAX, 0, ExposureSettings(), false };
+    scheduled_.assign(delay_ + 1, none);
+    frames_   = 0;
+    writes_   = 0;
+    late_     = 0;
+    deferred_ = false;
+    last_     = 0.0;
+    period_   = 0.0;
+    write_.reset();
+    tags_.reset();
+
+    // the first frame cannot be scheduled from an earlier one
+    const double start = monotonic_seconds();
+    actuator_->write(steps_[0]);
+    write_.record(monotonic_seconds() - start);
+    writes_.fetch_add(1, std::memory_order_relaxed);
+    written_   = steps_[0];
+    effective_ = steps_[0];
+    step_      = 0;
+    return true;
+}
+
+void ExposureSequenceStage::schedule_(const uint64_t& target, const double& issued)
+{
+    Scheduled_ next = { target, (size_t)(target % steps_.size()), ExposureSettings(), false };
+    next.settings = steps_[next.step];
+    if (!same_settings(next.settings, written_)) {
+        const double start = monotonic_seconds();
+        actuator_->write(next.settings);
+        const double done = monotonic_seconds();
+        write_.record(done - start);
+        writes_.fetch_add(1, std::memory_order_relaxed);
+        written_ = next.settings;
+
+        const double limit = (deadline_ > 0.0)? deadline_
+                                               : (delay_ * period_ - next.settings.exposure);
+        // the schedule cannot be judged before the frame interval is known
+        next.late = ((deadline_ > 0.0) || (period_ > 0.0)) && (done - issued > limit);
+    }
+    scheduled_[target % scheduled_.size()] = next;
+}
+
+void ExposureSequenceStage::process(const FrameView& frame)
+{
+    if (last_ > 0.0) {
+        const double interval = frame.timestamp - last_;
+        period_ = (period_ > 0.0)? (period_ + (interval - period_) / 16) : interval;
+    }
+    last_ = frame.timestamp;
+
+    // the write goes first, to leave it as much time as possible
+    schedule_(frame.sequence + delay_, frame.timestamp);
+
+    const size_t      step      = (size_t)(frame.sequence % steps_.size());
+    const Scheduled_& scheduled = scheduled_[frame.sequence % scheduled_.size()];
+    bool late = false;
+    if (scheduled.target != frame.sequence) {
+        // before the first write that could be scheduled
+        if (same_settings(effective_, steps_[step])) {
+            step_ = step;
+        } else {
+            late  = true;
+        }
+    } else if (!scheduled.late) {
+        step_      = scheduled.step;
+        effective_ = scheduled.settings;
+        deferred_  = false;
+    } else {
+        // the frame was exposed with the settings before this write
+        if (deferred_) {
+            step_      = next_.step;
+            effective_ = next_.settings;
+        }
+        late      = true;
+        deferred_ = true;
+        next_     = scheduled;
+    }
+
+    if (late) {
+        late_.fetch_add(1, std::memory_order_relaxed);
+    }
+    frames_.fetch_add(1, std::memory_order_relaxed);
+    SequenceTag tag = { frame.sequence, frame.timestamp, (uint32_t)step_, late? 1U : 0U,
+                        effective_.exposure, effective_.gain };
+    tags_.push(tag);
+}
+
+SequenceStats ExposureSequenceStage::stats() const
+{
+    SequenceStats stats;
+    stats.frames = frames_.load(std::memory_order_relaxed);
+    stats.writes = writes_.load(std::memory_order_relaxed);
+    stats.late   = late_.load(std::memory_order_relaxed);
+    return stats;
+}
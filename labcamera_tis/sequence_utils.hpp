@@ -0,0 +1,135 @@
+/*
+ *  MIT License
+ *
+ *  Copyright (c) 2021 Keisuke Sehara
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+*/
+#ifndef SEQUENCE_UTILS_HPP_
+#include <atomic>
+#include <cstdint>
+#include <vector>
+#include "stage_utils.hpp"
+#include "histogram_utils.hpp"
+#include "ring_utils.hpp"
+#include "stats_utils.hpp"
+
+/**
+ *  the settings that a frame has been exposed with, as far as the sequencer knows.
+ */
+struct SequenceTag
+{
+    uint64_t sequence;
+    double   timestamp;
+    uint32_t step;      // # of the step in effect
+    uint32_t late;      // 1 if the step scheduled for this frame was not in effect yet
+    double   exposure;  // in seconds
+    double   gain;
+};
+
+struct SequenceStats
+{
+    uint64_t frames;    // frames tagged
+    uint64_t writes;    // settings written to the camera
+    uint64_t late;      // frames whose scheduled step was not in effect
+};
+
+/**
+ *  applies a precomputed sequence of exposure settings frame by frame, from the dequeue
+ *  thread: frame #n is to be exposed with step #(n % steps), and the settings of a step
+ *  are written (through an ExposureActuator) when the frame `delay` frames before it is
+ *  received, i.e. a write is assumed to take effect `delay` frames later. the settings of
+ *  step #0 are written in prepare(), and writes are skipped when nothing changes.
+ *
+ *  a write is late if it completes after `deadline` seconds from the reception of the frame
+ *  that issued it, or with `deadline` == 0, after the exposure of the frame that it is meant
+ *  for is expected to start (`delay` frame intervals minus its exposure, the readout being
+ *  unknown). that frame is then tagged with the settings before the write, and so are
+ *  the first `delay` - 1 frames if their steps differ from step #0. frames dropped before the listener shift the sequence, as the
+ *  stage only counts the frames that it sees. up to `capacity` tags are kept until they are read().
+ */
+class ExposureSequenceStage: public FrameStage
+{
+private:
+    /**
+     *  a write, and the frame that it was meant for.
+     */
+    struct Scheduled_
+    {
+        uint64_t         target;
+        size_t           step;
+        ExposureSettings settings;
+        bool             late;
+    };
+
+    ExposureActuator             *actuator_;
+    std::vector<ExposureSettings> steps_;
+    size_t                        delay_;
+    double                        deadline_;
+
+    std::vector<Scheduled_>       scheduled_; // by target % (delay_ + 1)
+    ExposureSettings              written_;   // the latest settings written
+    size_t                        step_;      // the step in effect
+    ExposureSettings              effective_;
+    bool                          deferred_;  // whether a late write is still to take effect
+    Scheduled_                    next_;      // the late write
+    double                        last_;      // timestamp of the previous frame
+    double                        period_;    // running estimate of the frame interval
+
+    std::atomic<uint64_t>         frames_;
+    std::atomic<uint64_t>         writes_;
+    std::atomic<uint64_t>         late_;
+    LatencyHistogram              write_;     // the time that the writes took
+    ResultRing<SequenceTag>       tags_;
+
+    /**
+     *  writes the settings of the frame `target`, unless they are the ones written last.
+     */
+    void schedule_(const uint64_t& target, const double& issued);
+public:
+    ExposureSequenceStage(const size_t& capacity = 4096);
+
+    /**
+     *  runs through `count` steps with `actuator` (owned by the caller), or stops
+     *  if `actuator` is nullptr or `count` == 0. must be called while there is no acquisition.
+     */
+    void sequence(ExposureActuator *actuator, const ExposureSettings *steps, const size_t& count,
+                  const size_t& delay = 1, const double& deadline = 0.0);
+
+    bool prepare(const FrameFormat& format) override;
+    void process(const FrameView& frame) override;
+
+    const char *name() const override { return "ExposureSequenceStage"; }
+
+    size_t steps() const { return steps_.size(); }
+
+    SequenceStats stats() const;
+    const LatencyHistogram *write_latency() const { return &write_; }
+
+    /**
+     *  moves up to `max_tags` of the oldest tags into `tags`.
+     *  must not be called from more than one thread at a time.
+     */
+    size_t   read(SequenceTag *tags, const size_t& max_tags) { return tags_.pop(tags, max_tags); }
+    size_t   pending() const { return tags_.size(); }
+    uint64_t dropped() const { return tags_.dropped(); }
+};
+
+#define SEQUENCE_UTILS_HPP_
+#endif
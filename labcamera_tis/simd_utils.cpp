@@ -0,0 +1,682 @@
+/*
+ *  MIT License
+ *
+ *  Copyright (c) 2021 Keisuke Sehara
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+*/
+#include "simd_utils.hpp"
+#include <atomic>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define SIMD_X86_
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+// MSVC accepts the intrinsics of any level without compiler flags
+#include <intrin.h>
+#define TARGET_SSE2_
+#define TARGET_AVX2_
+#define TARGET_AVX512_
+#else
+// GCC and Clang compile the functions of each level for that level only,
+// so that the module itself can be built for the baseline
+#define TARGET_SSE2_   __attribute__((target("sse2")))
+#define TARGET_AVX2_   __attribute__((target("avx2")))
+#define TARGET_AVX512_ __attribute__((target("avx512f,avx512bw")))
+#endif
+#endif
+
+/*
+ *  scalar kernels; also used for the remainders of the vectorized loops
+ */
+
+static uint64_t roi_sum8_scalar(const uint8_t *src, size_t stride, size_t width, size_t height)
+{
+    uint64_t sum = 0;
+    for (size_t row = 0; row < height; row++) {
+        const uint8_t *in = src + row * stride;
+        for (size_t x = 0; x < width; x++) {
+            sum += in[x];
+        }
+    }
+    return sum;
+}
+
+static uint64_t roi_sum16_scalar(const uint8_t *src, size_t stride, size_t width, size_t height)
+{
+    uint64_t sum = 0;
+    for (size_t row = 0; row < height; row++) {
+        const uint16_t *in = (const uint16_t *)(src + row * stride);
+        for (size_t x = 0; x < width; x++) {
+            sum += in[x];
+        }
+    }
+    return sum;
+}
+
+static uint64_t sad8_scalar(const uint8_t *a, const uint8_t *b, size_t stride, size_t width, size_t height)
+{
+    uint64_t sum = 0;
+    for (size_t row = 0; row < height; row++) {
+        const uint8_t *p = a + row * stride;
+        const uint8_t *q = b + row * stride;
+        for (size_t x = 0; x < width; x++) {
+            sum += (p[x] > q[x])? (p[x] - q[x]) : (q[x] - p[x]);
+        }
+    }
+    return sum;
+}
+
+static uint64_t sad16_scalar(const uint8_t *a, const uint8_t *b, size_t stride, size_t width, size_t height)
+{
+    uint64_t sum = 0;
+    for (size_t row = 0; row < height; row++) {
+        const uint16_t *p = (const uint16_t *)(a + row * stride);
+        const uint16_t *q = (const uint16_t *)(b + row * stride);
+        for (size_t x = 0; x < width; x++) {
+            sum += (p[x] > q[x])? (p[x] - q[x]) : (q[x] - p[x]);
+        }
+    }
+    return sum;
+}
+
+/*
+ *  there is no useful vector form of a histogram; the counts are instead
+ *  spread over four tables so that runs of the same value do not wait for
+ *  each other's increments. the same kernel is used at every level.
+ */
+static void histogram8_scalar(const uint8_t *src, size_t stride, size_t width, size_t height, uint64_t *bins)
+{
+    uint32_t counts[4][256];
+    std::memset(counts, 0, sizeof(counts));
+    for (size_t row = 0; row < height; row++) {
+        const uint8_t *in = src + row * stride;
+        size_t x = 0;
+        for (; x + 4 <= width; x += 4) {
+            counts[0][in[x]]++;
+            counts[1][in[x + 1]]++;
+            counts[2][in[x + 2]]++;
+            counts[3][in[x + 3]]++;
+        }
+        for (; x < width; x++) {
+            counts[0][in[x]]++;
+        }
+    }
+    for (size_t b = 0; b < 256; b++) {
+        bins[b] += (uint64_t)counts[0][b] + counts[1][b] + counts[2][b] + counts[3][b];
+    }
+}
+
+static void unpack8_scalar(const uint8_t *src, float *dst, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        dst[i] = (float)src[i];
+    }
+}
+
+static void unpack16_scalar(const uint8_t *src, float *dst, size_t count)
+{
+    const uint16_t *in = (const uint16_t *)src;
+    for (size_t i = 0; i < count; i++) {
+        dst[i] = (float)in[i];
+    }
+}
+
+static void accumulate_scalar(const float *values, const float *reference,
+                              double *sum, double *sum_sq, float *minimum, float *maximum, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        // exact for values of up to 24 bits
+        const double diff = (double)(values[i] - reference[i]);
+        sum[i]    += diff;
+        sum_sq[i] += diff * diff;
+        minimum[i] = (values[i] < minimum[i])? values[i] : minimum[i];
+        maximum[i] = (values[i] > maximum[i])? values[i] : maximum[i];
+    }
+}
+
+#ifdef SIMD_X86_
+
+/*
+ *  SSE2 kernels
+ */
+
+TARGET_SSE2_ static uint64_t roi_sum8_sse2(const uint8_t *src, size_t stride, size_t width, size_t height)
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i  acc = zero;
+    uint64_t sum = 0;
+    for (size_t row = 0; row < height; row++) {
+        const uint8_t *in = src + row * stride;
+        size_t x = 0;
+        for (; x + 16 <= width; x += 16) {
+            acc = _mm_add_epi64(acc, _mm_sad_epu8(_mm_loadu_si128((const __m128i *)(in + x)), zero));
+        }
+        for (; x < width; x++) {
+            sum += in[x];
+        }
+    }
+    uint64_t lanes[2];
+    _mm_storeu_si128((__m128i *)lanes, acc);
+    return sum + lanes[0] + lanes[1];
+}
+
+TARGET_SSE2_ static uint64_t roi_sum16_sse2(const uint8_t *src, size_t stride, size_t width, size_t height)
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i  acc = zero;
+    uint64_t sum = 0;
+    for (size_t row = 0; row < height; row++) {
+        const uint16_t *in = (const uint16_t *)(src + row * stride);
+        // 32-bit lanes do not overflow within a row of up to 2^18 pixels
+        __m128i row_acc = zero;
+        size_t x = 0;
+        for (; x + 8 <= width; x += 8) {
+            __m128i v = _mm_loadu_si128((const __m128i *)(in + x));
+            row_acc = _mm_add_epi32(row_acc, _mm_add_epi32(_mm_unpacklo_epi16(v, zero),
+                                                           _mm_unpackhi_epi16(v, zero)));
+        }
+        acc = _mm_add_epi64(acc, _mm_add_epi64(_mm_unpacklo_epi32(row_acc, zero),
+                                               _mm_unpackhi_epi32(row_acc, zero)));
+        for (; x < width; x++) {
+            sum += in[x];
+        }
+    }
+    uint64_t lanes[2];
+    _mm_storeu_si128((__m128i *)lanes, acc);
+    return sum + lanes[0] + lanes[1];
+}
+
+TARGET_SSE2_ static uint64_t sad8_sse2(const uint8_t *a, const uint8_t *b, size_t stride, size_t width, size_t height)
+{
+    __m128i  acc = _mm_setzero_si128();
+    uint64_t sum = 0;
+    for (size_t row = 0; row < height; row++) {
+        const uint8_t *p = a + row * stride;
+        const uint8_t *q = b + row * stride;
+        size_t x = 0;
+        for (; x + 16 <= width; x += 16) {
+            acc = _mm_add_epi64(acc, _mm_sad_epu8(_mm_loadu_si128((const __m128i *)(p + x)),
+                                                  _mm_loadu_si128((const __m128i *)(q + x))));
+        }
+        sum += sad8_scalar(p + x, q + x, 0, width - x, 1);
+    }
+    uint64_t lanes[2];
+    _mm_storeu_si128((__m128i *)lanes, acc);
+    return sum + lanes[0] + lanes[1];
+}
+
+TARGET_SSE2_ static uint64_t sad16_sse2(const uint8_t *a, const uint8_t *b, size_t stride, size_t width, size_t height)
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i  acc = zero;
+    uint64_t sum = 0;
+    for (size_t row = 0; row < height; row++) {
+        const uint16_t *p = (const uint16_t *)(a + row * stride);
+        const uint16_t *q = (const uint16_t *)(b + row * stride);
+        __m128i row_acc = zero;
+        size_t x = 0;
+        for (; x + 8 <= width; x += 8) {
+            __m128i u = _mm_loadu_si128((const __m128i *)(p + x));
+            __m128i v = _mm_loadu_si128((const __m128i *)(q + x));
+            // one of the saturated differences is zero
+            __m128i d = _mm_or_si128(_mm_subs_epu16(u, v), _mm_subs_epu16(v, u));
+            row_acc = _mm_add_epi32(row_acc, _mm_add_epi32(_mm_unpacklo_epi16(d, zero),
+                                                           _mm_unpackhi_epi16(d, zero)));
+        }
+        acc = _mm_add_epi64(acc, _mm_add_epi64(_mm_unpacklo_epi32(row_acc, zero),
+                                               _mm_unpackhi_epi32(row_acc, zero)));
+        sum += sad16_scalar((const uint8_t *)(p + x), (const uint8_t *)(q + x), 0, width - x, 1);
+    }
+    uint64_t lanes[2];
+    _mm_storeu_si128((__m128i *)lanes, acc);
+    return sum + lanes[0] + lanes[1];
+}
+
+TARGET_SSE2_ static void unpack8_sse2(const uint8_t *src, float *dst, size_t count)
+{
+    const __m128i zero = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m128i v  = _mm_loadu_si128((const __m128i *)(src + i));
+        __m128i lo = _mm_unpacklo_epi8(v, zero);
+        __m128i hi = _mm_unpackhi_epi8(v, zero);
+        _mm_storeu_ps(dst + i,      _mm_cvtepi32_ps(_mm_unpacklo_epi16(lo, zero)));
+        _mm_storeu_ps(dst + i + 4,  _mm_cvtepi32_ps(_mm_unpackhi_epi16(lo, zero)));
+        _mm_storeu_ps(dst + i + 8,  _mm_cvtepi32_ps(_mm_unpacklo_epi16(hi, zero)));
+        _mm_storeu_ps(dst + i + 12, _mm_cvtepi32_ps(_mm_unpackhi_epi16(hi, zero)));
+    }
+    unpack8_scalar(src + i, dst + i, count - i);
+}
+
+TARGET_SSE2_ static void unpack16_sse2(const uint8_t *src, float *dst, size_t count)
+{
+    const __m128i zero = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + 2 * i));
+        _mm_storeu_ps(dst + i,     _mm_cvtepi32_ps(_mm_unpacklo_epi16(v, zero)));
+        _mm_storeu_ps(dst + i + 4, _mm_cvtepi32_ps(_mm_unpackhi_epi16(v, zero)));
+    }
+    unpack16_scalar(src + 2 * i, dst + i, count - i);
+}
+
+TARGET_SSE2_ static void accumulate_sse2(const float *values, const float *reference,
+                                         double *sum, double *sum_sq, float *minimum, float *maximum, size_t count)
+{
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128  v    = _mm_loadu_ps(values + i);
+        __m128  diff = _mm_sub_ps(v, _mm_loadu_ps(reference + i));
+        __m128d lo   = _mm_cvtps_pd(diff);
+        __m128d hi   = _mm_cvtps_pd(_mm_movehl_ps(diff, diff));
+        _mm_storeu_pd(sum + i,        _mm_add_pd(_mm_loadu_pd(sum + i), lo));
+        _mm_storeu_pd(sum + i + 2,    _mm_add_pd(_mm_loadu_pd(sum + i + 2), hi));
+        _mm_storeu_pd(sum_sq + i,     _mm_add_pd(_mm_loadu_pd(sum_sq + i), _mm_mul_pd(lo, lo)));
+        _mm_storeu_pd(sum_sq + i + 2, _mm_add_pd(_mm_loadu_pd(sum_sq + i + 2), _mm_mul_pd(hi, hi)));
+        _mm_storeu_ps(minimum + i, _mm_min_ps(_mm_loadu_ps(minimum + i), v));
+        _mm_storeu_ps(maximum + i, _mm_max_ps(_mm_loadu_ps(maximum + i), v));
+    }
+    accumulate_scalar(values + i, reference + i, sum + i, sum_sq + i, minimum + i, maximum + i, count - i);
+}
+
+/*
+ *  AVX2 kernels
+ */
+
+TARGET_AVX2_ static uint64_t roi_sum8_avx2(const uint8_t *src, size_t stride, size_t width, size_t height)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i  acc = zero;
+    uint64_t sum = 0;
+    for (size_t row = 0; row < height; row++) {
+        const uint8_t *in = src + row * stride;
+        size_t x = 0;
+        for (; x + 32 <= width; x += 32) {
+            acc = _mm256_add_epi64(acc, _mm256_sad_epu8(_mm256_loadu_si256((const __m256i *)(in + x)), zero));
+        }
+        for (; x < width; x++) {
+            sum += in[x];
+        }
+    }
+    uint64_t lanes[4];
+    _mm256_storeu_si256((__m256i *)lanes, acc);
+    return sum + lanes[0] + lanes[1] + lanes[2] + lanes[3];
+}
+
+TARGET_AVX2_ static uint64_t roi_sum16_avx2(const uint8_t *src, size_t stride, size_t width, size_t height)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i  acc = zero;
+    uint64_t sum = 0;
+    for (size_t row = 0; row < height; row++) {
+        const uint16_t *in = (const uint16_t *)(src + row * stride);
+        __m256i row_acc = zero;
+        size_t x = 0;
+        for (; x + 16 <= width; x += 16) {
+            __m256i v = _mm256_loadu_si256((const __m256i *)(in + x));
+            row_acc = _mm256_add_epi32(row_acc, _mm256_add_epi32(_mm256_unpacklo_epi16(v, zero),
+                                                                 _mm256_unpackhi_epi16(v, zero)));
+        }
+        acc = _mm256_add_epi64(acc, _mm256_add_epi64(_mm256_unpacklo_epi32(row_acc, zero),
+                                                     _mm256_unpackhi_epi32(row_acc, zero)));
+        for (; x < width; x++) {
+            sum += in[x];
+        }
+    }
+    uint64_t lanes[4];
+    _mm256_storeu_si256((__m256i *)lanes, acc);
+    return sum + lanes[0] + lanes[1] + lanes[2] + lanes[3];
+}
+
+TARGET_AVX2_ static uint64_t sad8_avx2(const uint8_t *a, const uint8_t *b, size_t stride, size_t width, size_t height)
+{
+    __m256i  acc = _mm256_setzero_si256();
+    uint64_t sum = 0;
+    for (size_t row = 0; row < height; row++) {
+        const uint8_t *p = a + row * stride;
+        const uint8_t *q = b + row * stride;
+        size_t x = 0;
+        for (; x + 32 <= width; x += 32) {
+            acc = _mm256_add_epi64(acc, _mm256_sad_epu8(_mm256_loadu_si256((const __m256i *)(p + x)),
+                                                        _mm256_loadu_si256((const __m256i *)(q + x))));
+        }
+        sum += sad8_scalar(p + x, q + x, 0, width - x, 1);
+    }
+    uint64_t lanes[4];
+    _mm256_storeu_si256((__m256i *)lanes, acc);
+    return sum + lanes[0] + lanes[1] + lanes[2] + lanes[3];
+}
+
+TARGET_AVX2_ static uint64_t sad16_avx2(const uint8_t *a, const uint8_t *b, size_t stride, size_t width, size_t height)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i  acc = zero;
+    uint64_t sum = 0;
+    for (size_t row = 0; row < height; row++) {
+        const uint16_t *p = (const uint16_t *)(a + row * stride);
+        const uint16_t *q = (const uint16_t *)(b + row * stride);
+        __m256i row_acc = zero;
+        size_t x = 0;
+        for (; x + 16 <= width; x += 16) {
+            __m256i u = _mm256_loadu_si256((const __m256i *)(p + x));
+            __m256i v = _mm256_loadu_si256((const __m256i *)(q + x));
+            __m256i d = _mm256_or_si256(_mm256_subs_epu16(u, v), _mm256_subs_epu16(v, u));
+            row_acc = _mm256_add_epi32(row_acc, _mm256_add_epi32(_mm256_unpacklo_epi16(d, zero),
+                                                                 _mm256_unpackhi_epi16(d, zero)));
+        }
+        acc = _mm256_add_epi64(acc, _mm256_add_epi64(_mm256_unpacklo_epi32(row_acc, zero),
+                                                     _mm256_unpackhi_epi32(row_acc, zero)));
+        sum += sad16_scalar((const uint8_t *)(p + x), (const uint8_t *)(q + x), 0, width - x, 1);
+    }
+    uint64_t lanes[4];
+    _mm256_storeu_si256((__m256i *)lanes, acc);
+    return sum + lanes[0] + lanes[1] + lanes[2] + lanes[3];
+}
+
+TARGET_AVX2_ static void unpack8_avx2(const uint8_t *src, float *dst, size_t count)
+{
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i v = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(src + i)));
+        _mm256_storeu_ps(dst + i, _mm256_cvtepi32_ps(v));
+    }
+    unpack8_scalar(src + i, dst + i, count - i);
+}
+
+TARGET_AVX2_ static void unpack16_avx2(const uint8_t *src, float *dst, size_t count)
+{
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i v = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)(src + 2 * i)));
+        _mm256_storeu_ps(dst + i, _mm256_cvtepi32_ps(v));
+    }
+    unpack16_scalar(src + 2 * i, dst + i, count - i);
+}
+
+TARGET_AVX2_ static void accumulate_avx2(const float *values, const float *reference,
+                                         double *sum, double *sum_sq, float *minimum, float *maximum, size_t count)
+{
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256  v    = _mm256_loadu_ps(values + i);
+        __m256  diff = _mm256_sub_ps(v, _mm256_loadu_ps(reference + i));
+        __m256d lo   = _mm256_cvtps_pd(_mm256_castps256_ps128(diff));
+        __m256d hi   = _mm256_cvtps_pd(_mm256_extractf128_ps(diff, 1));
+        _mm256_storeu_pd(sum + i,        _mm256_add_pd(_mm256_loadu_pd(sum + i), lo));
+        _mm256_storeu_pd(sum + i + 4,    _mm256_add_pd(_mm256_loadu_pd(sum + i + 4), hi));
+        _mm256_storeu_pd(sum_sq + i,     _mm256_add_pd(_mm256_loadu_pd(sum_sq + i), _mm256_mul_pd(lo, lo)));
+        _mm256_storeu_pd(sum_sq + i + 4, _mm256_add_pd(_mm256_loadu_pd(sum_sq + i + 4), _mm256_mul_pd(hi, hi)));
+        _mm256_storeu_ps(minimum + i, _mm256_min_ps(_mm256_loadu_ps(minimum + i), v));
+        _mm256_storeu_ps(maximum + i, _mm256_max_ps(_mm256_loadu_ps(maximum + i), v));
+    }
+    accumulate_scalar(values + i, reference + i, sum + i, sum_sq + i, minimum + i, maximum + i, count - i);
+}
+
+/*
+ *  AVX-512 kernels (the RGB24 shuffle is shared with AVX2)
+ */
+
+#if defined(__GNUC__) && !defined(__clang__)
+// the "undefined" vectors in GCC's AVX-512 headers trip -Wuninitialized
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+TARGET_AVX512_ static uint64_t roi_sum8_avx512(const uint8_t *src, size_t stride, size_t width, size_t height)
+{
+    const __m512i zero = _mm512_setzero_si512();
+    __m512i  acc = zero;
+    uint64_t sum = 0;
+    for (size_t row = 0; row < height; row++) {
+        const uint8_t *in = src + row * stride;
+        size_t x = 0;
+        for (; x + 64 <= width; x += 64) {
+            acc = _mm512_add_epi64(acc, _mm512_sad_epu8(_mm512_loadu_si512((const void *)(in + x)), zero));
+        }
+        for (; x < width; x++) {
+            sum += in[x];
+        }
+    }
+    return sum + (uint64_t)_mm512_reduce_add_epi64(acc);
+}
+
+TARGET_AVX512_ static uint64_t roi_sum16_avx512(const uint8_t *src, size_t stride, size_t width, size_t height)
+{
+    const __m512i zero = _mm512_setzero_si512();
+    __m512i  acc = zero;
+    uint64_t sum = 0;
+    for (size_t row = 0; row < height; row++) {
+        const uint16_t *in = (const uint16_t *)(src + row * stride);
+        __m512i row_acc = zero;
+        size_t x = 0;
+        for (; x + 32 <= width; x += 32) {
+            __m512i v = _mm512_loadu_si512((const void *)(in + x));
+            row_acc = _mm512_add_epi32(row_acc, _mm512_add_epi32(_mm512_unpacklo_epi16(v, zero),
+                                                                 _mm512_unpackhi_epi16(v, zero)));
+        }
+        acc = _mm512_add_epi64(acc, _mm512_add_epi64(_mm512_unpacklo_epi32(row_acc, zero),
+                                                     _mm512_unpackhi_epi32(row_acc, zero)));
+        for (; x < width; x++) {
+            sum += in[x];
+        }
+    }
+    return sum + (uint64_t)_mm512_reduce_add_epi64(acc);
+}
+
+TARGET_AVX512_ static uint64_t sad8_avx512(const uint8_t *a, const uint8_t *b, size_t stride, size_t width, size_t height)
+{
+    __m512i  acc = _mm512_setzero_si512();
+    uint64_t sum = 0;
+    for (size_t row = 0; row < height; row++) {
+        const uint8_t *p = a + row * stride;
+        const uint8_t *q = b + row * stride;
+        size_t x = 0;
+        for (; x + 64 <= width; x += 64) {
+            acc = _mm512_add_epi64(acc, _mm512_sad_epu8(_mm512_loadu_si512((const void *)(p + x)),
+                                                        _mm512_loadu_si512((const void *)(q + x))));
+        }
+        sum += sad8_scalar(p + x, q + x, 0, width - x, 1);
+    }
+    return sum + (uint64_t)_mm512_reduce_add_epi64(acc);
+}
+
+TARGET_AVX512_ static uint64_t sad16_avx512(const uint8_t *a, const uint8_t *b, size_t stride, size_t width, size_t height)
+{
+    const __m512i zero = _mm512_setzero_si512();
+    __m512i  acc = zero;
+    uint64_t sum = 0;
+    for (size_t row = 0; row < height; row++) {
+        const uint16_t *p = (const uint16_t *)(a + row * stride);
+        const uint16_t *q = (const uint16_t *)(b + row * stride);
+        __m512i row_acc = zero;
+        size_t x = 0;
+        for (; x + 32 <= width; x += 32) {
+            __m512i u = _mm512_loadu_si512((const void *)(p + x));
+            __m512i v = _mm512_loadu_si512((const void *)(q + x));
+            __m512i d = _mm512_or_si512(_mm512_subs_epu16(u, v), _mm512_subs_epu16(v, u));
+            row_acc = _mm512_add_epi32(row_acc, _mm512_add_epi32(_mm512_unpacklo_epi16(d, zero),
+                                                                 _mm512_unpackhi_epi16(d, zero)));
+        }
+        acc = _mm512_add_epi64(acc, _mm512_add_epi64(_mm512_unpacklo_epi32(row_acc, zero),
+                                                     _mm512_unpackhi_epi32(row_acc, zero)));
+        sum += sad16_scalar((const uint8_t *)(p + x), (const uint8_t *)(q + x), 0, width - x, 1);
+    }
+    return sum + (uint64_t)_mm512_reduce_add_epi64(acc);
+}
+
+TARGET_AVX512_ static void unpack8_avx512(const uint8_t *src, float *dst, size_t count)
+{
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m512i v = _mm512_cvtepu8_epi32(_mm_loadu_si128((const __m128i *)(src + i)));
+        _mm512_storeu_ps(dst + i, _mm512_cvtepi32_ps(v));
+    }
+    unpack8_scalar(src + i, dst + i, count - i);
+}
+
+TARGET_AVX512_ static void unpack16_avx512(const uint8_t *src, float *dst, size_t count)
+{
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m512i v = _mm512_cvtepu16_epi32(_mm256_loadu_si256((const __m256i *)(src + 2 * i)));
+        _mm512_storeu_ps(dst + i, _mm512_cvtepi32_ps(v));
+    }
+    unpack16_scalar(src + 2 * i, dst + i, count - i);
+}
+
+TARGET_AVX512_ static void accumulate_avx512(const float *values, const float *reference,
+                                             double *sum, double *sum_sq, float *minimum, float *maximum, size_t count)
+{
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m512  v    = _mm512_loadu_ps(values + i);
+        __m512  diff = _mm512_sub_ps(v, _mm512_loadu_ps(reference + i));
+        __m512d lo   = _mm512_cvtps_pd(_mm512_castps512_ps256(diff));
+        __m512d hi   = _mm512_cvtps_pd(_mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(diff), 1)));
+        _mm512_storeu_pd(sum + i,        _mm512_add_pd(_mm512_loadu_pd(sum + i), lo));
+        _mm512_storeu_pd(sum + i + 8,    _mm512_add_pd(_mm512_loadu_pd(sum + i + 8), hi));
+        _mm512_storeu_pd(sum_sq + i,     _mm512_add_pd(_mm512_loadu_pd(sum_sq + i), _mm512_mul_pd(lo, lo)));
+        _mm512_storeu_pd(sum_sq + i + 8, _mm512_add_pd(_mm512_loadu_pd(sum_sq + i + 8), _mm512_mul_pd(hi, hi)));
+        _mm512_storeu_ps(minimum + i, _mm512_min_ps(_mm512_loadu_ps(minimum + i), v));
+        _mm512_storeu_ps(maximum + i, _mm512_max_ps(_mm512_loadu_ps(maximum + i), v));
+    }
+    accumulate_scalar(values + i, reference + i, sum + i, sum_sq + i, minimum + i, maximum + i, count - i);
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+#endif // SIMD_X86_
+
+static const PixelKernels KERNELS[] = {
+    { IsaScalar,
+      roi_sum8_scalar, roi_sum16_scalar, sad8_scalar, sad16_scalar, histogram8_scalar, unpack8_scalar, unpack16_scalar,
+      accumulate_scalar },
+#ifdef SIMD_X86_
+    { IsaSSE2,
+      roi_sum8_sse2,   roi_sum16_sse2,   sad8_sse2,   sad16_sse2,   histogram8_scalar, unpack8_sse2,   unpack16_sse2,
+      accumulate_sse2 },
+    { IsaAVX2,
+      roi_sum8_avx2,   roi_sum16_avx2,   sad8_avx2,   sad16_avx2,   histogram8_scalar, unpack8_avx2,   unpack16_avx2,
+      accumulate_avx2 },
+    { IsaAVX512,
+      roi_sum8_avx512, roi_sum16_avx512, sad8_avx512, sad16_avx512, histogram8_scalar, unpack8_avx512, unpack16_avx512,
+      accumulate_avx512 },
+#endif
+};
+
+static std::atomic<const PixelKernels *> selected_(nullptr);
+
+static IsaLevel detect_isa_()
+{
+#if !defined(SIMD_X86_)
+    return IsaScalar;
+#elif defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 0);
+    const int max_leaf = info[0];
+    __cpuid(info, 1);
+    const bool sse2    = (info[3] >> 26) & 1;
+    const bool ssse3   = (info[2] >>  9) & 1;
+    const bool osxsave = (info[2] >> 27) & 1;
+    const bool avx     = (info[2] >> 28) & 1;
+    // the OS must also save the vector registers on context switches
+    const unsigned long long xcr0 = osxsave? _xgetbv(0) : 0;
+    int features = 0;
+    if (max_leaf >= 7) {
+        __cpuidex(info, 7, 0);
+        features = info[1];
+    }
+    if (!sse2) {
+        return IsaScalar;
+    }
+    if (!(ssse3 && avx && ((xcr0 & 0x06) == 0x06) && ((features >> 5) & 1))) {
+        return IsaSSE2;
+    }
+    if (!(((xcr0 & 0xE6) == 0xE6) && ((features >> 16) & 1) && ((features >> 30) & 1))) {
+        return IsaAVX2;
+    }
+    return IsaAVX512;
+#else
+    // also checks that the OS saves the vector registers
+    __builtin_cpu_init();
+    if (!__builtin_cpu_supports("sse2")) {
+        return IsaScalar;
+    }
+    if (!__builtin_cpu_supports("ssse3") || !__builtin_cpu_supports("avx2")) {
+        return IsaSSE2;
+    }
+    if (!__builtin_cpu_supports("avx512f") || !__builtin_cpu_supports("avx512bw")) {
+        return IsaAVX2;
+    }
+    return IsaAVX512;
+#endif
+}
+
+IsaLevel supported_isa()
+{
+    static const IsaLevel level = detect_isa_();
+    return level;
+}
+
+bool select_isa(const IsaLevel& level)
+{
+    const PixelKernels *kernels = pixel_kernels(level);
+    if (kernels == nullptr) {
+        return false;
+    }
+    selected_.store(kernels, std::memory_order_release);
+    return true;
+}
+
+const PixelKernels& pixel_kernels()
+{
+    const PixelKernels *kernels = selected_.load(std::memory_order_acquire);
+    if (kernels == nullptr) {
+        const PixelKernels *best = &KERNELS[supported_isa()];
+        // leaves any concurrent select_isa() in effect
+        if (selected_.compare_exchange_strong(kernels, best, std::memory_order_acq_rel)) {
+            kernels = best;
+        }
+    }
+    return *kernels;
+}
+
+const PixelKernels *pixel_kernels(const IsaLevel& level)
+{
+    if ((level < IsaScalar) || (level > supported_isa())) {
+        return nullptr;
+    }
+    return &KERNELS[level];
+}
+
+const char *isa_name(const IsaLevel& level)
+{
+    switch (level) {
+    case IsaScalar: return "scalar";
+    case IsaSSE2:   return "sse2";
+    case IsaAVX2:   return "avx2";
+    case IsaAVX512: return "avx512";
+    default:        return "unknown";
+    }
+}
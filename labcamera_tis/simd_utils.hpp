@@ -0,0 +1,99 @@
+/*
+ *  MIT License
+ *
+ *  Copyright (c) 2021 Keisuke Sehara
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+*/
+#ifndef SIMD_UTILS_HPP_
+#include <cstddef>
+#include <cstdint>
+
+/**
+ *  the instruction set levels that the pixel kernels are compiled for.
+ *  each level includes the preceding ones.
+ */
+enum IsaLevel
+{
+    IsaScalar = 0,
+    IsaSSE2   = 1,
+    IsaAVX2   = 2, // also uses SSSE3 shuffles
+    IsaAVX512 = 3, // AVX-512F and AVX-512BW
+};
+
+/**
+ *  the per-frame pixel loops, in one version for each IsaLevel.
+ *  strides are in bytes; widths and counts are in values, i.e. pixels times channels.
+ */
+struct PixelKernels
+{
+    IsaLevel isa;
+
+    /** the sum of the values in a region of 8- or 16-bit pixels. */
+    uint64_t (*roi_sum8)(const uint8_t *src, size_t stride, size_t width, size_t height);
+    uint64_t (*roi_sum16)(const uint8_t *src, size_t stride, size_t width, size_t height);
+
+    /** the sum of absolute differences between the same region of two frames. */
+    uint64_t (*sad8)(const uint8_t *a, const uint8_t *b, size_t stride, size_t width, size_t height);
+    uint64_t (*sad16)(const uint8_t *a, const uint8_t *b, size_t stride, size_t width, size_t height);
+
+    /** adds the 8-bit values in a region to `bins` (256 bins). */
+    void     (*histogram8)(const uint8_t *src, size_t stride, size_t width, size_t height, uint64_t *bins);
+
+    /** converts 8- or 16-bit values to floats. */
+    void     (*unpack8)(const uint8_t *src, float *dst, size_t count);
+    void     (*unpack16)(const uint8_t *src, float *dst, size_t count);
+
+    /**
+     *  adds the differences of `values` from `reference` to `sum`, their squares
+     *  to `sum_sq`, and updates the running `minimum` and `maximum`.
+     */
+    void     (*accumulate)(const float *values, const float *reference,
+                           double *sum, double *sum_sq, float *minimum, float *maximum, size_t count);
+};
+
+/**
+ *  @return the highest level that both this build and the CPU support.
+ */
+IsaLevel supported_isa();
+
+/**
+ *  selects the kernels of `level`, e.g. to compare the levels.
+ *  the kernels are otherwise selected on the first call to pixel_kernels().
+ *  stages look up the kernels when they are prepared, so this is meant
+ *  to be called between acquisitions.
+ *
+ *  @return false (and leaves the selection as it is) if the level is not supported.
+ */
+bool select_isa(const IsaLevel& level);
+
+/**
+ *  @return the kernels of the selected level.
+ */
+const PixelKernels& pixel_kernels();
+
+/**
+ *  @return the kernels of `level`, or nullptr if it is not supported.
+ */
+const PixelKernels *pixel_kernels(const IsaLevel& level);
+
+const char *isa_name(const IsaLevel& level);
+
+#define SIMD_UTILS_HPP_
+#endif
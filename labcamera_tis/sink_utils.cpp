@@ -22,10 +22,23 @@
  *  SOFTWARE.
 */
 #include "sink_utils.hpp"
+#include <algorithm>
 #include <iostream>
 
+FrameFormat as_frame_format(const DShowLib::FrameTypeInfo& info, const bool& bottom_up)
+{
+    FrameFormat format;
+    format.color          = (ColorFormat)info.getColorformat();
+    format.bits_per_pixel = info.getBitsPerPixel();
+    format.width          = (size_t)info.dim.cx;
+    format.height         = (size_t)info.dim.cy;
+    format.size           = info.buffersize;
+    format.bottom_up      = bottom_up;
+    return format;
+}
+
 DefaultFrameNotificationSinkListener::DefaultFrameNotificationSinkListener(FrameCallback callback, void *user_data):
-    callback_(callback), user_data_(user_data), count_(0) { }
+    callback_(callback), user_data_(user_data), count_(0), bottom_up_(false), cropping_(false) { }
 
 void DefaultFrameNotificationSinkListener::setCallback(FrameCallback callback)
 {
@@ -34,10 +47,21 @@ void DefaultFrameNotificationSinkListener::setCallback(FrameCallback callback)
 
 void DefaultFrameNotificationSinkListener::frameReceived(DShowLib::IFrame &frame)
 {
+    FrameView view = { frame.getPtr(), frame.getActualDataSize(), count_, monotonic_seconds() };
+    stages_.process(view);
+
     count_++;
-    if (callback_ != nullptr) {
+    if (callback_ == nullptr) {
+        return;
+    }
+    if (cropping_ && (crop_.bin() > 1)) {
+        crop_.apply(frame.getPtr(), cropped_.data());
+        callback_(cropped_.size(), cropped_.data(), view.sequence, view.timestamp, user_data_);
+    } else {
         callback_(frame.getActualDataSize(),
                  frame.getPtr(),
+                 view.sequence,
+                 view.timestamp,
                  user_data_);
     }
 }
@@ -45,13 +69,18 @@ void DefaultFrameNotificationSinkListener::frameReceived(DShowLib::IFrame &frame
 void DefaultFrameNotificationSinkListener::sinkConnected(const DShowLib::FrameTypeInfo& info)
 {
     count_ = 0;
+    const FrameFormat format = as_frame_format(info, bottom_up_);
+    stages_.prepare(format);
+    cropping_ = prepare_crop(crop_, format, cropped_);
 }
 
 void DefaultFrameNotificationSinkListener::sinkDisconnected()
 {
+    stages_.finish();
+
     if (callback_ != nullptr) {
         // mark end-of-acquisition
-        callback_(0, nullptr, user_data_);
+        callback_(0, nullptr, count_, 0.0, user_data_);
     }
 
     std::cerr << "received " << count_ << " frames in total" << std::endl;
@@ -62,86 +91,162 @@ void dequeue_context(DefaultFrameQueueSinkListener *listener) {
 }
 
 DefaultFrameQueueSinkListener::DefaultFrameQueueSinkListener(FrameCallback callback, void *user_data):
-    callback_(callback),
-    user_data_(user_data),
-    size_(0),
     buffer_count_(0),
-    quit_(false) { }
+    sink_(nullptr),
+    pipeline_(callback, user_data),
+    bottom_up_(false),
+    frame_rate_(0.0),
+    drop_probability_(0.0),
+    warmup_(0),
+    max_buffers_(0),
+    buffers_count_(0),
+    buffers_size_(0),
+    buffers_stride_(0),
+    buffers_sink_(nullptr) { }
 
 void DefaultFrameQueueSinkListener::sinkConnected(DShowLib::FrameQueueSink& sink, const DShowLib::FrameTypeInfo& info)
 {
     sink_   = &sink;
-    size_   = info.buffersize;
-    quit_   = false; // just in case it is reused
-    thread_ = std::thread(dequeue_context, this);
+    handoff_.reset(); // just in case it is reused
+    latency_.reset();
+    pipeline_.prepare(as_frame_format(info, bottom_up_));
 
     if (buffer_count_ > 0) {
-        DShowLib::Error ret = sink.allocAndQueueBuffers(buffer_count_);
+        size_t queued = 0;
+        if (!memory_.is_default()) {
+            queued = queue_buffers_(sink, info);
+        }
+        if (queued < buffer_count_) {
+            DShowLib::Error ret = sink.allocAndQueueBuffers(buffer_count_ - queued);
+            if (ret.isError()) {
+                std::cerr << "***failed to allocate frames: "
+                          << ret.toString() << std::endl;
+            }
+        }
+    }
+    sizing_.start(grow_, this, frame_rate_, drop_probability_, max_buffers_,
+                  warmup_, buffer_count_, info.buffersize);
+
+    // everything above is set up before the dequeue thread starts
+    thread_ = std::thread(dequeue_context, this);
+}
+
+size_t DefaultFrameQueueSinkListener::queue_buffers_(DShowLib::FrameQueueSink& sink, const DShowLib::FrameTypeInfo& info)
+{
+    if (buffers_sink_ != nullptr) {
+        // should not happen: the previous sink has not disconnected
+        std::cerr << "***frame memory is still in use by another sink; "
+                  << "the sink buffers are left to the SDK" << std::endl;
+        return 0;
+    }
+    // each buffer starts at a page boundary
+    const size_t stride = ((info.buffersize + 4095) / 4096) * 4096;
+    if ((buffers_.data() == nullptr) || (buffers_count_ != buffer_count_)
+        || (buffers_size_ != info.buffersize) || (buffers_stride_ != stride)) {
+        buffers_count_ = 0;
+        if (!buffers_.allocate(buffer_count_ * stride, memory_)) {
+            return 0;
+        }
+        buffers_count_  = buffer_count_;
+        buffers_size_   = info.buffersize;
+        buffers_stride_ = stride;
+    }
+    buffers_sink_ = &sink;
+
+    for (size_t i = 0; i < buffers_count_; i++) {
+        DShowLib::tFrameQueueBufferPtr buffer;
+        DShowLib::Error ret = DShowLib::createFrameQueueBuffer(buffer, info, buffers_.data() + i * stride,
+                                                               info.buffersize, nullptr);
+        if (!ret.isError()) {
+            ret = sink.queueBuffer(buffer);
+        }
         if (ret.isError()) {
-            std::cerr << "***failed to allocate frames: "
-                      << ret.toString() << std::endl;
+            std::cerr << "***failed to queue frame buffers from frame memory: "
+                      << ret.toString() << "; the rest is left to the SDK" << std::endl;
+            return i;
         }
     }
+    return buffers_count_;
+}
+
+void DefaultFrameQueueSinkListener::unqueue_buffers_(DShowLib::FrameQueueSink& sink)
+{
+    if (&sink != buffers_sink_) {
+        return;
+    }
+    // all the buffers are back in the input queue once the output queue is drained;
+    // those that the SDK allocated go along with them
+    sink.popAllInputQueueBuffers();
+    buffers_sink_ = nullptr;
 }
 
 void DefaultFrameQueueSinkListener::framesQueued(DShowLib::FrameQueueSink& sink)
 {
-    std::unique_lock<std::mutex> lock(io_);
-    quit_ = sink_->isCancelRequested();
-    reception_.notify_one(); // supposed to be the dequeue thread
+    handoff_.notify(sink, sink.isCancelRequested());
 }
 
 void DefaultFrameQueueSinkListener::sinkDisconnected(DShowLib::FrameQueueSink& sink)
 {
-    mark_quit_();
+    handoff_.quit();
     thread_.join();
 
     while(sink_->getOutputQueueSize() > 0) {
         process_single_();
     }
+    sizing_.stop();
 
-    // mark end-of-acquisition
-    callback_(0, nullptr, user_data_);
+    pipeline_.finish();
+    unqueue_buffers_(sink);
     sink_ = nullptr;
 
     auto info = sink.getFrameCountInfo();
     std::cerr << ">>> buffer stats: copied " << info.framesCopied
               << " frames, dropped " << info.framesDropped << " frames" << std::endl;
+    pipeline_.report();
 }
 
 void DefaultFrameQueueSinkListener::run()
 {
+    if (!placement_.is_default()) {
+        apply_placement(placement_, "dequeue thread");
+        std::cerr << ">>> dequeue thread running on NUMA node "
+                  << current_numa_node() << std::endl;
+    }
+    // allocated here to place the pool on the NUMA node of this thread
+    pipeline_.start();
+
     while(true)
     {
-        if (!wait_next_()) {
+        if (!handoff_.wait(*sink_)) {
             break;
         }
         process_single_();
     }
 }
 
-bool DefaultFrameQueueSinkListener::wait_next_()
-{
-    while (sink_->getOutputQueueSize() == 0) {
-        std::unique_lock<std::mutex> lock(io_);
-        reception_.wait(lock);
-        if (quit_) {
-            return false;
-        }
-    }
-    return true;
-}
-
 void DefaultFrameQueueSinkListener::process_single_()
 {
+    handoff_.popping();
     DShowLib::tFrameQueueBufferPtr frame = sink_->popOutputQueueBuffer();
-    callback_(size_, frame->getPtr(), user_data_);
-    sink_->queueBuffer(frame);
+    const double timestamp = monotonic_seconds();
+    latency_.record(handoff_.popped(timestamp));
+    pipeline_.process(frame->getPtr(), timestamp);
+    if (sizing_.active()) {
+        // checked before the frame is re-queued, which would always leave one free
+        const bool starved = (sink_->getInputQueueSize() == 0);
+        sink_->queueBuffer(frame);
+        sizing_.record(monotonic_seconds() - timestamp, starved);
+    } else {
+        sink_->queueBuffer(frame);
+    }
 }
 
-void DefaultFrameQueueSinkListener::mark_quit_()
+bool DefaultFrameQueueSinkListener::grow_(void *listener, const size_t& count, std::string& error)
 {
-    std::unique_lock<std::mutex> lock(io_);
-    quit_ = true;
-    reception_.notify_all();
+    DShowLib::Error ret = ((DefaultFrameQueueSinkListener *)listener)->sink_->allocAndQueueBuffers(count);
+    if (ret.isError()) {
+        error = ret.toString();
+        return false;
+    }
+    return true;
 }
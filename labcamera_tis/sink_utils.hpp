@@ -26,8 +26,15 @@
 #include <thread>
 #include <mutex>
 #include <condition_variable>
+#include <atomic>
+#include "pipeline_utils.hpp"
+#include "handoff_utils.hpp"
+#include "sizing_utils.hpp"
 
-typedef void (*FrameCallback)(size_t size, void *data, void *user_data);
+/**
+ *  the SDK-independent description of frames of type `info`.
+ */
+FrameFormat as_frame_format(const DShowLib::FrameTypeInfo& info, const bool& bottom_up);
 
 class DefaultFrameNotificationSinkListener: public DShowLib::FrameNotificationSinkListener
 {
@@ -35,9 +42,20 @@ private:
     FrameCallback callback_;
     void         *user_data_;
     size_t        count_;
+    StageChain    stages_;
+    bool          bottom_up_;
+    FrameCrop     crop_;
+    bool          cropping_;
+    std::vector<uint8_t> cropped_; // binned frames for the callback
 public:
     DefaultFrameNotificationSinkListener(FrameCallback callback, void *user_data);
     void setCallback(FrameCallback callback);
+
+    void add_stage(FrameStage *stage) { stages_.add(stage); }
+    void clear_stages() { stages_.clear(); }
+    void bottom_up(const bool& value) { bottom_up_ = value; }
+    void crop(const FrameCrop& crop) { crop_ = crop; }
+
     void sinkConnected(const DShowLib::FrameTypeInfo& info) override;
     void sinkDisconnected() override;
     void frameReceived(DShowLib::IFrame& frame) override;
@@ -46,22 +64,30 @@ public:
 class DefaultFrameQueueSinkListener: public DShowLib::FrameQueueSinkListener
 {
 private:
-    const FrameCallback callback_;
-          void         *user_data_;
-          size_t        size_;
           size_t        buffer_count_;
 
           std::thread   thread_;
-          std::mutex    io_;
-          std::condition_variable reception_;
-    volatile bool       quit_;
+          FrameHandoff<DShowLib::FrameQueueSink> handoff_;
           DShowLib::FrameQueueSink *sink_;
 
-    /**
-     *  waits for the next frame to be received
-     *  @return whether to continue waiting for frames
-     */
-    bool wait_next_();
+          FramePipeline pipeline_;
+          bool          bottom_up_;
+
+          BufferSizing  sizing_;
+          double        frame_rate_;
+          double        drop_probability_;
+          size_t        warmup_;      // 0 unless the sink is grown automatically
+          size_t        max_buffers_;
+
+          MemoryPolicy  memory_;
+          FrameMemory   buffers_;        // of the sink buffers, when memory_ is not the default
+          size_t        buffers_count_;  // the layout of buffers_
+          size_t        buffers_size_;
+          size_t        buffers_stride_;
+          DShowLib::FrameQueueSink *buffers_sink_; // the sink that holds them, until it disconnects
+
+          ThreadPlacement     placement_;
+          LatencyHistogram    latency_;  // of each frame, from the framesQueued() that saw it to the dequeue
 
     /**
      *  dequeues a frame from the frame queue sink
@@ -70,10 +96,23 @@ private:
     void process_single_();
 
     /**
-     *  marks so that the dequeueing thread knows that
-     *  it does not have to wait for frames any more.
+     *  queues sink buffers that are allocated according to memory_.
+     *  the memory is reused if it has the same layout.
+     *  @return the number of buffers queued.
      */
-    void mark_quit_();
+    size_t queue_buffers_(DShowLib::FrameQueueSink& sink, const DShowLib::FrameTypeInfo& info);
+
+    /**
+     *  takes the buffers of buffers_ back from the sink, which is disconnecting.
+     */
+    void unqueue_buffers_(DShowLib::FrameQueueSink& sink);
+
+    /**
+     *  the GrowFunction of sizing_, called from its helper thread. the buffers are
+     *  allocated by the SDK even when memory_ is not the default, as the block of
+     *  memory_ cannot grow while the sink holds its buffers.
+     */
+    static bool grow_(void *listener, const size_t& count, std::string& error);
 public:
     DefaultFrameQueueSinkListener(FrameCallback callback, void *user_data);
 
@@ -86,6 +125,109 @@ public:
     void buffer_count(const size_t& value) {
         buffer_count_ = value;
     }
+
+    /**
+     *  decides the number of sink buffers automatically: the acquisition starts with
+     *  buffer_count() buffers, and the time that the dequeue thread holds each frame
+     *  is measured for `warmup` frames. the sink is then grown to the number of buffers
+     *  that keeps the probability of dropping a frame at `frame_rate` below
+     *  `drop_probability`, and later whenever it runs out of free buffers,
+     *  up to `max_count` buffers in total. `warmup` == 0 turns it off.
+     *  the buffers are added from a helper thread, and allocated by the SDK whatever memory() is.
+     */
+    void auto_buffers(const double& frame_rate, const double& drop_probability,
+                      const size_t& max_count, const size_t& warmup) {
+        frame_rate_       = frame_rate;
+        drop_probability_ = drop_probability;
+        max_buffers_      = max_count;
+        warmup_           = warmup;
+    }
+
+    /**
+     *  sets how the sink buffers and the frame pool are allocated (huge pages,
+     *  page locking, NUMA node). with the default policy, the sink buffers are
+     *  left to the SDK. the sink buffers are taken back from the sink as it
+     *  disconnects, and their memory is reused as long as the frame size and
+     *  buffer_count() stay the same.
+     */
+    void memory(const MemoryPolicy& policy) {
+        memory_ = policy;
+        pipeline_.memory(policy);
+    }
+
+    /**
+     *  decouples the callback from the sink buffers through an internal pool,
+     *  so that the sink buffers are re-queued as soon as they are copied.
+     *  `depth` == 0 runs the callback on the dequeue thread
+     *  (the policy is then not used).
+     */
+    void delivery(const DeliveryPolicy& policy, const size_t& depth, const double& target_rate) {
+        pipeline_.delivery(policy, depth, target_rate);
+    }
+
+    DeliveryStats delivery_stats() { return pipeline_.delivery_stats(); }
+
+    /**
+     *  see FramePipeline::holds() and FramePipeline::hold().
+     */
+    void       holds(const size_t& count) { pipeline_.holds(count); }
+    FrameHold *hold(const uint8_t *data) { return pipeline_.hold(data); }
+
+    /**
+     *  adds a stage to run on the dequeue thread, before the frames are
+     *  delivered. `stage` is owned by the caller.
+     */
+    void add_stage(FrameStage *stage) { pipeline_.add_stage(stage); }
+    void clear_stages() { pipeline_.clear_stages(); }
+
+    /**
+     *  whether the frames arrive bottom-up (i.e. they could not be flipped in hardware).
+     */
+    void bottom_up(const bool& value) { bottom_up_ = value; }
+
+    /**
+     *  crops (and bins) the frames after the stages, so that only the region
+     *  is copied into the pool. the callback on the dequeue thread receives
+     *  the whole frame if there is no binning, to be viewed with strides.
+     */
+    void crop(const FrameCrop& crop) { pipeline_.crop(crop); }
+
+    /**
+     *  adds a consumer with its own queue and thread, in addition to the callback.
+     *  @return the index of the consumer, to be used with consumer_stats().
+     */
+    size_t add_consumer(SlotCallback callback, void *user_data,
+                        const DeliveryPolicy& policy, const size_t& depth,
+                        const double& target_rate) {
+        return pipeline_.add_consumer(callback, user_data, policy, depth, target_rate);
+    }
+
+    void clear_consumers() { pipeline_.clear_consumers(); }
+
+    DeliveryStats consumer_stats(const size_t& index) { return pipeline_.consumer_stats(index); }
+
+    /**
+     *  sets where to run the dequeue thread. the frame pool is allocated
+     *  by the dequeue thread, and therefore on its NUMA node.
+     */
+    void dequeue_placement(const ThreadPlacement& placement) { placement_ = placement; }
+
+    /**
+     *  sets where to run the thread of consumer #`index` (#0 being the callback).
+     */
+    void consumer_placement(const size_t& index, const ThreadPlacement& placement) {
+        pipeline_.consumer_placement(index, placement);
+    }
+
+    /**
+     *  sets how the dequeue thread waits for frames (see FrameHandoff::strategy()).
+     */
+    void wait_strategy(const WaitStrategy& strategy, const double& spin_budget) {
+        handoff_.strategy(strategy, spin_budget);
+    }
+
+    const LatencyHistogram *dequeue_latency() const { return &latency_; }
+    const LatencyHistogram *consumer_latency(const size_t& index) const { return pipeline_.consumer_latency(index); }
 };
 
 inline smart_ptr<DShowLib::GrabberSinkType> as_sink(
@@ -0,0 +1,251 @@
+/*
+ *  MIT License
+ *
+ *  Copyright (c) 2021 Keisuke Sehara
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+*/
+#include "sizing_utils.hpp"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+BufferSizer::BufferSizer(const size_t& window)
+{
+    reset(window);
+}
+
+void BufferSizer::reset(const size_t& window)
+{
+    samples_.clear();
+    samples_.reserve(window);
+    window_ = window;
+}
+
+bool BufferSizer::record(const double& service)
+{
+    if (complete()) {
+        return false;
+    }
+    samples_.push_back(service);
+    return complete();
+}
+
+double BufferSizer::service(const double& q) const
+{
+    if (samples_.empty()) {
+        return 0.0;
+    }
+    std::vector<double> sorted(samples_);
+    const size_t index = std::min((size_t)(q * sorted.size()), sorted.size() - 1);
+    std::nth_element(sorted.begin(), sorted.begin() + index, sorted.end());
+    return sorted[index];
+}
+
+size_t BufferSizer::depth(const double& frame_rate, const double& drop_probability) const
+{
+    if (samples_.empty() || (frame_rate <= 0.0)) {
+        return 0;
+    }
+    const double interval = 1.0 / frame_rate;
+    double mean = 0.0;
+    for (double sample: samples_) {
+        mean += sample;
+    }
+    mean /= samples_.size();
+    if (mean >= interval) {
+        return MAX_BUFFERS;
+    }
+
+    // enough frames for the tail to be seen ~100 times
+    const double p      = std::max(drop_probability, 1e-6);
+    const size_t frames = std::max((size_t)100000, std::min((size_t)(100.0 / p), (size_t)10000000));
+
+    // the departure times of the frames in use, oldest first (FIFO)
+    std::vector<double>   departures(MAX_BUFFERS);
+    std::vector<uint64_t> occupancy(MAX_BUFFERS + 1, 0);
+    size_t   oldest = 0, count = 0;
+    double   last   = 0.0;
+    uint64_t state  = 0x9E3779B97F4A7C15ULL; // a fixed seed, for reproducible decisions
+    for (size_t n = 0; n < frames; n++) {
+        const double arrival = n * interval;
+        while ((count > 0) && (departures[oldest] <= arrival)) {
+            oldest = (oldest + 1) % MAX_BUFFERS;
+            count--;
+        }
+        occupancy[count]++;
+        if (count == MAX_BUFFERS) {
+            return MAX_BUFFERS;
+        }
+
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        const double service = samples_[(size_t)((state >> 33) % samples_.size())];
+        last = std::max(arrival, last) + service;
+        departures[(oldest + count) % MAX_BUFFERS] = last;
+        count++;
+    }
+
+    // the smallest number of buffers in use that is exceeded at most `p` of the time
+    const uint64_t allowed = (uint64_t)(p * frames);
+    uint64_t exceeding = frames;
+    size_t   used      = 0;
+    while ((used < MAX_BUFFERS) && (exceeding - occupancy[used] > allowed)) {
+        exceeding -= occupancy[used];
+        used++;
+    }
+    // plus the buffer for the arriving frame, and the one being filled by the driver
+    return std::min(used + 2, (size_t)MAX_BUFFERS);
+}
+
+static void sizing_context(BufferSizing *sizing)
+{
+    sizing->run();
+}
+
+BufferSizing::BufferSizing():
+    frame_rate_(0.0),
+    drop_probability_(0.0),
+    max_buffers_(0),
+    frame_size_(0),
+    grow_(nullptr),
+    context_(nullptr),
+    allocated_(0),
+    measuring_(false),
+    active_(false),
+    starved_(false),
+    quit_(false),
+    measured_(false) { }
+
+void BufferSizing::start(GrowFunction grow, void *context,
+                         const double& frame_rate, const double& drop_probability, const size_t& max_buffers,
+                         const size_t& warmup, const size_t& allocated, const size_t& frame_size)
+{
+    stop();
+    sizer_.reset(warmup);
+    frame_rate_       = frame_rate;
+    drop_probability_ = drop_probability;
+    max_buffers_      = max_buffers;
+    frame_size_       = frame_size;
+    grow_             = grow;
+    context_          = context;
+    allocated_        = allocated;
+    measuring_        = (warmup > 0);
+    quit_             = false;
+    measured_         = false;
+    starved_.store(false, std::memory_order_relaxed);
+    active_.store(warmup > 0, std::memory_order_relaxed);
+    if (active()) {
+        thread_ = std::thread(sizing_context, this);
+    }
+}
+
+void BufferSizing::stop()
+{
+    if (!thread_.joinable()) {
+        return;
+    }
+    {
+        std::unique_lock<std::mutex> lock(io_);
+        quit_ = true;
+        cond_.notify_one();
+    }
+    thread_.join();
+    active_.store(false, std::memory_order_relaxed);
+}
+
+void BufferSizing::wake_()
+{
+    std::unique_lock<std::mutex> lock(io_);
+    cond_.notify_one();
+}
+
+void BufferSizing::record(const double& service, const bool& starved)
+{
+    if (!active()) {
+        return;
+    }
+    if (measuring_) {
+        if (sizer_.record(service)) {
+            measuring_ = false;
+            std::unique_lock<std::mutex> lock(io_);
+            measured_ = true;
+            cond_.notify_one();
+        }
+    } else if (starved && !starved_.exchange(true, std::memory_order_relaxed)) {
+        wake_();
+    }
+}
+
+void BufferSizing::run()
+{
+    while (true) {
+        bool measured;
+        {
+            std::unique_lock<std::mutex> lock(io_);
+            cond_.wait(lock, [this]{ return quit_ || measured_ || starved_.load(std::memory_order_relaxed); });
+            if (quit_) {
+                break;
+            }
+            measured  = measured_;
+            measured_ = false;
+        }
+
+        if (measured) {
+            // the samples are no longer written once the window is complete
+            const size_t needed = sizer_.depth(frame_rate_, drop_probability_);
+            std::cerr << ">>> buffer sizing: service time p50 " << 1e6 * sizer_.service(0.5)
+                      << " us, p99 " << 1e6 * sizer_.service(0.99) << " us, max "
+                      << 1e6 * sizer_.service(1.0) << " us over " << sizer_.samples()
+                      << " frames at " << frame_rate_ << " fps; " << needed
+                      << " buffers needed for a drop probability of " << drop_probability_ << std::endl;
+            if (needed > max_buffers_) {
+                std::cerr << "***buffer sizing: limited to " << max_buffers_ << " buffers; "
+                          << "frames may be dropped" << std::endl;
+            }
+            grow_to_(std::min(needed, max_buffers_));
+        } else {
+            // ran out of free buffers after all
+            grow_to_(std::min(allocated_ + std::max(allocated_ / 2, (size_t)1), max_buffers_));
+        }
+        // the frames that starved while growing are not counted again
+        starved_.store(false, std::memory_order_relaxed);
+    }
+}
+
+void BufferSizing::grow_to_(const size_t& count)
+{
+    if (count <= allocated_) {
+        std::cerr << ">>> buffer sizing: keeping " << allocated_ << " buffers ("
+                  << (allocated_ * frame_size_) / 1048576.0 << " MiB)" << std::endl;
+    } else {
+        std::string error;
+        if (!grow_(context_, count - allocated_, error)) {
+            std::cerr << "***failed to grow the sink buffers: " << error
+                      << "; keeping " << allocated_ << " buffers" << std::endl;
+            active_.store(false, std::memory_order_relaxed);
+            return;
+        }
+        allocated_ = count;
+        std::cerr << ">>> buffer sizing: grew the sink to " << allocated_ << " buffers ("
+                  << (allocated_ * frame_size_) / 1048576.0 << " MiB)" << std::endl;
+    }
+    if (allocated_ >= max_buffers_) {
+        active_.store(false, std::memory_order_relaxed);
+    }
+}
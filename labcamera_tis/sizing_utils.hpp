@@ -0,0 +1,153 @@
+/*
+ *  MIT License
+ *
+ *  Copyright (c) 2021 Keisuke Sehara
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+*/
+#ifndef SIZING_UTILS_HPP_
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+/**
+ *  decides how many sink buffers an acquisition needs, from the time that
+ *  the dequeue thread holds each frame (its service time), as measured
+ *  during a warm-up window.
+ *
+ *  the sink is modeled as a queue with a frame arriving every 1/`frame_rate`
+ *  seconds, and the measured service times are resampled to estimate the
+ *  distribution of the buffers in use when a frame arrives.
+ */
+class BufferSizer
+{
+private:
+    std::vector<double> samples_; // service times, in seconds
+    size_t              window_;
+public:
+    static const size_t MAX_BUFFERS = 4096;
+
+    BufferSizer(const size_t& window = 0);
+
+    /**
+     *  discards the samples, and starts a warm-up window of `window` frames.
+     */
+    void reset(const size_t& window);
+
+    /**
+     *  records the service time of a frame.
+     *  @return whether the warm-up window has just been completed.
+     */
+    bool record(const double& service);
+
+    bool   complete() const { return (window_ > 0) && (samples_.size() >= window_); }
+    size_t samples() const { return samples_.size(); }
+
+    /**
+     *  @return the `q`-th quantile (0 <= q <= 1) of the service times, in seconds.
+     */
+    double service(const double& q) const;
+
+    /**
+     *  @return the number of buffers that keeps the probability of a frame
+     *          finding no free buffer (i.e. being dropped) below `drop_probability`,
+     *          including the one being filled by the driver. MAX_BUFFERS if the
+     *          dequeue thread cannot keep up with `frame_rate` at all, and
+     *          0 without any sample.
+     */
+    size_t depth(const double& frame_rate, const double& drop_probability) const;
+};
+
+/**
+ *  queues `count` more buffers to a sink.
+ *  @return false if it has failed, with `error` describing why.
+ */
+typedef bool (*GrowFunction)(void *context, const size_t& count, std::string& error);
+
+/**
+ *  grows the sink buffers of an acquisition as decided by a BufferSizer, without
+ *  holding up the dequeue thread: the dequeue thread only records the service times,
+ *  while a helper thread runs BufferSizer::depth() once the warm-up window is complete,
+ *  grows the sink through a GrowFunction, and logs the decisions to std::cerr.
+ *
+ *  the sink is grown to the decided number of buffers, and later by half
+ *  whenever a frame is dequeued with no free buffer left in the sink.
+ *
+ *  start() and stop() are called while the dequeue thread is not running,
+ *  and record() from the dequeue thread.
+ */
+class BufferSizing
+{
+private:
+    BufferSizer  sizer_;
+    double       frame_rate_;
+    double       drop_probability_;
+    size_t       max_buffers_;
+    size_t       frame_size_;
+    GrowFunction grow_;
+    void        *context_;
+    size_t       allocated_; // the number of sink buffers so far (helper thread)
+    bool         measuring_; // during the warm-up window (dequeue thread)
+
+    std::atomic<bool>        active_;
+    std::atomic<bool>        starved_; // a frame found no free buffer since the last growth
+    std::thread              thread_;
+    std::mutex               io_;
+    std::condition_variable  cond_;
+    bool                     quit_;
+    bool                     measured_; // the warm-up window is to be decided on
+
+    BufferSizing(const BufferSizing&);
+    BufferSizing& operator=(const BufferSizing&);
+
+    void wake_();
+    void grow_to_(const size_t& count);
+public:
+    BufferSizing();
+    ~BufferSizing() { stop(); }
+
+    /**
+     *  starts sizing a sink of `allocated` buffers of `frame_size` bytes each, grown
+     *  through `grow`, with a warm-up window of `warmup` frames (0 does not size it at all).
+     */
+    void start(GrowFunction grow, void *context,
+               const double& frame_rate, const double& drop_probability, const size_t& max_buffers,
+               const size_t& warmup, const size_t& allocated, const size_t& frame_size);
+    void stop();
+    void run(); // of the helper thread
+
+    /**
+     *  whether the sink may still be grown.
+     */
+    bool active() const { return active_.load(std::memory_order_relaxed); }
+
+    /**
+     *  records the service time of a frame, and whether there was no free buffer
+     *  in the sink when it was dequeued.
+     */
+    void record(const double& service, const bool& starved);
+};
+
+#define SIZING_UTILS_HPP_
+#endif
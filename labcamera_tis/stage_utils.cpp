@@ -0,0 +1,54 @@
+/*
+ *  MIT License
+ *
+ *  Copyright (c) 2021 Keisuke Sehara
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+*/
+#include "stage_utils.hpp"
+#include <iostream>
+
+void StageChain::prepare(const FrameFormat& format)
+{
+    active_.clear();
+    for (auto stage: stages_) {
+        if (stage->prepare(format)) {
+            active_.push_back(stage);
+        } else {
+            std::cerr << "***" << stage->name() << ": unsupported frame format (color format "
+                      << (int)format.color << ", " << format.bits_per_pixel
+                      << " bits per pixel); the stage is skipped" << std::endl;
+        }
+    }
+}
+
+void StageChain::process(const FrameView& frame)
+{
+    for (auto stage: active_) {
+        stage->process(frame);
+    }
+}
+
+void StageChain::finish()
+{
+    for (auto stage: active_) {
+        stage->finish();
+    }
+    active_.clear();
+}
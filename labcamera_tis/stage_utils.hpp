@@ -0,0 +1,134 @@
+/*
+ *  MIT License
+ *
+ *  Copyright (c) 2021 Keisuke Sehara
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+*/
+#ifndef STAGE_UTILS_HPP_
+#include <vector>
+#include "format_utils.hpp"
+
+/**
+ *  a processing step that runs on every frame on the dequeue thread,
+ *  before the frame is handed over to the callbacks and consumers.
+ *  stages must keep up with the frame rate, and must not block.
+ */
+class FrameStage
+{
+public:
+    virtual ~FrameStage() { }
+
+    /**
+     *  called before the first frame of each acquisition.
+     *  @return whether the stage can process frames of `format`;
+     *          the stage is skipped for this acquisition otherwise.
+     */
+    virtual bool prepare(const FrameFormat& format) = 0;
+
+    virtual void process(const FrameView& frame) = 0;
+
+    /**
+     *  called after the last frame of each acquisition.
+     */
+    virtual void finish() { }
+
+    virtual const char *name() const = 0;
+};
+
+/**
+ *  a stage whose per-frame work is specialized for each color format at compile time.
+ *
+ *  `Derived` implements:
+ *
+ *      template<class Traits> void run(const FrameView& frame);
+ *      bool configure(const FrameFormat& format); // optional; called from prepare()
+ *
+ *  the specialization of run() is selected once in prepare(), so that
+ *  the inner loops do not branch on the format.
+ */
+template<class Derived>
+class FormatStage: public FrameStage
+{
+private:
+    typedef void (*Kernel)(Derived *self, const FrameView& frame);
+
+    template<class Traits>
+    static void invoke_(Derived *self, const FrameView& frame) {
+        self->template run<Traits>(frame);
+    }
+
+    struct Binder
+    {
+        Kernel kernel;
+        template<class Traits> void apply() { kernel = &FormatStage::template invoke_<Traits>; }
+    };
+
+    Kernel kernel_;
+protected:
+    FrameFormat format_;
+public:
+    FormatStage(): kernel_(nullptr), format_() { }
+
+    bool configure(const FrameFormat& format) { return true; }
+
+    bool prepare(const FrameFormat& format) override {
+        Binder binder = { nullptr };
+        format_ = format;
+        kernel_ = nullptr;
+        if (!visit_format(format, binder)) {
+            return false;
+        }
+        if (!static_cast<Derived *>(this)->configure(format)) {
+            return false;
+        }
+        kernel_ = binder.kernel;
+        return true;
+    }
+
+    void process(const FrameView& frame) override {
+        kernel_(static_cast<Derived *>(this), frame);
+    }
+};
+
+/**
+ *  the stages of a listener, in the order they have been added.
+ *  stages are owned by the caller, and must be added or removed
+ *  only while there is no acquisition.
+ */
+class StageChain
+{
+private:
+    std::vector<FrameStage*> stages_;
+    std::vector<FrameStage*> active_;
+public:
+    void add(FrameStage *stage) { stages_.push_back(stage); }
+    void clear() { stages_.clear(); active_.clear(); }
+    bool empty() const { return stages_.empty(); }
+
+    /**
+     *  prepares the stages, skipping those that do not support `format`.
+     */
+    void prepare(const FrameFormat& format);
+    void process(const FrameView& frame);
+    void finish();
+};
+
+#define STAGE_UTILS_HPP_
+#endif
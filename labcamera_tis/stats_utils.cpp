@@ -0,0 +1,87 @@
+/*
+ *  MIT License
+ *
+ *  Copyright (c) 2021 Keisuke Sehara
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+*/
+#include "stats_utils.hpp"
+#include <cmath>
+
+const size_t LatencyHistogram::BINS_PER_DECADE;
+const size_t LatencyHistogram::BINS;
+constexpr double LatencyHistogram::MIN_LATENCY;
+
+LatencyHistogram::LatencyHistogram()
+{
+    reset();
+}
+
+void LatencyHistogram::reset()
+{
+    for (size_t i = 0; i < BINS; i++) {
+        counts_[i].store(0, std::memory_order_relaxed);
+    }
+    total_.store(0, std::memory_order_relaxed);
+    max_ns_.store(0, std::memory_order_relaxed);
+}
+
+void LatencyHistogram::record(const double& seconds)
+{
+    size_t bin;
+    if (seconds < MIN_LATENCY) {
+        bin = 0;
+    } else {
+        double pos = std::log10(seconds / MIN_LATENCY) * BINS_PER_DECADE;
+        bin = (pos >= (double)(BINS - 2))? (BINS - 1) : (1 + (size_t)pos);
+    }
+    counts_[bin].fetch_add(1, std::memory_order_relaxed);
+    total_.fetch_add(1, std::memory_order_relaxed);
+
+    // only the recording thread updates max_ns_
+    uint64_t ns = (seconds > 0.0)? (uint64_t)(seconds * 1e9) : 0;
+    if (ns > max_ns_.load(std::memory_order_relaxed)) {
+        max_ns_.store(ns, std::memory_order_relaxed);
+    }
+}
+
+double LatencyHistogram::percentile(const double& q) const
+{
+    uint64_t total = count();
+    if (total == 0) {
+        return 0.0;
+    }
+    uint64_t rank = (uint64_t)std::ceil(q * total);
+    if (rank == 0) {
+        rank = 1;
+    }
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BINS; i++) {
+        seen += count(i);
+        if (seen >= rank) {
+            return (i == BINS - 1)? max() : upper_edge(i);
+        }
+    }
+    return max();
+}
+
+double LatencyHistogram::upper_edge(const size_t& bin)
+{
+    return MIN_LATENCY * std::pow(10.0, (double)bin / BINS_PER_DECADE);
+}
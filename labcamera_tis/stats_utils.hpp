@@ -0,0 +1,69 @@
+/*
+ *  MIT License
+ *
+ *  Copyright (c) 2021 Keisuke Sehara
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+*/
+#ifndef STATS_UTILS_HPP_
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ *  a lock-free histogram of latencies, with logarithmic bins
+ *  (20 per decade) from 100 ns to 10 s.
+ *
+ *  record() is meant to be called from a single thread, whereas
+ *  the other methods may be called from any thread at any time.
+ */
+class LatencyHistogram
+{
+public:
+    static const size_t BINS_PER_DECADE = 20;
+    static const size_t BINS            = 8 * BINS_PER_DECADE + 2; // incl. under/overflow
+    static constexpr double MIN_LATENCY = 1e-7;
+private:
+    std::atomic<uint64_t> counts_[BINS];
+    std::atomic<uint64_t> total_;
+    std::atomic<uint64_t> max_ns_;
+public:
+    LatencyHistogram();
+
+    void reset();
+    void record(const double& seconds);
+
+    uint64_t count() const { return total_.load(std::memory_order_relaxed); }
+    uint64_t count(const size_t& bin) const { return counts_[bin].load(std::memory_order_relaxed); }
+    double   max() const { return 1e-9 * max_ns_.load(std::memory_order_relaxed); }
+
+    /**
+     *  @return the upper edge of the bin that contains the `q`-th quantile
+     *          (0 <= q <= 1), in seconds, or 0 if nothing has been recorded.
+     */
+    double percentile(const double& q) const;
+
+    /**
+     *  @return the upper edge of `bin`, in seconds.
+     */
+    static double upper_edge(const size_t& bin);
+};
+
+#define STATS_UTILS_HPP_
+#endif
@@ -0,0 +1,174 @@
+/*
+ *  MIT License
+ *
+ *  Copyright (c) 2021 Keisuke Sehara
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+*/
+#include "sync_utils.hpp"
+#include <algorithm>
+#include <cmath>
+
+SyncPulseStage::SyncPulseStage(const double& low, const double& high,
+                               const double& period, const double& offset,
+                               const size_t& capacity):
+    region_(),
+    low_(low),
+    high_(high),
+    period_((period > 0.0)? period : 1.0),
+    offset_(offset),
+    kernels_(nullptr),
+    start_(0), width_(0), height_(0),
+    primed_(false), on_(false), pulse_(-1), last_(0.0), origin_(0.0), sums_(),
+    mapping_(), level_(0.0), state_(false),
+    edges_(capacity) { }
+
+void SyncPulseStage::region(const size_t& x, const size_t& y, const size_t& width, const size_t& height)
+{
+    region_[0] = x;
+    region_[1] = y;
+    region_[2] = width;
+    region_[3] = height;
+}
+
+bool SyncPulseStage::configure(const FrameFormat& format)
+{
+    if ((region_[0] >= format.width) || (region_[1] >= format.height)) {
+        return false;
+    }
+    width_  = std::min((region_[2] > 0)? region_[2] : format.width,  format.width  - region_[0]);
+    height_ = std::min((region_[3] > 0)? region_[3] : format.height, format.height - region_[1]);
+
+    // the region is flipped in memory for bottom-up frames
+    const size_t row = format.bottom_up? (format.height - region_[1] - height_) : region_[1];
+    start_   = row * format.row_bytes() + region_[0] * (format.bits_per_pixel / 8);
+    kernels_ = &pixel_kernels();
+
+    primed_ = false;
+    on_     = false;
+    pulse_  = -1;
+    std::fill(sums_, sums_ + 6, 0.0);
+    edges_.reset();
+
+    std::unique_lock<std::mutex> lock(io_);
+    mapping_ = SyncMapping();
+    level_   = 0.0;
+    state_   = false;
+    return true;
+}
+
+void SyncPulseStage::detect_(const FrameView& frame, const double& level)
+{
+    bool rising = false, falling = false;
+    if (!primed_) {
+        // the initial state is not a transition
+        on_     = (level > high_);
+        primed_ = true;
+    } else if (!on_ && (level > high_)) {
+        on_    = true;
+        rising = true;
+    } else if (on_ && (level < low_)) {
+        on_     = false;
+        falling = true;
+    }
+
+    if (rising) {
+        fit_(frame.timestamp);
+    }
+    if (rising || falling) {
+        SyncEdge edge;
+        edge.sequence  = frame.sequence;
+        edge.timestamp = frame.timestamp;
+        edge.rising    = rising? 1 : 0;
+        edge.pulse     = rising? pulse_ : -1;
+        edge.level     = level;
+        edges_.push(edge);
+    }
+
+    std::unique_lock<std::mutex> lock(io_);
+    level_ = level;
+    state_ = on_;
+}
+
+void SyncPulseStage::fit_(const double& timestamp)
+{
+    SyncMapping mapping;
+    {
+        std::unique_lock<std::mutex> lock(io_);
+        mapping = mapping_;
+    }
+
+    if (pulse_ < 0) {
+        pulse_  = 0;
+        origin_ = timestamp;
+    } else {
+        // the pulses in between have been missed if the gap is longer than a period
+        const double slope  = (mapping.pulses >= 2)? mapping.slope : 1.0;
+        const double period = period_ / slope;
+        pulse_ += std::max((int64_t)1, (int64_t)std::llround((timestamp - last_) / period));
+    }
+    last_ = timestamp;
+
+    // relative to the first pulse, to keep the sums well-conditioned
+    const double x = timestamp - origin_;
+    const double y = (double)pulse_ * period_;
+    double *s = sums_;
+    s[0] += 1.0;
+    s[1] += x;
+    s[2] += y;
+    s[3] += x * x;
+    s[4] += x * y;
+    s[5] += y * y;
+
+    const double n     = s[0];
+    const double denom = n * s[3] - s[1] * s[1];
+    double slope = 1.0, base = 0.0;
+    if ((n >= 2.0) && (denom > 0.0)) {
+        slope = (n * s[4] - s[1] * s[2]) / denom;
+        base  = (s[2] - slope * s[1]) / n;
+    }
+    const double sse = s[5] - 2.0 * base * s[2] - 2.0 * slope * s[4]
+                     + n * base * base + 2.0 * base * slope * s[1] + slope * slope * s[3];
+
+    mapping.pulses    = (uint64_t)n;
+    mapping.slope     = slope;
+    mapping.intercept = offset_ + base - slope * origin_;
+    mapping.residual  = std::sqrt(std::max(sse, 0.0) / n);
+
+    std::unique_lock<std::mutex> lock(io_);
+    mapping_ = mapping;
+}
+
+SyncMapping SyncPulseStage::mapping()
+{
+    std::unique_lock<std::mutex> lock(io_);
+    return mapping_;
+}
+
+double SyncPulseStage::level()
+{
+    std::unique_lock<std::mutex> lock(io_);
+    return level_;
+}
+
+bool SyncPulseStage::state()
+{
+    std::unique_lock<std::mutex> lock(io_);
+    return state_;
+}
@@ -0,0 +1,159 @@
+/*
+ *  MIT License
+ *
+ *  Copyright (c) 2021 Keisuke Sehara
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+*/
+#ifndef SYNC_UTILS_HPP_
+#include <mutex>
+#include "stage_utils.hpp"
+#include "simd_utils.hpp"
+#include "ring_utils.hpp"
+
+/**
+ *  a transition of the sync signal.
+ */
+struct SyncEdge
+{
+    uint64_t sequence;  // of the frame where the transition was seen
+    double   timestamp;
+    uint32_t rising;    // 1 for off-to-on, 0 for on-to-off
+    int64_t  pulse;     // # of the pulse in the external train (rising edges only; -1 otherwise)
+    double   level;     // the mean intensity of the region
+};
+
+/**
+ *  external time = slope * frame timestamp + intercept.
+ */
+struct SyncMapping
+{
+    uint64_t pulses;    // # of rising edges that the fit is based on
+    double   slope;
+    double   intercept;
+    double   residual;  // the RMS deviation of the pulses from the fit, in external seconds
+};
+
+/**
+ *  detects the on/off transitions of a sync LED in a small region of the frames
+ *  with hysteresis (on above `high`, off below `low`, in the units of the pixel values),
+ *  and fits a running linear mapping from the frame timestamps to the external clock.
+ *
+ *  the external pulse train is assumed to have a rising edge every `period` seconds
+ *  (of the external clock), the first one to be detected being at `offset`.
+ *  pulses that are missed are skipped according to the current fit, so that
+ *  the numbering stays aligned.
+ */
+class SyncPulseStage: public FormatStage<SyncPulseStage>
+{
+private:
+    size_t              region_[4]; // x, y, width, height as requested (0 for the edge)
+    double              low_;
+    double              high_;
+    double              period_;
+    double              offset_;
+
+    const PixelKernels *kernels_;
+    size_t              start_;     // of the region, in bytes
+    size_t              width_;
+    size_t              height_;
+
+    bool                primed_;    // whether the initial state has been seen
+    bool                on_;
+    int64_t             pulse_;     // of the latest rising edge
+    double              last_;      // timestamp of the latest rising edge
+    double              origin_;    // timestamp of the first rising edge
+    double              sums_[6];   // n, x, y, xx, xy, yy relative to the first pulse
+
+    std::mutex          io_;        // guards the copies below
+    SyncMapping         mapping_;
+    double              level_;
+    bool                state_;
+
+    ResultRing<SyncEdge> edges_;
+
+    /**
+     *  updates the state with the mean intensity of the region.
+     */
+    void detect_(const FrameView& frame, const double& level);
+    void fit_(const double& timestamp);
+public:
+    SyncPulseStage(const double& low = 64.0, const double& high = 192.0,
+                   const double& period = 1.0, const double& offset = 0.0,
+                   const size_t& capacity = 4096);
+
+    /**
+     *  the region to sample, in pixels from the top-left corner.
+     *  must be set while there is no acquisition.
+     */
+    void region(const size_t& x, const size_t& y, const size_t& width, const size_t& height);
+
+    bool configure(const FrameFormat& format);
+
+    template<class Traits>
+    void run(const FrameView& frame);
+
+    const char *name() const override { return "SyncPulseStage"; }
+
+    SyncMapping mapping();
+    double      level();
+    bool        state();
+
+    /**
+     *  moves up to `max_edges` of the oldest transitions into `edges`.
+     *  must not be called from more than one thread at a time.
+     */
+    size_t   read(SyncEdge *edges, const size_t& max_edges) { return edges_.pop(edges, max_edges); }
+    size_t   pending() const { return edges_.size(); }
+    uint64_t dropped() const { return edges_.dropped(); }
+};
+
+template<class Traits>
+void SyncPulseStage::run(const FrameView& frame)
+{
+    const size_t   row_bytes = format_.row_bytes();
+    const uint8_t *src       = frame.data + start_;
+    uint64_t sum;
+    size_t   values;
+    if (Traits::channels == 4) {
+        // the alpha channel of RGB32 is not sampled
+        sum = 0;
+        const size_t width = width_;
+        for (size_t row = 0; row < height_; row++) {
+            // a row cannot overflow 32 bits
+            const uint8_t *in  = src + row * row_bytes;
+            uint32_t       acc = 0;
+            for (size_t x = 0; x < width; x++) {
+                acc += (uint32_t)in[4 * x] + in[4 * x + 1] + in[4 * x + 2];
+            }
+            sum += acc;
+        }
+        values = width_ * height_ * 3;
+    } else if (Traits::bits == 8) {
+        sum    = kernels_->roi_sum8(src, row_bytes, width_ * Traits::channels, height_);
+        values = width_ * height_ * Traits::channels;
+    } else {
+        sum    = kernels_->roi_sum16(src, row_bytes, width_ * Traits::channels, height_);
+        values = width_ * height_ * Traits::channels;
+    }
+    detect_(frame, (double)sum / (double)values);
+}
+
+#define SYNC_UTILS_HPP_
+#endif
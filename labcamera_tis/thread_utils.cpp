@@ -0,0 +1,159 @@
+/*
+ *  MIT License
+ *
+ *  Copyright (c) 2021 Keisuke Sehara
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+*/
+#include "thread_utils.hpp"
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include "pool_utils.hpp"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <cerrno>
+#include <cstring>
+#endif
+
+#ifdef _WIN32
+
+bool apply_placement(const ThreadPlacement& placement, const char *name)
+{
+    bool   success = true;
+    HANDLE self    = GetCurrentThread();
+
+    if (!placement.cpus.empty()) {
+        DWORD_PTR mask = 0;
+        for (int cpu: placement.cpus) {
+            if ((cpu >= 0) && (cpu < (int)(8 * sizeof(DWORD_PTR)))) {
+                mask |= ((DWORD_PTR)1) << cpu;
+            }
+        }
+        if ((mask == 0) || (SetThreadAffinityMask(self, mask) == 0)) {
+            std::cerr << "***" << name << ": failed to set CPU affinity (error "
+                      << GetLastError() << ")" << std::endl;
+            success = false;
+        }
+    }
+
+    int level = THREAD_PRIORITY_NORMAL;
+    if (placement.realtime) {
+        level = THREAD_PRIORITY_TIME_CRITICAL;
+    } else if (placement.priority <= -15) {
+        level = THREAD_PRIORITY_HIGHEST;
+    } else if (placement.priority < 0) {
+        level = THREAD_PRIORITY_ABOVE_NORMAL;
+    } else if (placement.priority >= 15) {
+        level = THREAD_PRIORITY_LOWEST;
+    } else if (placement.priority > 0) {
+        level = THREAD_PRIORITY_BELOW_NORMAL;
+    }
+    if ((level != THREAD_PRIORITY_NORMAL) && (SetThreadPriority(self, level) == 0)) {
+        std::cerr << "***" << name << ": failed to set thread priority (error "
+                  << GetLastError() << ")" << std::endl;
+        success = false;
+    }
+    return success;
+}
+
+int current_numa_node()
+{
+    PROCESSOR_NUMBER proc;
+    USHORT           node;
+    GetCurrentProcessorNumberEx(&proc);
+    if (GetNumaProcessorNodeEx(&proc, &node) == 0) {
+        return -1;
+    }
+    return (int)node;
+}
+
+#else
+
+bool apply_placement(const ThreadPlacement& placement, const char *name)
+{
+    bool      success = true;
+    pthread_t self    = pthread_self();
+
+    if (!placement.cpus.empty()) {
+        cpu_set_t mask;
+        CPU_ZERO(&mask);
+        for (int cpu: placement.cpus) {
+            if ((cpu >= 0) && (cpu < CPU_SETSIZE)) {
+                CPU_SET(cpu, &mask);
+            }
+        }
+        int ret = pthread_setaffinity_np(self, sizeof(mask), &mask);
+        if (ret != 0) {
+            std::cerr << "***" << name << ": failed to set CPU affinity: "
+                      << std::strerror(ret) << std::endl;
+            success = false;
+        }
+    }
+
+    if (placement.realtime) {
+        sched_param param;
+        param.sched_priority = (placement.priority > 0)? placement.priority : 1;
+        int ret = pthread_setschedparam(self, SCHED_FIFO, &param);
+        if (ret != 0) {
+            std::cerr << "***" << name << ": failed to enable SCHED_FIFO: "
+                      << std::strerror(ret) << std::endl;
+            success = false;
+        }
+    } else if (placement.priority != 0) {
+        // nice values are per-thread on Linux
+        pid_t tid = (pid_t)syscall(SYS_gettid);
+        if (setpriority(PRIO_PROCESS, tid, placement.priority) != 0) {
+            std::cerr << "***" << name << ": failed to set nice value: "
+                      << std::strerror(errno) << std::endl;
+            success = false;
+        }
+    }
+    return success;
+}
+
+int current_numa_node()
+{
+    unsigned cpu  = 0;
+    unsigned node = 0;
+    if (syscall(SYS_getcpu, &cpu, &node, nullptr) != 0) {
+        return -1;
+    }
+    return (int)node;
+}
+
+#endif
+
+void wait_until(const double& due)
+{
+    const double remaining = due - monotonic_seconds();
+    if (remaining > 5e-4) {
+        std::this_thread::sleep_for(std::chrono::duration<double>(remaining - 2e-4));
+    }
+    while (monotonic_seconds() < due) {
+        cpu_relax();
+    }
+}
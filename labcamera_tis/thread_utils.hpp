@@ -0,0 +1,98 @@
+/*
+ *  MIT License
+ *
+ *  Copyright (c) 2021 Keisuke Sehara
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+*/
+#ifndef THREAD_UTILS_HPP_
+#include <vector>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+/**
+ *  how the dequeue thread waits for frames.
+ */
+enum WaitStrategy
+{
+    WaitBlocking = 0, // sleeps on a condition variable until notified
+    WaitSpinning = 1, // busy-polls (optionally for a bounded time before sleeping)
+};
+
+/**
+ *  hints the CPU that the calling thread is in a spin-wait loop.
+ */
+inline void cpu_relax()
+{
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    _mm_pause();
+#elif defined(__x86_64__) || defined(__i386__)
+    _mm_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
+/**
+ *  waits until monotonic_seconds() reaches `due`: sleeps for most of the wait,
+ *  and spins only for the last 200 us, so that the other threads keep their cores.
+ */
+void wait_until(const double& due);
+
+/**
+ *  where and how an acquisition thread is to be scheduled.
+ *
+ *  `priority` is interpreted depending on `realtime`:
+ *  - realtime == false: a nice value (-20 to 19; lower is more favorable).
+ *    on Windows, it is mapped to the nearest THREAD_PRIORITY_* level.
+ *  - realtime == true: a SCHED_FIFO priority (1 to 99).
+ *    on Windows, the thread is set to THREAD_PRIORITY_TIME_CRITICAL.
+ */
+struct ThreadPlacement
+{
+    std::vector<int> cpus;     // empty to leave it to the OS
+    int              priority; // 0 to leave it unchanged (unless realtime)
+    bool             realtime;
+
+    ThreadPlacement(): cpus(), priority(0), realtime(false) { }
+
+    bool is_default() const { return cpus.empty() && (priority == 0) && !realtime; }
+};
+
+/**
+ *  applies `placement` to the calling thread.
+ *  failures (e.g. lack of privileges for real-time scheduling) are
+ *  reported to std::cerr, and the thread keeps running as it is.
+ *
+ *  @return whether all the settings have been applied.
+ */
+bool apply_placement(const ThreadPlacement& placement, const char *name);
+
+/**
+ *  @return the NUMA node that the calling thread is currently running on,
+ *          or -1 if it is unknown.
+ */
+int current_numa_node();
+
+#define THREAD_UTILS_HPP_
+#endif
@@ -0,0 +1,488 @@
+/*
+ *  MIT License
+ *
+ *  Copyright (c) 2021 Keisuke Sehara
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+*/
+#include "tiff_utils.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#ifdef LABCAMERA_HAS_ZLIB
+#include <zlib.h>
+#endif
+
+// the field types of BigTIFF
+static const uint16_t TIFF_SHORT  = 3;
+static const uint16_t TIFF_LONG   = 4;
+static const uint16_t TIFF_DOUBLE = 12;
+static const uint16_t TIFF_LONG8  = 16;
+
+static const size_t HEADER_BYTES = 16;
+static const size_t ENTRY_BYTES  = 20;
+
+static uint64_t align8(const uint64_t& offset)
+{
+    return (offset + 7) & ~((uint64_t)7);
+}
+
+/**
+ *  appends `value` in the byte order of the machine
+ *  (little-endian, as declared in the header).
+ */
+template<class T>
+static void put(std::vector<uint8_t>& out, const T& value)
+{
+    const uint8_t *bytes = (const uint8_t *)&value;
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+/**
+ *  appends an IFD entry, with `size` bytes of `value` left-justified in its value field.
+ */
+static void put_entry(std::vector<uint8_t>& out, const uint16_t& tag, const uint16_t& type,
+                      const uint64_t& count, const void *value, const size_t& size)
+{
+    uint8_t field[8] = { 0 };
+    std::memcpy(field, value, std::min(size, sizeof(field)));
+    put(out, tag);
+    put(out, type);
+    put(out, count);
+    out.insert(out.end(), field, field + sizeof(field));
+}
+
+static void put_short(std::vector<uint8_t>& out, const uint16_t& tag, const uint16_t& value)
+{
+    put_entry(out, tag, TIFF_SHORT, 1, &value, sizeof(value));
+}
+
+static void put_long(std::vector<uint8_t>& out, const uint16_t& tag, const uint32_t& value)
+{
+    put_entry(out, tag, TIFF_LONG, 1, &value, sizeof(value));
+}
+
+TiffWriter::TiffWriter():
+    compression_(TiffNone),
+    level_(1),
+    max_bytes_(0),
+    rows_per_strip_(0),
+    samples_(0),
+    bytes_(0),
+    row_(0),
+    strip_rows_(0),
+    strips_(0),
+    arranged_(false),
+    prepared_(false),
+    failed_(false),
+    stream_(nullptr),
+    opened_(false),
+    index_(0),
+    position_(0),
+    last_next_(0),
+    pages_(0),
+    zstream_(nullptr),
+    frames_(0),
+    written_(0),
+    files_(0),
+    errors_(0) { }
+
+TiffWriter::~TiffWriter()
+{
+    close_();
+#ifdef LABCAMERA_HAS_ZLIB
+    if (zstream_ != nullptr) {
+        deflateEnd((z_stream *)zstream_);
+        delete (z_stream *)zstream_;
+    }
+#endif
+}
+
+bool TiffWriter::configure(const std::string& path, const TiffCompression& compression,
+                           const int& level, const uint64_t& max_bytes, const size_t& rows_per_strip)
+{
+#ifdef LABCAMERA_HAS_ZLIB
+    if (zstream_ != nullptr) {
+        deflateEnd((z_stream *)zstream_);
+        delete (z_stream *)zstream_;
+        zstream_ = nullptr;
+    }
+    if (compression == TiffDeflate) {
+        z_stream *stream = new z_stream();
+        if (deflateInit(stream, std::max(1, std::min(level, 9))) != Z_OK) {
+            delete stream;
+            return false;
+        }
+        zstream_ = stream;
+    }
+#else
+    if (compression == TiffDeflate) {
+        return false;
+    }
+#endif
+    path_           = path;
+    compression_    = compression;
+    level_          = level;
+    max_bytes_      = max_bytes;
+    rows_per_strip_ = rows_per_strip;
+    index_          = 0;
+    prepared_       = false;
+    return true;
+}
+
+bool TiffWriter::prepare(const FrameFormat& format)
+{
+    prepared_ = false;
+    failed_   = false;
+    switch (format.color) {
+    case FormatY800:  samples_ = 1; bytes_ = 1; break;
+    case FormatY16:   samples_ = 1; bytes_ = 2; break;
+    case FormatRGB24: samples_ = 3; bytes_ = 1; break;
+    case FormatRGB32: samples_ = 4; bytes_ = 1; break;
+    default:
+        return false;
+    }
+    row_ = format.width * samples_ * bytes_;
+    if ((format.width == 0) || (format.height == 0) || (format.row_bytes() < row_)) {
+        return false;
+    }
+    format_   = format;
+    arranged_ = format.bottom_up || (samples_ > 1) || (format.row_bytes() != row_)
+                || (compression_ == TiffDeflate);
+    raw_.resize(arranged_? (row_ * format.height) : 0);
+
+    if (rows_per_strip_ > 0) {
+        strip_rows_ = std::min(rows_per_strip_, format.height);
+    } else if (compression_ == TiffDeflate) {
+        strip_rows_ = std::min(std::max((size_t)65536 / row_, (size_t)1), format.height);
+    } else {
+        strip_rows_ = format.height;
+    }
+    strips_ = (format.height + strip_rows_ - 1) / strip_rows_;
+    strip_bytes_.resize(strips_);
+    for (size_t i = 0; i < strips_; i++) {
+        const size_t rows = std::min(strip_rows_, format.height - i * strip_rows_);
+        strip_bytes_[i] = rows * row_;
+    }
+#ifdef LABCAMERA_HAS_ZLIB
+    if (compression_ == TiffDeflate) {
+        size_t bound = 0;
+        for (size_t i = 0; i < strips_; i++) {
+            bound += deflateBound((z_stream *)zstream_, (uLong)strip_bytes_[i]);
+        }
+        compressed_.resize(bound);
+    }
+#endif
+    prepared_ = true;
+    return true;
+}
+
+const uint8_t *TiffWriter::arrange_(const uint8_t *data)
+{
+    const size_t height = format_.height;
+    const size_t stride = format_.row_bytes();
+    for (size_t y = 0; y < height; y++) {
+        const uint8_t *src = data + (format_.bottom_up? (height - 1 - y) : y) * stride;
+        uint8_t       *dst = raw_.data() + y * row_;
+        if (samples_ == 1) {
+            std::memcpy(dst, src, row_);
+        } else {
+            // BGR(A) to RGB(A)
+            for (size_t x = 0; x < row_; x += samples_) {
+                dst[x]     = src[x + 2];
+                dst[x + 1] = src[x + 1];
+                dst[x + 2] = src[x];
+                if (samples_ == 4) {
+                    dst[x + 3] = src[x + 3];
+                }
+            }
+        }
+        if (compression_ == TiffDeflate) {
+            difference_(dst);
+        }
+    }
+    return raw_.data();
+}
+
+void TiffWriter::difference_(uint8_t *row)
+{
+    // from the end, so that every sample is subtracted by the original one
+    if (bytes_ == 2) {
+        uint16_t *samples = (uint16_t *)row;
+        for (size_t i = row_ / 2 - 1; i >= samples_; i--) {
+            samples[i] -= samples[i - samples_];
+        }
+    } else {
+        for (size_t i = row_ - 1; i >= samples_; i--) {
+            row[i] -= row[i - samples_];
+        }
+    }
+}
+
+uint64_t TiffWriter::entries_() const
+{
+    return 12 + ((samples_ == 4)? 1 : 0) + ((compression_ == TiffDeflate)? 1 : 0);
+}
+
+bool TiffWriter::compress_(const uint8_t *raw)
+{
+#ifdef LABCAMERA_HAS_ZLIB
+    z_stream *stream = (z_stream *)zstream_;
+    size_t    used   = 0;
+    for (size_t i = 0; i < strips_; i++) {
+        const size_t rows = std::min(strip_rows_, format_.height - i * strip_rows_);
+        deflateReset(stream);
+        stream->next_in   = (Bytef *)(raw + i * strip_rows_ * row_);
+        stream->avail_in  = (uInt)(rows * row_);
+        stream->next_out  = (Bytef *)(compressed_.data() + used);
+        stream->avail_out = (uInt)(compressed_.size() - used);
+        if (deflate(stream, Z_FINISH) != Z_STREAM_END) {
+            return false;
+        }
+        strip_bytes_[i] = stream->total_out;
+        used           += stream->total_out;
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+uint64_t TiffWriter::layout_(const uint64_t& sequence, const double& timestamp)
+{
+    const uint64_t entries   = entries_();
+    const uint64_t ifd_at    = position_;
+    const uint64_t arrays_at = ifd_at + 8 + entries * ENTRY_BYTES + 8;
+    const uint64_t data_at   = arrays_at + ((strips_ > 1)? (16 * strips_) : 0);
+    uint64_t data_bytes = 0;
+    for (size_t i = 0; i < strips_; i++) {
+        data_bytes += strip_bytes_[i];
+    }
+    const uint64_t next = align8(data_at + data_bytes);
+
+    const uint16_t bits[4] = { (uint16_t)(8 * bytes_), (uint16_t)(8 * bytes_),
+                               (uint16_t)(8 * bytes_), (uint16_t)(8 * bytes_) };
+    const uint64_t counts_at = arrays_at + 8 * strips_;
+
+    // the entries are sorted by tag
+    ifd_.clear();
+    put(ifd_, entries);
+    put_long(ifd_, 256, (uint32_t)format_.width);              // ImageWidth
+    put_long(ifd_, 257, (uint32_t)format_.height);             // ImageLength
+    put_entry(ifd_, 258, TIFF_SHORT, samples_, bits, 2 * samples_); // BitsPerSample
+    put_short(ifd_, 259, (uint16_t)compression_);              // Compression
+    put_short(ifd_, 262, (samples_ > 1)? 2 : 1);               // PhotometricInterpretation: RGB or BlackIsZero
+    if (strips_ > 1) {                                         // StripOffsets
+        put_entry(ifd_, 273, TIFF_LONG8, strips_, &arrays_at, 8);
+    } else {
+        put_entry(ifd_, 273, TIFF_LONG8, 1, &data_at, 8);
+    }
+    put_short(ifd_, 277, (uint16_t)samples_);                  // SamplesPerPixel
+    put_long(ifd_, 278, (uint32_t)strip_rows_);                // RowsPerStrip
+    if (strips_ > 1) {                                         // StripByteCounts
+        put_entry(ifd_, 279, TIFF_LONG8, strips_, &counts_at, 8);
+    } else {
+        put_entry(ifd_, 279, TIFF_LONG8, 1, &data_bytes, 8);
+    }
+    put_short(ifd_, 284, 1);                                   // PlanarConfiguration: contiguous
+    if (compression_ == TiffDeflate) {
+        put_short(ifd_, 317, 2);                               // Predictor: horizontal differencing
+    }
+    if (samples_ == 4) {
+        put_short(ifd_, 338, 0);                               // ExtraSamples: unspecified
+    }
+    put_entry(ifd_, 65000, TIFF_LONG8, 1, &sequence, 8);       // the sequence number
+    put_entry(ifd_, 65001, TIFF_DOUBLE, 1, &timestamp, 8);     // the timestamp
+    put(ifd_, next);
+    last_next_ = ifd_at + 8 + entries * ENTRY_BYTES;
+
+    if (strips_ > 1) {
+        uint64_t offset = data_at;
+        for (size_t i = 0; i < strips_; i++) {
+            put(ifd_, offset);
+            offset += strip_bytes_[i];
+        }
+        for (size_t i = 0; i < strips_; i++) {
+            put(ifd_, (uint64_t)strip_bytes_[i]);
+        }
+    }
+    return next;
+}
+
+void TiffWriter::write(const FrameSlot *slot)
+{
+    if (!prepared_ || failed_) {
+        errors_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    const uint8_t *data = arranged_? arrange_(slot->data) : slot->data;
+    if (compression_ == TiffDeflate) {
+        if (!compress_(data)) {
+            fail_("failed to compress a frame");
+            return;
+        }
+        data = compressed_.data();
+    }
+
+    const uint64_t entries = entries_();
+    uint64_t data_bytes = 0;
+    for (size_t i = 0; i < strips_; i++) {
+        data_bytes += strip_bytes_[i];
+    }
+    const uint64_t page = align8(8 + entries * ENTRY_BYTES + 8
+                                 + ((strips_ > 1)? (16 * strips_) : 0) + data_bytes);
+    if (opened_ && (max_bytes_ > 0) && (pages_ > 0) && (position_ + page > max_bytes_)) {
+        close_();
+    }
+    if (!opened_ && !open_()) {
+        return;
+    }
+
+    const uint64_t next = layout_(slot->sequence, slot->timestamp);
+    const uint64_t end  = position_ + ifd_.size() + data_bytes;
+    static const char padding[8] = { 0 };
+    if (!put_(ifd_.data(), ifd_.size()) || !put_(data, data_bytes) || !put_(padding, next - end)) {
+        fail_("failed to write to " + paths_.back());
+        return;
+    }
+    position_ = next;
+    pages_++;
+    frames_.fetch_add(1, std::memory_order_relaxed);
+    written_.fetch_add(page, std::memory_order_relaxed);
+}
+
+bool TiffWriter::open_()
+{
+    std::string path = path_;
+    if (index_ > 0) {
+        const size_t dot   = path_.find_last_of('.');
+        const size_t slash = path_.find_last_of("/\\");
+        const bool   ext   = (dot != std::string::npos) && ((slash == std::string::npos) || (dot > slash));
+        char suffix[16];
+        std::snprintf(suffix, sizeof(suffix), "_%04zu", index_);
+        path = ext? (path_.substr(0, dot) + suffix + path_.substr(dot)) : (path_ + suffix);
+    }
+    if (stream_ != nullptr) {
+        const std::string requested = path;
+        path = stream_->open(requested);
+        if (path.empty()) {
+            fail_("no target to write " + requested);
+            return false;
+        }
+    } else {
+        file_.open(path, std::ios::binary | std::ios::trunc);
+        if (!file_) {
+            fail_("could not open " + path);
+            return false;
+        }
+    }
+    opened_ = true;
+    {
+        std::unique_lock<std::mutex> lock(io_);
+        paths_.push_back(path);
+    }
+    // little-endian BigTIFF, with the first IFD right after the header
+    std::vector<uint8_t> header;
+    header.push_back('I');
+    header.push_back('I');
+    put(header, (uint16_t)43);
+    put(header, (uint16_t)8);
+    put(header, (uint16_t)0);
+    put(header, (uint64_t)HEADER_BYTES);
+    put_(header.data(), header.size());
+
+    position_  = HEADER_BYTES;
+    last_next_ = 8; // the first IFD, until there is one
+    pages_     = 0;
+    files_.fetch_add(1, std::memory_order_relaxed);
+    written_.fetch_add(HEADER_BYTES, std::memory_order_relaxed);
+    return true;
+}
+
+void TiffWriter::close_()
+{
+    if (!opened_) {
+        return;
+    }
+    // terminates the chain of IFDs
+    const uint64_t none = 0;
+    if (stream_ != nullptr) {
+        stream_->patch(last_next_, &none, sizeof(none));
+        stream_->close();
+    } else {
+        file_.seekp(last_next_);
+        file_.write((const char *)&none, sizeof(none));
+        file_.close();
+    }
+    opened_ = false;
+    index_++;
+}
+
+bool TiffWriter::put_(const void *data, const size_t& size)
+{
+    if (stream_ != nullptr) {
+        return stream_->write(data, size);
+    }
+    file_.write((const char *)data, size);
+    return (bool)file_;
+}
+
+void TiffWriter::fail_(const std::string& what)
+{
+    std::cerr << "***TIFF writer: " << what
+              << "; the rest of the frames are not written" << std::endl;
+    errors_.fetch_add(1, std::memory_order_relaxed);
+    failed_ = true;
+    if (opened_) {
+        file_.clear();
+        close_();
+    }
+}
+
+void TiffWriter::finish()
+{
+    close_();
+    failed_ = false;
+}
+
+TiffStats TiffWriter::stats() const
+{
+    TiffStats stats;
+    stats.frames = frames_.load(std::memory_order_relaxed);
+    stats.bytes  = written_.load(std::memory_order_relaxed);
+    stats.files  = files_.load(std::memory_order_relaxed);
+    stats.errors = errors_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+std::vector<std::string> TiffWriter::paths()
+{
+    std::unique_lock<std::mutex> lock(io_);
+    return paths_;
+}
+
+void tiff_slot_callback(FrameSlot *slot, void *writer)
+{
+    if (slot != nullptr) {
+        ((TiffWriter *)writer)->write(slot);
+    } else {
+        ((TiffWriter *)writer)->finish();
+    }
+}
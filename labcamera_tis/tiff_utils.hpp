@@ -0,0 +1,192 @@
+/*
+ *  MIT License
+ *
+ *  Copyright (c) 2021 Keisuke Sehara
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+*/
+#ifndef TIFF_UTILS_HPP_
+#include <atomic>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "format_utils.hpp"
+#include "pool_utils.hpp"
+#include "io_utils.hpp"
+
+enum TiffCompression
+{
+    TiffNone    = 1,
+    TiffDeflate = 8, // zlib ("Adobe deflate"); requires LABCAMERA_HAS_ZLIB
+};
+
+struct TiffStats
+{
+    uint64_t frames; // pages written
+    uint64_t bytes;  // written to the files
+    uint64_t files;
+    uint64_t errors; // frames that could not be written
+};
+
+/**
+ *  writes frames into multi-page BigTIFF files. it runs as a consumer
+ *  (see tiff_slot_callback()), i.e. on a thread of its own.
+ *
+ *  every page is laid out before it is written: the IFD, the strip offsets and
+ *  byte counts, and then the strips. the offset of the next IFD is therefore known
+ *  when an IFD is written, and the files are written sequentially; the last IFD
+ *  of a file is terminated when the file is closed.
+ *
+ *  each page carries the sequence number (tag 65000, LONG8) and the timestamp
+ *  (tag 65001, DOUBLE, in seconds of monotonic_seconds()) of the frame.
+ *  bottom-up frames are written top-down, and BGR(A) frames as RGB(A).
+ *  with deflate, the rows go through the horizontal predictor (tag 317) first.
+ *
+ *  deflate runs on the writer's thread, at some tens of MB/s per core; for the full
+ *  frame rate of a fast camera, write the frames without compression (the files
+ *  are then written at the speed of the disk).
+ *
+ *  the first file is written to `path`. when a file would grow beyond `max_bytes`,
+ *  the next one is started as <stem>_0001<ext>, <stem>_0002<ext> and so on.
+ *  after an error, the frames are only counted until the next acquisition.
+ *
+ *  with a stream of a WriteScheduler, the files are written by the scheduler
+ *  instead, under the root of one of its targets (only the file name of `path`,
+ *  if it is absolute). paths() reports where they actually are.
+ */
+class TiffWriter
+{
+private:
+    std::string     path_;
+    TiffCompression compression_;
+    int             level_;
+    uint64_t        max_bytes_;
+    size_t          rows_per_strip_; // as requested; 0 for the default
+
+    FrameFormat     format_;
+    size_t          samples_;        // per pixel
+    size_t          bytes_;          // per sample
+    size_t          row_;            // bytes of a row in the file
+    size_t          strip_rows_;
+    size_t          strips_;
+    bool            arranged_;       // whether the rows are re-arranged before writing
+    bool            prepared_;
+    bool            failed_;
+
+    std::ofstream   file_;
+    WriteStream    *stream_;         // nullptr to write file_ directly
+    bool            opened_;
+    size_t          index_;          // of the current file
+    uint64_t        position_;       // the end of the current file
+    uint64_t        last_next_;      // where the offset of the next IFD is in the last IFD
+    size_t          pages_;          // in the current file
+
+    std::vector<uint8_t>  ifd_;
+    std::vector<uint8_t>  raw_;        // the re-arranged rows
+    std::vector<uint8_t>  compressed_;
+    std::vector<uint64_t> strip_bytes_;
+    void                 *zstream_;    // z_stream with deflate
+
+    std::atomic<uint64_t> frames_;
+    std::atomic<uint64_t> written_;
+    std::atomic<uint64_t> files_;
+    std::atomic<uint64_t> errors_;
+    std::mutex               io_;
+    std::vector<std::string> paths_;   // guarded by io_
+
+    TiffWriter(const TiffWriter&);
+    TiffWriter& operator=(const TiffWriter&);
+
+    bool open_();
+    void close_();
+    bool put_(const void *data, const size_t& size);
+    void fail_(const std::string& what);
+
+    /**
+     *  @return the rows of the frame at `data` in the order and layout of the file.
+     */
+    const uint8_t *arrange_(const uint8_t *data);
+
+    /**
+     *  replaces the samples of a (re-arranged) row with their differences
+     *  from the preceding pixel, for the horizontal predictor.
+     */
+    void difference_(uint8_t *row);
+
+    uint64_t entries_() const; // # of the IFD entries of a page
+
+    /**
+     *  compresses the strips of `raw` into compressed_, filling strip_bytes_.
+     */
+    bool compress_(const uint8_t *raw);
+
+    /**
+     *  lays out the IFD of a page at position_, with strips of strip_bytes_,
+     *  into ifd_. @return the offset of the next IFD.
+     */
+    uint64_t layout_(const uint64_t& sequence, const double& timestamp);
+public:
+    TiffWriter();
+    ~TiffWriter();
+
+    /**
+     *  sets where and how to write. `level` is the deflate level (1-9), and
+     *  `rows_per_strip` == 0 makes a strip of the whole frame without compression,
+     *  and strips of about 64 KiB with deflate. `max_bytes` == 0 writes a single file.
+     *  @return false if the compression is not available in this build.
+     */
+    bool configure(const std::string& path, const TiffCompression& compression,
+                   const int& level, const uint64_t& max_bytes, const size_t& rows_per_strip);
+
+    /**
+     *  writes the files through `stream` (owned by its scheduler) from the next file
+     *  on; nullptr to write them directly.
+     */
+    void stream(WriteStream *stream) { stream_ = stream; }
+
+    /**
+     *  prepares for frames of `format` (as they are delivered, i.e. after any crop).
+     *  the files are opened on the first frame.
+     *  @return false if the format is not supported.
+     */
+    bool prepare(const FrameFormat& format);
+
+    void write(const FrameSlot *slot);
+
+    /**
+     *  closes the current file.
+     */
+    void finish();
+
+    TiffStats stats() const;
+
+    /**
+     *  @return the paths of the files that have been written so far.
+     */
+    std::vector<std::string> paths();
+};
+
+/**
+ *  the SlotCallback that writes a consumer's frames with `writer` (a TiffWriter).
+ */
+void tiff_slot_callback(FrameSlot *slot, void *writer);
+
+#define TIFF_UTILS_HPP_
+#endif
@@ -0,0 +1,287 @@
+/*
+ *  MIT License
+ *
+ *  Copyright (c) 2021 Keisuke Sehara
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+*/
+#include "trigger_utils.hpp"
+#include <algorithm>
+#include <cmath>
+#include "thread_utils.hpp"
+
+TriggerLatencyStage::TriggerLatencyStage(const double& timeout, const size_t& capacity):
+    timeout_(timeout),
+    events_(capacity)
+{
+    reset();
+}
+
+void TriggerLatencyStage::reset()
+{
+    std::unique_lock<std::mutex> lock(io_);
+    pending_.clear();
+    fired_      = 0;
+    failed_     = 0;
+    matched_    = 0;
+    missed_     = 0;
+    unexpected_ = 0;
+    sequence_   = -1;
+    sums_[0]    = 0.0;
+    sums_[1]    = 0.0;
+    min_        = 0.0;
+    max_        = 0.0;
+    latency_.reset();
+    issue_.reset();
+    lateness_.reset();
+    events_.reset();
+}
+
+void TriggerLatencyStage::timeout(const double& value)
+{
+    std::unique_lock<std::mutex> lock(io_);
+    timeout_ = value;
+}
+
+void TriggerLatencyStage::miss_()
+{
+    missed_++;
+    events_.push(pending_.front());
+    pending_.pop_front();
+}
+
+void TriggerLatencyStage::expire_(const double& limit)
+{
+    while (!pending_.empty() && (pending_.front().fired < limit)) {
+        miss_();
+    }
+}
+
+void TriggerLatencyStage::process(const FrameView& frame)
+{
+    const double received = frame.timestamp;
+    std::unique_lock<std::mutex> lock(io_);
+    expire_(received - timeout_);
+
+    // the frames lost before this one took the oldest triggers,
+    // as long as one is left for this frame
+    const uint64_t next = (uint64_t)(sequence_ + 1);
+    uint64_t       lost = ((sequence_ < 0) || (frame.sequence < next))? 0 : (frame.sequence - next);
+    sequence_ = (int64_t)frame.sequence;
+    while ((lost > 0) && (pending_.size() > 1) && (pending_[1].fired <= received)) {
+        miss_();
+        lost--;
+    }
+
+    if (pending_.empty() || (pending_.front().fired > received)) {
+        unexpected_++;
+        return;
+    }
+    TriggerEvent event = pending_.front();
+    pending_.pop_front();
+    event.sequence = (int64_t)frame.sequence;
+    event.latency  = received - event.fired;
+    if ((matched_ == 0) || (event.latency < min_)) {
+        min_ = event.latency;
+    }
+    if ((matched_ == 0) || (event.latency > max_)) {
+        max_ = event.latency;
+    }
+    matched_++;
+    sums_[0] += event.latency;
+    sums_[1] += event.latency * event.latency;
+    latency_.record(event.latency);
+    events_.push(event);
+}
+
+void TriggerLatencyStage::finish()
+{
+    std::unique_lock<std::mutex> lock(io_);
+    missed_ += pending_.size();
+    for (const TriggerEvent& event: pending_) {
+        events_.push(event);
+    }
+    pending_.clear();
+}
+
+bool TriggerLatencyStage::fire(TriggerFunction fire, void *context)
+{
+    const double fired = monotonic_seconds();
+    uint64_t     trigger;
+    {
+        // pending before the trigger is sent, in case the frame arrives first
+        std::unique_lock<std::mutex> lock(io_);
+        expire_(fired - timeout_);
+        trigger = fired_ + failed_;
+        TriggerEvent event = { trigger, fired, -1, -1.0 };
+        pending_.push_back(event);
+    }
+    const bool sent = fire(context);
+    issue_.record(monotonic_seconds() - fired);
+
+    std::unique_lock<std::mutex> lock(io_);
+    if (sent) {
+        fired_++;
+    } else {
+        failed_++;
+        auto event = std::find_if(pending_.begin(), pending_.end(),
+                                  [trigger](const TriggerEvent& e){ return e.trigger == trigger; });
+        if (event != pending_.end()) {
+            pending_.erase(event);
+        }
+    }
+    return sent;
+}
+
+uint64_t TriggerLatencyStage::run(TriggerFunction fire, void *context,
+                                  const uint64_t& count, const double& period)
+{
+    const double start = monotonic_seconds();
+    uint64_t     sent  = 0;
+    for (uint64_t i = 0; i < count; i++) {
+        const double due = start + i * period;
+        wait_until(due);
+        lateness_.record(std::max(monotonic_seconds() - due, 0.0));
+        if (this->fire(fire, context)) {
+            sent++;
+        }
+    }
+    // the frame of the last trigger may take up to the timeout
+    wait_until(monotonic_seconds() + timeout_);
+    std::unique_lock<std::mutex> lock(io_);
+    expire_(monotonic_seconds() - timeout_);
+    return sent;
+}
+
+TriggerStats TriggerLatencyStage::stats()
+{
+    std::unique_lock<std::mutex> lock(io_);
+    TriggerStats stats;
+    stats.fired      = fired_;
+    stats.failed     = failed_;
+    stats.matched    = matched_;
+    stats.missed     = missed_;
+    stats.unexpected = unexpected_;
+    stats.mean       = (matched_ > 0)? (sums_[0] / matched_) : 0.0;
+    stats.jitter     = (matched_ > 1)?
+        std::sqrt(std::max(sums_[1] - matched_ * stats.mean * stats.mean, 0.0) / (matched_ - 1)) : 0.0;
+    stats.min        = min_;
+    stats.max        = max_;
+    return stats;
+}
+
+static void simulate_context(TriggerSimulator *simulator)
+{
+    simulator->run();
+}
+
+TriggerSimulator::TriggerSimulator(FramePipeline *pipeline, const FrameFormat& format,
+                                   const double& latency, const double& jitter,
+                                   const double& miss_probability, const uint64_t& seed):
+    pipeline_(pipeline),
+    format_(format),
+    frame_(format.size, 0),
+    latency_(latency),
+    jitter_(jitter),
+    miss_(miss_probability),
+    random_(seed),
+    quit_(false),
+    fired_(0),
+    skipped_(0) { }
+
+TriggerSimulator::~TriggerSimulator()
+{
+    if (thread_.joinable()) {
+        stop();
+    }
+}
+
+void TriggerSimulator::start()
+{
+    {
+        std::unique_lock<std::mutex> lock(io_);
+        quit_ = false;
+        due_.clear();
+    }
+    pipeline_->prepare(format_);
+    thread_ = std::thread(simulate_context, this);
+}
+
+void TriggerSimulator::stop()
+{
+    {
+        std::unique_lock<std::mutex> lock(io_);
+        quit_ = true;
+        scheduled_.notify_all();
+    }
+    thread_.join();
+    pipeline_->finish();
+}
+
+void TriggerSimulator::run()
+{
+    pipeline_->start();
+    while (true) {
+        double due;
+        {
+            std::unique_lock<std::mutex> lock(io_);
+            scheduled_.wait(lock, [this]{ return quit_ || !due_.empty(); });
+            if (due_.empty()) {
+                return;
+            }
+            due = due_.front();
+        }
+        wait_until(due);
+        {
+            std::unique_lock<std::mutex> lock(io_);
+            due_.pop_front();
+        }
+        pipeline_->process(frame_.data(), monotonic_seconds());
+    }
+}
+
+bool TriggerSimulator::fire(void *simulator)
+{
+    TriggerSimulator *self = (TriggerSimulator *)simulator;
+    const double now = monotonic_seconds();
+    std::unique_lock<std::mutex> lock(self->io_);
+    self->fired_++;
+    if (std::uniform_real_distribution<double>(0.0, 1.0)(self->random_) < self->miss_) {
+        self->skipped_++;
+        return true;
+    }
+    const double delay = self->latency_ + self->jitter_ * std::normal_distribution<double>()(self->random_);
+    const double due   = now + std::max(delay, 0.0);
+    // kept in order, in case the jitter reorders the frames
+    self->due_.insert(std::upper_bound(self->due_.begin(), self->due_.end(), due), due);
+    self->scheduled_.notify_one();
+    return true;
+}
+
+uint64_t TriggerSimulator::fired()
+{
+    std::unique_lock<std::mutex> lock(io_);
+    return fired_;
+}
+
+uint64_t TriggerSimulator::skipped()
+{
+    std::unique_lock<std::mutex> lock(io_);
+    return skipped_;
+}
@@ -0,0 +1,216 @@
+/*
+ *  MIT License
+ *
+ *  Copyright (c) 2021 Keisuke Sehara
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+*/
+#ifndef TRIGGER_UTILS_HPP_
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <random>
+#include <thread>
+#include "pipeline_utils.hpp"
+#include "ring_utils.hpp"
+#include "stats_utils.hpp"
+
+/**
+ *  fires a trigger (e.g. pushes the 'Software Trigger' button of a device).
+ *  @return whether the trigger has been sent.
+ */
+typedef bool (*TriggerFunction)(void *context);
+
+/**
+ *  a trigger, and the frame that it resulted in.
+ */
+struct TriggerEvent
+{
+    uint64_t trigger;   // # of the trigger, from 0
+    double   fired;     // monotonic_seconds() right before the trigger was sent
+    int64_t  sequence;  // of the frame; -1 if the trigger was missed
+    double   latency;   // from `fired` to the reception of the frame; -1 if missed
+};
+
+struct TriggerStats
+{
+    uint64_t fired;      // triggers sent
+    uint64_t failed;     // triggers that could not be sent
+    uint64_t matched;    // triggers that resulted in a frame
+    uint64_t missed;     // triggers without a frame within the timeout
+    uint64_t unexpected; // frames without a trigger
+    double   mean;       // of the latencies, in seconds
+    double   jitter;     // the standard deviation of the latencies
+    double   min;
+    double   max;
+};
+
+/**
+ *  measures the latency from triggers to frames. the triggers are timestamped when they
+ *  are fired (see fire() and run()), and the frames when this stage sees them on the
+ *  dequeue thread, i.e. at their reception by the listener.
+ *
+ *  the frames are matched to the triggers in order (FIFO, as a camera delivers them):
+ *  each frame to the oldest pending trigger that was fired before it. a trigger is
+ *  counted as missed when it has no frame for `timeout` seconds, or when a gap in the
+ *  frame sequences shows that its frame was lost. `timeout` has to be longer than the
+ *  latency (with its jitter), and shorter than the period plus the latency: otherwise,
+ *  a trigger that the camera ignores takes the frame of the next one, and shifts the
+ *  matches that follow. up to `capacity` events are kept until they are read().
+ */
+class TriggerLatencyStage: public FrameStage
+{
+private:
+    double              timeout_;
+
+    std::mutex          io_;        // guards the rest, as triggers and frames come from different threads
+    std::deque<TriggerEvent> pending_; // fired, but not matched yet
+    uint64_t            fired_;
+    uint64_t            failed_;
+    uint64_t            matched_;
+    uint64_t            missed_;
+    uint64_t            unexpected_;
+    int64_t             sequence_;  // of the latest frame; -1 before the first one
+    double              sums_[2];   // of the latencies, and their squares
+    double              min_;
+    double              max_;
+
+    LatencyHistogram    latency_;   // recorded under io_
+    LatencyHistogram    issue_;     // the time that sending the triggers took
+    LatencyHistogram    lateness_;  // of the triggers behind the schedule of run()
+    ResultRing<TriggerEvent> events_;
+
+    /**
+     *  counts the pending triggers that have been fired before `limit` as missed.
+     *  must be called holding io_.
+     */
+    void expire_(const double& limit);
+
+    /**
+     *  counts the oldest pending trigger as missed. must be called holding io_.
+     */
+    void miss_();
+public:
+    TriggerLatencyStage(const double& timeout = 0.5, const size_t& capacity = 4096);
+
+    /**
+     *  starts over, e.g. for another measurement. must not be called
+     *  while triggers are fired.
+     */
+    void reset();
+
+    /**
+     *  sets the time after which a trigger without a frame is counted as missed.
+     */
+    void timeout(const double& value);
+
+    bool prepare(const FrameFormat&) override { return true; }
+    void process(const FrameView& frame) override;
+
+    /**
+     *  counts the triggers still pending as missed.
+     */
+    void finish() override;
+
+    const char *name() const override { return "TriggerLatencyStage"; }
+
+    /**
+     *  fires a trigger through `fire`, timestamped right before the call.
+     *  @return what `fire` returns.
+     */
+    bool fire(TriggerFunction fire, void *context);
+
+    /**
+     *  fires `count` triggers every `period` seconds on the calling thread, and waits
+     *  for the timeout after the last one, so that the statistics are complete.
+     *  @return the number of triggers that have been sent.
+     */
+    uint64_t run(TriggerFunction fire, void *context, const uint64_t& count, const double& period);
+
+    TriggerStats stats();
+
+    const LatencyHistogram *latency() const { return &latency_; }
+    const LatencyHistogram *issue() const { return &issue_; }
+    const LatencyHistogram *lateness() const { return &lateness_; }
+
+    /**
+     *  moves up to `max_events` of the oldest events (matched or missed) into `events`.
+     *  must not be called from more than one thread at a time.
+     */
+    size_t   read(TriggerEvent *events, const size_t& max_events) { return events_.pop(events, max_events); }
+    size_t   pending() const { return events_.size(); }
+    uint64_t dropped() const { return events_.dropped(); }
+};
+
+/**
+ *  a triggered camera without the SDK: every fire() delivers a frame through `pipeline`
+ *  (and therefore its stages) after `latency` seconds, with a normally distributed `jitter`
+ *  (standard deviation, in seconds), and misses a trigger with `miss_probability`.
+ *  for testing the measurement of trigger latencies (e.g. TriggerLatencyStage).
+ */
+class TriggerSimulator
+{
+private:
+    FramePipeline       *pipeline_;
+    FrameFormat          format_;
+    std::vector<uint8_t> frame_;
+    double               latency_;
+    double               jitter_;
+    double               miss_;
+
+    std::mt19937_64      random_;
+    std::thread          thread_;
+    std::mutex           io_;
+    std::condition_variable scheduled_;
+    std::deque<double>   due_;  // the times to deliver the frames, in order
+    bool                 quit_;
+    uint64_t             fired_;
+    uint64_t             skipped_;
+
+    TriggerSimulator(const TriggerSimulator&);
+    TriggerSimulator& operator=(const TriggerSimulator&);
+public:
+    TriggerSimulator(FramePipeline *pipeline, const FrameFormat& format,
+                     const double& latency, const double& jitter,
+                     const double& miss_probability, const uint64_t& seed = 1);
+    ~TriggerSimulator();
+
+    /**
+     *  prepares the pipeline and starts delivering frames.
+     */
+    void start();
+
+    /**
+     *  delivers the frames still due, and finishes the pipeline.
+     */
+    void stop();
+
+    void run(); // delivers the frames until stop()
+
+    /**
+     *  the TriggerFunction of a TriggerSimulator.
+     */
+    static bool fire(void *simulator);
+
+    uint64_t fired();
+    uint64_t skipped(); // the triggers missed on purpose
+};
+
+#define TRIGGER_UTILS_HPP_
+#endif
@@ -57,7 +57,29 @@ extensions = [
     Extension(
         "labcamera_tis", ["labcamera_tis/*.pyx",
                           "labcamera_tis/property_utils.cpp",
-                          "labcamera_tis/sink_utils.cpp"],
+                          "labcamera_tis/sink_utils.cpp",
+                          "labcamera_tis/pool_utils.cpp",
+                          "labcamera_tis/memory_utils.cpp",
+                          "labcamera_tis/sizing_utils.cpp",
+                          "labcamera_tis/dispatch_utils.cpp",
+                          "labcamera_tis/batch_utils.cpp",
+                          "labcamera_tis/dlpack_utils.cpp",
+                          "labcamera_tis/thread_utils.cpp",
+                          "labcamera_tis/stats_utils.cpp",
+                          "labcamera_tis/stage_utils.cpp",
+                          "labcamera_tis/simd_utils.cpp",
+                          "labcamera_tis/pixelstats_utils.cpp",
+                          "labcamera_tis/histogram_utils.cpp",
+                          "labcamera_tis/motion_utils.cpp",
+                          "labcamera_tis/preview_utils.cpp",
+                          "labcamera_tis/crop_utils.cpp",
+                          "labcamera_tis/blob_utils.cpp",
+                          "labcamera_tis/sync_utils.cpp",
+                          "labcamera_tis/pipeline_utils.cpp",
+                          "labcamera_tis/tiff_utils.cpp",
+                          "labcamera_tis/io_utils.cpp",
+                          "labcamera_tis/trigger_utils.cpp",
+                          "labcamera_tis/sequence_utils.cpp"],
         language="c++",
         include_dirs=["lib/include", "labcamera_tis", numpy.get_include()], # to be filled the user
         library_dirs=["lib/link",], # to be filled by the user
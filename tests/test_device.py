@@ -0,0 +1,98 @@
+# MIT License
+#
+# Copyright (c) 2021 Keisuke Sehara
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in all
+# copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+
+"""tests that need a connected camera; they are skipped without one.
+
+usage: python -m unittest discover tests
+
+the device is the first one found, or the one named in the LABCAMERA_TIS_DEVICE
+environment variable.
+"""
+
+import os
+import threading
+import time
+import unittest
+
+import labcamera_tis as tis
+
+STOP_TIMEOUT = 10.0 # seconds
+
+
+def device_name():
+    name = os.environ.get('LABCAMERA_TIS_DEVICE', None)
+    if name is not None:
+        return name
+    names = tis.Device.list_names()
+    return names[0] if len(names) > 0 else None
+
+
+@unittest.skipIf(device_name() is None, "no camera connected")
+class StopWithConsumers(unittest.TestCase):
+    def setUp(self):
+        self.device = tis.Device(device_name())
+        self.frames = 0
+        self.ended  = threading.Event()
+
+    def tearDown(self):
+        self.device.close()
+
+    def consume(self, frame):
+        if frame is None:
+            self.ended.set()  # the end of the acquisition
+        else:
+            self.frames += 1
+
+    def stop_in_time(self, stop):
+        """runs `stop` on another thread, and fails if it does not return in time
+        (e.g. because the consumer threads wait for the GIL that it holds)."""
+        thread = threading.Thread(target=stop, daemon=True)
+        thread.start()
+        thread.join(STOP_TIMEOUT)
+        self.assertFalse(thread.is_alive(), "the device did not stop (deadlock?)")
+
+    def acquire(self, **consumer):
+        self.device.add_consumer(self.consume, **consumer)
+        self.device.start(buffer_size=8, queue_size=2)
+        deadline = time.monotonic() + STOP_TIMEOUT
+        while (self.frames == 0) and (time.monotonic() < deadline):
+            time.sleep(0.01)
+        self.assertGreater(self.frames, 0, "no frame has been received")
+
+    def test_stop(self):
+        self.acquire()
+        self.stop_in_time(self.device.stop)
+        self.assertTrue(self.ended.is_set())
+
+    def test_stop_batched(self):
+        self.acquire(batch=4)
+        self.stop_in_time(self.device.stop)
+        self.assertTrue(self.ended.is_set())
+
+    def test_suspend(self):
+        self.acquire()
+        self.stop_in_time(self.device.suspend)
+        self.stop_in_time(self.device.stop)
+
+
+if __name__ == '__main__':
+    unittest.main()